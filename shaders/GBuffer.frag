@@ -3,27 +3,35 @@
 
 
 layout(location = 0) in vec3 inWorldPos;
-layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 layout(location = 3) in vec3 inNormal;
 layout(location = 4) in vec3 inTangent;
 layout(location = 5) in vec3 inBitangent;
+layout(location = 6) flat in uint inDrawIndex;
 
 layout(location = 0) out vec4 outAlbedo;
 layout(location = 1) out vec4 outNormal;
-layout(location = 2) out vec4 outMaterial;
 
 layout(set = 1, binding = 0) uniform sampler texSampler;
 layout(constant_id = 0) const uint TEXTURE_COUNT = 1u;
 
-layout(push_constant) uniform constants {
+struct DrawData {
     uint Diffuse;
     uint Normal;
     uint Metallic;
     uint Roughness;
     uint AO;
     uint Emmisive;
-} material;
+    int pad0;
+    int pad1;
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+// one entry per indirect draw, firstInstance of the draw is the index
+layout(std430, set = 1, binding = 5) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
 
 layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 model;
@@ -39,18 +47,28 @@ layout(set = 1, binding = 2) uniform LightBuffer {
     PointLight pointLights[1];
 } lightBuffer;
 
+// Octahedral projection of the unit normal, quantized to 12 bits per axis and spread over three 8 bit channels
+vec3 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+
+    uvec2 q = uvec2(round(clamp(e * 0.5 + 0.5, 0.0, 1.0) * 4095.0));
+    return vec3(q.x >> 4, ((q.x & 15u) << 4) | (q.y >> 8), q.y & 255u) / 255.0;
+}
+
 void main() {
-    // Alpha cutout
-    const float alphaThreshold = 0.99;
-    vec4 albedoSample = texture(sampler2D(textures[nonuniformEXT(material.Diffuse)], texSampler), inTexCoord);
-    if (albedoSample.a < alphaThreshold) discard;
+    DrawData material = draws[inDrawIndex];
 
-    vec3 albedo    = albedoSample.rgb;
+    // No alpha test, the depth prepass already dropped the cut out texels and the equal test rejects them here
+    vec3 albedo    = texture(sampler2D(textures[nonuniformEXT(material.Diffuse)], texSampler), inTexCoord).rgb;
     float metallic = texture(sampler2D(textures[nonuniformEXT(material.Metallic)],  texSampler), inTexCoord).b;
     float roughness= texture(sampler2D(textures[nonuniformEXT(material.Roughness)], texSampler), inTexCoord).g;
-    float ao       = texture(sampler2D(textures[nonuniformEXT(material.AO)],        texSampler), inTexCoord).r;
 
-    vec3 n_ts = texture(sampler2D(textures[nonuniformEXT(material.Normal)], texSampler), inTexCoord).rgb * 2.0 - 1.0;
+    // Only X and Y are stored in cooked (BC5) normal maps, Z is rebuilt for both kinds
+    vec3 n_ts;
+    n_ts.xy = texture(sampler2D(textures[nonuniformEXT(material.Normal)], texSampler), inTexCoord).rg * 2.0 - 1.0;
+    n_ts.z = sqrt(max(1.0 - dot(n_ts.xy, n_ts.xy), 0.0));
 
 
     vec3 Tw = normalize(inTangent);
@@ -59,9 +77,8 @@ void main() {
     mat3 TBN = mat3(Tw, Bw, Nw);
 
     vec3 worldNormal = normalize(TBN * n_ts);
-    vec3 packedNormal = worldNormal * 0.5 + 0.5;
 
-    outAlbedo   = vec4(albedo, 1.0);
-    outNormal   = vec4(packedNormal, 1.0);
-    outMaterial = vec4(metallic, roughness, ao, 1.0);
+    // Material bits ride in the alpha channels, ao is never read by the lighting
+    outAlbedo   = vec4(albedo, metallic);
+    outNormal   = vec4(encodeNormal(worldNormal), roughness);
 }
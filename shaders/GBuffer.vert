@@ -1,18 +1,19 @@
 #version 450
 
-layout(location = 0) in vec3 inWorldPos;
-layout(location = 1) in vec3 inColor;
+// PackedVertex, one stream per attribute, see Structs/Mesh.h
+layout(location = 0) in vec4 inPosition;     // unorm inside the mesh bounds, w is the bitangent sign
+layout(location = 1) in vec4 inTangentFrame; // octahedral normal in xy, octahedral tangent in zw
 layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in vec3 inNormal;
-layout(location = 4) in vec3 inTangent;
-layout(location = 5) in vec3 inBitangent;
 
 layout(location = 0) out vec3 outWorldPos;
-layout(location = 1) out vec3 outColor;
 layout(location = 2) out vec2 outTexCoord;
 layout(location = 3) out vec3 outNormal;
 layout(location = 4) out vec3 outTangent;
 layout(location = 5) out vec3 outBitangent;
+layout(location = 6) flat out uint outDrawIndex;
+
+// Depth tested with equal against the prepass, the expression matches depth.vert and depthopaque.vert
+invariant gl_Position;
 
 
 layout(set = 0, binding = 0) uniform UniformBufferObject {
@@ -22,19 +23,50 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
         vec3 cameraPos;
 } ubo;
 
+struct DrawData {
+    uint Diffuse;
+    uint Normal;
+    uint Metallic;
+    uint Roughness;
+    uint AO;
+    uint Emmisive;
+    int pad0;
+    int pad1;
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+layout(std430, set = 1, binding = 5) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+vec3 octahedralDecode(vec2 e)
+{
+        vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+        float t = clamp(-n.z, 0.0, 1.0);
+        n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+        return normalize(n);
+}
+
 void main() {
-        vec4 worldPos = ubo.model * vec4(inWorldPos, 1.0);
+        DrawData draw = draws[gl_InstanceIndex];
+        vec3 position = draw.positionOffset.xyz + inPosition.xyz * draw.positionScale.xyz;
+        vec4 worldPos = ubo.model * vec4(position, 1.0);
 
-        gl_Position = ubo.proj * ubo.view * worldPos;
+        // Not through worldPos, invariance only holds for the same expression
+        gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
+
+        outDrawIndex = gl_InstanceIndex;
+
+        vec3 normal = octahedralDecode(inTangentFrame.xy);
+        vec3 tangent = octahedralDecode(inTangentFrame.zw);
+        vec3 bitangent = cross(normal, tangent) * (inPosition.w * 2.0 - 1.0);
 
-        outColor = inColor;
         outTexCoord = inTexCoord;
         outWorldPos = worldPos.xyz;
         mat3 normalMatrix = transpose(inverse(mat3(ubo.model)));
-        outNormal = normalize(normalMatrix * inNormal);
-        outTangent = normalize(normalMatrix * inTangent);
-        outBitangent = normalize(normalMatrix * inBitangent);
+        outNormal = normalize(normalMatrix * normal);
+        outTangent = normalize(normalMatrix * tangent);
+        outBitangent = normalize(normalMatrix * bitangent);
 
 }
-
-
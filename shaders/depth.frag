@@ -7,6 +7,7 @@ layout(location = 2) in vec2 inTexCoord;
 layout(location = 3) in vec3 inNormal;
 layout(location = 4) in vec3 inTangent;
 layout(location = 5) in vec3 inBitangent;
+layout(location = 6) flat in uint inDrawIndex;
 
 layout(location = 0) out vec4 outColor;
 layout(location = 1) out vec4 outNormal;
@@ -17,14 +18,23 @@ layout(location = 5) out vec3 outFragBitangent;
 
 layout(set = 1, binding = 0) uniform sampler texSampler;
 
-layout(push_constant) uniform constants {
+struct DrawData {
     uint Diffuse;
     uint Normal;
     uint Metallic;
     uint Roughness;
     uint AO;
     uint Emmisive;
-} material;
+    int pad0;
+    int pad1;
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+// one entry per indirect draw, firstInstance of the draw is the index
+layout(std430, set = 1, binding = 5) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
 
 layout(constant_id = 0) const uint TEXTURE_COUNT = 1u;
 layout(set = 1, binding = 1) uniform texture2D textures[TEXTURE_COUNT];
@@ -43,6 +53,8 @@ layout(set = 1, binding = 2) uniform LightBuffer {
 
 
 void main() {
+    DrawData material = draws[inDrawIndex];
+
     const float alphaThreshold = 0.99f;
     if (texture(sampler2D(textures[nonuniformEXT(material.Diffuse)], texSampler), inTexCoord).a < alphaThreshold)
        discard;
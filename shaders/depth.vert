@@ -1,11 +1,8 @@
 #version 450
 
-layout(location = 0) in vec3 inWorldPos;
-layout(location = 1) in vec3 inColor;
+// Position and texture coordinate streams, the tangent frames are not bound
+layout(location = 0) in vec4 inPosition;
 layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in vec3 inNormal;
-layout(location = 4) in vec3 inTangent;
-layout(location = 5) in vec3 inBitangent;
 
 layout(location = 0) out vec3 outWorldPos;
 layout(location = 1) out vec3 outColor;
@@ -13,6 +10,10 @@ layout(location = 2) out vec2 outTexCoord;
 layout(location = 3) out vec3 outNormal;
 layout(location = 4) out vec3 outTangent;
 layout(location = 5) out vec3 outBitangent;
+layout(location = 6) flat out uint outDrawIndex;
+
+// The G-buffer tests against this depth with equal, the expression matches depthopaque.vert and GBuffer.vert
+invariant gl_Position;
 
 
 
@@ -24,11 +25,31 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
         vec3 cameraPos;
 } ubo;
 
+struct DrawData {
+    uint Diffuse;
+    uint Normal;
+    uint Metallic;
+    uint Roughness;
+    uint AO;
+    uint Emmisive;
+    int pad0;
+    int pad1;
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+layout(std430, set = 1, binding = 5) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
 
 
 
 void main() {
-        gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inWorldPos, 1.0);
+        DrawData draw = draws[gl_InstanceIndex];
+        vec3 position = draw.positionOffset.xyz + inPosition.xyz * draw.positionScale.xyz;
+        gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
+        outDrawIndex = gl_InstanceIndex;
         outTexCoord = inTexCoord;
 
 }
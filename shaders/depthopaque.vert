@@ -0,0 +1,37 @@
+#version 450
+
+// Opaque draws of the depth prepass, the pipeline has no fragment stage and only binds the position stream
+layout(location = 0) in vec4 inPosition;
+
+// The G-buffer tests against this depth with equal, the expression matches depth.vert and GBuffer.vert
+invariant gl_Position;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+        mat4 model;
+        mat4 view;
+        mat4 proj;
+        vec3 cameraPos;
+} ubo;
+
+struct DrawData {
+    uint Diffuse;
+    uint Normal;
+    uint Metallic;
+    uint Roughness;
+    uint AO;
+    uint Emmisive;
+    int pad0;
+    int pad1;
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+layout(std430, set = 1, binding = 5) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+void main() {
+        DrawData draw = draws[gl_InstanceIndex];
+        vec3 position = draw.positionOffset.xyz + inPosition.xyz * draw.positionScale.xyz;
+        gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 1.0);
+}
@@ -10,22 +10,20 @@ layout (location = 2) in vec2 inTexCoord;
 layout (location = 0) out vec4 outColor;
 
 layout (set = 1, binding = 0) uniform sampler texSampler;
-layout (set = 1, binding = 4) uniform sampler shadowSampler;
 layout (constant_id = 0) const uint TEXTURE_COUNT = 1u;
 layout (set = 1, binding = 1) uniform texture2D textures[TEXTURE_COUNT];
 
+// Position.w is the light's range
 struct PointLight { vec4 Position; vec4 Color; };
 struct DirectionalLight { vec4 Direction; vec4 Color; };
 
-layout (constant_id = 2) const uint MAX_POINT_LIGHTS = 1u;
-layout (constant_id = 3) const uint MAX_DIRECTIONAL_LIGHTS = 1u;
-
+// Both arrays are sized by the counts in the UBO
 layout (set = 1, binding = 2, std430) readonly buffer PointLightBuffer {
-    PointLight pointLights[MAX_POINT_LIGHTS];
+    PointLight pointLights[];
 } pointLightBuffer;
 
 layout (set = 1, binding = 3, std430) readonly buffer DirLightBuffer {
-    DirectionalLight dirLights[MAX_DIRECTIONAL_LIGHTS];
+    DirectionalLight dirLights[];
 } dirLightBuffer;
 
 layout (std140, binding = 0) uniform UBO {
@@ -33,22 +31,37 @@ layout (std140, binding = 0) uniform UBO {
     mat4 view;
     mat4 proj;
     vec3 cameraPos;
+    uint pointLightCount;
+    uint directionalLightCount;
 } ubo;
 
 layout (set = 0, binding = 1) uniform texture2D Diffuse;
 layout (set = 0, binding = 2) uniform texture2D Normal;
-layout (set = 0, binding = 3) uniform texture2D Material;
 layout (set = 0, binding = 4) uniform texture2D Depth;
 
-layout (std140, binding = 5) uniform shadowUBO {
-    mat4 view;
-    mat4 proj;
-} shadowUbo;
-
-layout (set = 0, binding = 6) uniform texture2D Shadow[MAX_DIRECTIONAL_LIGHTS];
 layout (set = 0, binding = 7) uniform textureCube EnviromentMap;
 layout (set = 0, binding = 8) uniform textureCube irradianceMap;
 
+// Matches ShadowMaskPass::Downscale, one channel per directional light
+#define SHADOW_MASK_SCALE 2
+#define SHADOW_MASK_CHANNELS 4
+layout (set = 0, binding = 9, rgba8) uniform readonly image2D ShadowMask;
+
+// Matches ClusterPass, the lists are built by cluster.comp each frame
+#define CLUSTER_TILES_X 16
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+#define CLUSTER_MAX_LIGHTS 128
+#define CLUSTER_COUNT (CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES)
+
+layout (set = 1, binding = 6, std430) readonly buffer ClusterLights {
+    uint counts[CLUSTER_COUNT];
+    uint indices[];
+} clusters;
+
+// Relative view depth difference at which a mask texel's weight drops to 1/e
+const float SHADOW_MASK_DEPTH_SIGMA = 0.02;
+
 const bool USE_DIRECT_RADIANCE = true;
 const bool USE_IRRADIANCE = true;
 const bool OUTPUT_SHADOWS_ONLY = false;
@@ -102,64 +115,77 @@ vec3 reconstructWorldPos(float depth, mat4 invProj) {
 
 }
 
-// PCF tent using textureGather ( this is faster for cpu, yey)
-float sampleShadowPCF_Tent(texture2D img, sampler cmp, vec3 uvz, vec2 texelSize, int r)
-{
+float linearDepth(float depth) {
+    return ubo.proj[3][2] / (depth + ubo.proj[2][2]);
+}
 
-    // sum of all tent weights for radius r is (r+1)^4
-    float inv_wsum = 1.0 / float((r + 1) * (r + 1) * (r + 1) * (r + 1));
-    float sum = 0.0;
+// Depth aware upsample of the shadow mask: bilinear weights of the four closest mask texels, each one fading out the
+// further the depth of the pixel it was resolved at lies from this pixel's depth
+vec4 upsampleShadowMask(float depth)
+{
+    ivec2 maskSize = imageSize(ShadowMask);
+    ivec2 depthSize = textureSize(sampler2D(Depth, texSampler), 0);
 
+    vec2 maskPos = (gl_FragCoord.xy - 0.5) / float(SHADOW_MASK_SCALE);
+    ivec2 base = ivec2(floor(maskPos));
+    vec2 f = maskPos - vec2(base);
+    float z = linearDepth(depth);
 
-    // move in steps of 2x2
-    for (int y = -r; y <= r; y += 2)
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for (int y = 0; y < 2; ++y)
     {
-        float wy0 = float(r + 1 - abs(y)); // weight for y row
-        float wy1 = (abs(y + 1) <= r) ? float(r + 1 - abs(y + 1)) : 0.0; // weight for y+1 row or 0
-
-        // corner of two texels so the future texture gather can see both rows, (idea from gp1 when i did soft shadows)
-        float offy_corner = (float(y) + 0.5) * texelSize.y;
-
-        for (int x = -r; x <= r; x += 2)
+        for (int x = 0; x < 2; ++x)
         {
-            // This computes a weight for the offset x
-            float wx0 = float(r + 1 - abs(x));
-            // This computes the weight for the next sample (x + 1).
-            // If that sample is still inside the filter radius (abs(x+1) <= r), it gets the same triangular weight formula
-            // otherwise 0
-            float wx1 = (abs(x + 1) <= r) ? float(r + 1 - abs(x + 1)) : 0.0;
-
-            float offx_corner = (float(x) + 0.5) * texelSize.x;
+            ivec2 texel = clamp(base + ivec2(x, y), ivec2(0), maskSize - 1);
+            ivec2 pixel = min(texel * SHADOW_MASK_SCALE, depthSize - 1);
+            float zTexel = linearDepth(texelFetch(sampler2D(Depth, texSampler), pixel, 0).r);
 
+            float bilinear = (x == 0 ? 1.0 - f.x : f.x) * (y == 0 ? 1.0 - f.y : f.y);
+            float w = bilinear * exp(-abs(zTexel - z) / (SHADOW_MASK_DEPTH_SIGMA * z)) + 1e-4;
 
-            // we gather ath the corner of the following texels:
-            // (x,y), (x+1,y), (x,y+1), (x+1,y+1)
+            sum += w * imageLoad(ShadowMask, texel);
+            weightSum += w;
+        }
+    }
+    return sum / weightSum;
+}
 
-            // add offset to center of UV to be between 4 texels
-            vec2 p = uvz.xy + vec2(offx_corner, offy_corner);
+// Same tiling and exponential slices as cluster.comp
+uint clusterIndex(float depth)
+{
+    ivec2 depthSize = textureSize(sampler2D(Depth, texSampler), 0);
+    ivec2 tileSize = (depthSize + ivec2(CLUSTER_TILES_X, CLUSTER_TILES_Y) - 1) / ivec2(CLUSTER_TILES_X, CLUSTER_TILES_Y);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy) / tileSize, ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
 
+    float nearPlane = ubo.proj[3][2] / ubo.proj[2][2];
+    float farPlane = ubo.proj[3][2] / (ubo.proj[2][2] + 1.0);
+    int slice = int(log(linearDepth(depth) / nearPlane) * float(CLUSTER_SLICES) / log(farPlane / nearPlane));
+    slice = clamp(slice, 0, CLUSTER_SLICES - 1);
 
-            // https://registry.khronos.org/OpenGL-Refpages/gl4/html/textureGather.xhtml
-            vec4 d4 = textureGather(sampler2D(img, cmp), p, 0);
+    return (uint(slice) * CLUSTER_TILES_Y + uint(tile.y)) * CLUSTER_TILES_X + uint(tile.x);
+}
 
-            // Branchless compare -> same as in unreal step node, good for compare!!!! // https://gamedev.stackexchange.com/questions/201792/what-does-the-step-node-do-in-unreal-engine
-            vec4 v4 = step(vec4(uvz.z), d4);
+// Inverse square falloff windowed to reach zero at the light's range
+float pointLightAttenuation(float distance, float range)
+{
+    float ratio = distance / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window / max(distance * distance, 0.0001);
+}
 
-            // Tent weights for the 2×2 taps, IMPORTANT: row weight × column weight FROM ABOVE ^
-            float w00 = wx0 * wy0; // (x,y)
-            float w10 = wx1 * wy0; // (x+1,y)
-            float w01 = wx0 * wy1; // (x,y+1)
-            float w11 = wx1 * wy1; // (x+1,y+1)
+// Inverse of the G-buffer encoding, two 12 bit octahedral coordinates spread over three 8 bit channels
+vec3 decodeNormal(vec3 packedNormal)
+{
+    uvec3 b = uvec3(round(packedNormal * 255.0));
+    vec2 e = vec2((b.x << 4) | (b.y >> 4), ((b.y & 15u) << 8) | b.z) / 4095.0 * 2.0 - 1.0;
 
-            // Accumulate in same order as above, use dot because it does the v4.x*w00 + v4.y*w10 + v4.z*w01 + v4.w*w11
-            sum += dot(v4, vec4(w00, w10, w01, w11));
-        }
-    }
-    // normalize to 0 - 1
-    return sum * inv_wsum;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
 }
 
-
 void main() {
     float depth = texelFetch(sampler2D(Depth, texSampler), ivec2(gl_FragCoord.xy), 0).r;
     vec3 worldPos = reconstructWorldPos(depth, inverse(ubo.proj));
@@ -174,13 +200,13 @@ void main() {
         return;
     }
 
-    vec3 albedo = texture(sampler2D(Diffuse, texSampler), inTexCoord).rgb;
-    float metallic = texture(sampler2D(Material, texSampler), inTexCoord).r;
-    float roughness = texture(sampler2D(Material, texSampler), inTexCoord).g;
-    metallic = clamp(metallic, 0.0, 1.0);
-    roughness = clamp(roughness, 0.04, 1.0);
+    vec4 albedoMetallic = texelFetch(sampler2D(Diffuse, texSampler), ivec2(gl_FragCoord.xy), 0);
+    vec4 normalRoughness = texelFetch(sampler2D(Normal, texSampler), ivec2(gl_FragCoord.xy), 0);
+    vec3 albedo = albedoMetallic.rgb;
+    float metallic = clamp(albedoMetallic.a, 0.0, 1.0);
+    float roughness = clamp(normalRoughness.a, 0.04, 1.0);
 
-    vec3 N = normalize(texture(sampler2D(Normal, texSampler), inTexCoord).xyz) ; // this should have * 2 - 1 but with it i get weird artifacts, this only makes the normals be shiny
+    vec3 N = normalize(decodeNormal(normalRoughness.rgb) * 0.5 + 0.5); // this should have * 2 - 1 but with it i get weird artifacts, this only makes the normals be shiny
 
     vec3 V = normalize(ubo.cameraPos - worldPos);
     vec3 F0 = mix(vec3(0.04), albedo, metallic);
@@ -192,13 +218,20 @@ void main() {
 
     float minVis = 1.0;
 
-    for (int i = 0; i < int(MAX_POINT_LIGHTS); ++i) {
+    vec4 maskVisibility = upsampleShadowMask(depth);
+
+    // Only the lights assigned to this pixel's cluster
+    uint cluster = clusterIndex(depth);
+    uint clusterLights = min(clusters.counts[cluster], uint(CLUSTER_MAX_LIGHTS));
+
+    for (uint c = 0; c < clusterLights; ++c) {
+        uint i = clusters.indices[cluster * CLUSTER_MAX_LIGHTS + c];
         vec3 lightPos = pointLightBuffer.pointLights[i].Position.xyz;
         vec3 L = normalize(lightPos - worldPos);
         vec3 H = normalize(V + L);
 
         float distance = length(lightPos - worldPos);
-        float attenuation = 1.0 / max(distance * distance, 0.0001);
+        float attenuation = pointLightAttenuation(distance, pointLightBuffer.pointLights[i].Position.w);
         vec3 radiance = pointLightBuffer.pointLights[i].Color.xyz
         * pointLightBuffer.pointLights[i].Color.w * attenuation;
 
@@ -221,7 +254,7 @@ void main() {
         lightCount += 1.0;
     }
 
-    for (int i = 0; i < int(MAX_DIRECTIONAL_LIGHTS); ++i) {
+    for (int i = 0; i < int(ubo.directionalLightCount); ++i) {
         vec3 L = normalize(-dirLightBuffer.dirLights[i].Direction.xyz);
         vec3 H = normalize(V + L);
         vec3 radiance = dirLightBuffer.dirLights[i].Color.xyz
@@ -239,17 +272,8 @@ void main() {
 
         float NdotL = max(dot(N, L), 0.0);
 
-        // Shadowing
-        vec4 lightSpacePosition = shadowUbo.proj * shadowUbo.view * vec4(worldPos, 1.0);
-        lightSpacePosition /= lightSpacePosition.w;
-        vec3 shadowMapUV = vec3(lightSpacePosition.xy * 0.5 + 0.5, lightSpacePosition.z);
-
-        ivec2 sz = textureSize(sampler2D(Shadow[i], shadowSampler), 0);
-        vec2 texelSize = 1.0 / vec2(sz);
-
-        float vis = sampleShadowPCF_Tent(Shadow[i], shadowSampler,
-                                         vec3(shadowMapUV.xy, shadowMapUV.z),
-                                         texelSize, 20);
+        // Shadowing, lights past the mask's channels stay unshadowed
+        float vis = i < SHADOW_MASK_CHANNELS ? maskVisibility[i] : 1.0;
 
         minVis = min(minVis, vis);
 
@@ -1,11 +1,7 @@
 #version 450
 
-layout(location = 0) in vec3 inWorldPos;
-layout(location = 1) in vec3 inColor;
-layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in vec3 inNormal;
-layout(location = 4) in vec3 inTangent;
-layout(location = 5) in vec3 inBitangent;
+// Position stream only
+layout(location = 0) in vec4 inPosition;
 
 layout(location = 0) out vec3 outWorldPos;
 layout(location = 1) out vec3 outColor;
@@ -16,11 +12,35 @@ layout(location = 5) out vec3 outBitangent;
 
 
 
-layout(std140, binding = 5) uniform shadowUBO {
-        mat4 view;
-        mat4 proj;
-} ubo;
+layout(push_constant) uniform ShadowPush {
+        uint shadowView;
+} push;
+
+// One proj * view per shadow layer, the push constant picks the one this draw renders
+layout(std430, set = 0, binding = 5) readonly buffer ShadowViews {
+        vec4 splitDepths;
+        mat4 viewProj[];
+} views;
+
+struct DrawData {
+    uint Diffuse;
+    uint Normal;
+    uint Metallic;
+    uint Roughness;
+    uint AO;
+    uint Emmisive;
+    int pad0;
+    int pad1;
+    vec4 positionOffset;
+    vec4 positionScale;
+};
+
+layout(std430, set = 1, binding = 5) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
 
 void main() {
-        gl_Position = ubo.proj * ubo.view * vec4(inWorldPos, 1.0);
+        DrawData draw = draws[gl_InstanceIndex];
+        vec3 position = draw.positionOffset.xyz + inPosition.xyz * draw.positionScale.xyz;
+        gl_Position = views.viewProj[push.shadowView] * vec4(position, 1.0);
 }
@@ -0,0 +1,31 @@
+#version 450
+
+// Brings the HDR output of the compute lighting path to the swapchain, same curve as shader.frag
+layout (location = 0) out vec4 outColor;
+
+// Alpha 0 marks the sky, stored as it is displayed
+layout (set = 0, binding = 10, rgba16f) uniform readonly image2D HDRColor;
+
+vec3 Uncharted2Tonemap(vec3 x) {
+    float A = 0.15, B = 0.50, C = 0.10, D = 0.20, E = 0.02, F = 0.30;
+    return ((x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F)) - E / F;
+}
+vec3 ToneMapUncharted2(vec3 color) {
+    float exposure = 2.0; color *= exposure;
+    const float W = 11.2;
+    vec3 mapped = Uncharted2Tonemap(color);
+    vec3 whiteScale = 1.0 / Uncharted2Tonemap(vec3(W));
+    return mapped * whiteScale;
+}
+
+void main() {
+    vec4 hdr = imageLoad(HDRColor, ivec2(gl_FragCoord.xy));
+    if (hdr.a < 0.5) {
+        outColor = vec4(hdr.rgb, 1.0);
+        return;
+    }
+
+    vec3 color = ToneMapUncharted2(hdr.rgb);
+    color = pow(color, vec3(1.0 / 2.2));
+    outColor = vec4(color, 1.0);
+}
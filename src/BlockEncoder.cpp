@@ -0,0 +1,284 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "BlockEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace {
+    // Interpolation weights of the 4 bit BC7 indices, out of 64
+    constexpr int Mode6Weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    struct Mode6Endpoints {
+        uint8_t color[2][4]; // 7 bits per channel
+        uint8_t pbit[2];
+    };
+
+    // Bits go in LSB first, the way the block is laid out
+    struct BitWriter {
+        uint8_t *block;
+        uint32_t position{};
+
+        void Write(uint32_t value, uint32_t count) {
+            for (uint32_t i = 0; i < count; ++i, ++position) {
+                if ((value >> i) & 1u) {
+                    block[position >> 3] |= static_cast<uint8_t>(1u << (position & 7u));
+                }
+            }
+        }
+    };
+
+    // Both p-bits are tried, the one that lands all four channels closer wins
+    void QuantizeEndpoint(const float value[4], uint8_t color[4], uint8_t &pbit) {
+        float bestError = std::numeric_limits<float>::max();
+        for (uint8_t p = 0; p < 2; ++p) {
+            uint8_t quantized[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; ++c) {
+                const float v = std::clamp(value[c], 0.0f, 255.0f);
+                quantized[c] = static_cast<uint8_t>(std::clamp(static_cast<int>(std::lround((v - p) * 0.5f)), 0, 127));
+                const float d = static_cast<float>((quantized[c] << 1) | p) - v;
+                error += d * d;
+            }
+            if (error < bestError) {
+                bestError = error;
+                std::memcpy(color, quantized, 4);
+                pbit = p;
+            }
+        }
+    }
+
+    Mode6Endpoints QuantizeEndpoints(const float low[4], const float high[4]) {
+        Mode6Endpoints endpoints{};
+        QuantizeEndpoint(low, endpoints.color[0], endpoints.pbit[0]);
+        QuantizeEndpoint(high, endpoints.color[1], endpoints.pbit[1]);
+        return endpoints;
+    }
+
+    // Closest palette entry per texel against the palette the decoder rebuilds, returns the summed squared error
+    uint32_t FindIndices(const uint8_t *rgba, const Mode6Endpoints &endpoints, uint8_t indices[16]) {
+        int expanded[2][4];
+        for (int e = 0; e < 2; ++e) {
+            for (int c = 0; c < 4; ++c) {
+                expanded[e][c] = (endpoints.color[e][c] << 1) | endpoints.pbit[e];
+            }
+        }
+
+        int palette[16][4];
+        for (int i = 0; i < 16; ++i) {
+            for (int c = 0; c < 4; ++c) {
+                palette[i][c] = ((64 - Mode6Weights[i]) * expanded[0][c] + Mode6Weights[i] * expanded[1][c] + 32) >> 6;
+            }
+        }
+
+        uint32_t total = 0;
+        for (uint32_t t = 0; t < BlockEncoder::TexelCount; ++t) {
+            uint32_t best = std::numeric_limits<uint32_t>::max();
+            for (uint8_t i = 0; i < 16; ++i) {
+                uint32_t error = 0;
+                for (int c = 0; c < 4; ++c) {
+                    const int d = palette[i][c] - rgba[t * 4 + c];
+                    error += static_cast<uint32_t>(d * d);
+                }
+                if (error < best) {
+                    best = error;
+                    indices[t] = i;
+                }
+            }
+            total += best;
+        }
+        return total;
+    }
+
+    // Least squares endpoints for fixed indices, fails when every texel picked the same weight
+    bool RefitEndpoints(const uint8_t *rgba, const uint8_t indices[16], float low[4], float high[4]) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4]{}, bx[4]{};
+        for (uint32_t t = 0; t < BlockEncoder::TexelCount; ++t) {
+            const float b = static_cast<float>(Mode6Weights[indices[t]]) / 64.0f;
+            const float a = 1.0f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < 4; ++c) {
+                ax[c] += a * rgba[t * 4 + c];
+                bx[c] += b * rgba[t * 4 + c];
+            }
+        }
+
+        const float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f) {
+            return false;
+        }
+
+        for (int c = 0; c < 4; ++c) {
+            low[c] = (bb * ax[c] - ab * bx[c]) / determinant;
+            high[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+        }
+        return true;
+    }
+}
+
+void BlockEncoder::EncodeBC4(const uint8_t *Texels, uint8_t *Block) {
+    uint8_t low = 255, high = 0;
+    for (uint32_t t = 0; t < TexelCount; ++t) {
+        low = std::min(low, Texels[t]);
+        high = std::max(high, Texels[t]);
+    }
+
+    // red0 > red1 selects the eight entry palette, equal endpoints the six entry one where index 0 is still red0
+    Block[0] = high;
+    Block[1] = low;
+
+    uint64_t bits = 0;
+    if (high > low) {
+        int palette[8];
+        palette[0] = high;
+        palette[1] = low;
+        for (int k = 1; k < 7; ++k) {
+            palette[k + 1] = ((7 - k) * high + k * low + 3) / 7;
+        }
+
+        for (uint32_t t = 0; t < TexelCount; ++t) {
+            uint64_t best = 0;
+            int bestError = std::numeric_limits<int>::max();
+            for (uint64_t i = 0; i < 8; ++i) {
+                const int error = std::abs(palette[i] - Texels[t]);
+                if (error < bestError) {
+                    bestError = error;
+                    best = i;
+                }
+            }
+            bits |= best << (3 * t);
+        }
+    }
+
+    for (int i = 0; i < 6; ++i) {
+        Block[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+}
+
+void BlockEncoder::EncodeBC5(const uint8_t *Red, const uint8_t *Green, uint8_t *Block) {
+    EncodeBC4(Red, Block);
+    EncodeBC4(Green, Block + 8);
+}
+
+void BlockEncoder::EncodeBC7(const uint8_t *Rgba, uint8_t *Block) {
+    float mean[4]{};
+    for (uint32_t t = 0; t < TexelCount; ++t) {
+        for (int c = 0; c < 4; ++c) {
+            mean[c] += Rgba[t * 4 + c];
+        }
+    }
+    for (float &m: mean) {
+        m /= static_cast<float>(TexelCount);
+    }
+
+    float covariance[4][4]{};
+    for (uint32_t t = 0; t < TexelCount; ++t) {
+        float d[4];
+        for (int c = 0; c < 4; ++c) {
+            d[c] = Rgba[t * 4 + c] - mean[c];
+        }
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                covariance[i][j] += d[i] * d[j];
+            }
+        }
+    }
+
+    // Power iteration from the channel that varies the most
+    int widest = 0;
+    for (int c = 1; c < 4; ++c) {
+        if (covariance[c][c] > covariance[widest][widest]) {
+            widest = c;
+        }
+    }
+    float axis[4]{};
+    axis[widest] = 1.0f;
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[4]{};
+        float length = 0.0f;
+        for (int i = 0; i < 4; ++i) {
+            for (int j = 0; j < 4; ++j) {
+                next[i] += covariance[i][j] * axis[j];
+            }
+            length = std::max(length, std::abs(next[i]));
+        }
+        if (length < 1e-6f) {
+            break;
+        }
+        for (int i = 0; i < 4; ++i) {
+            axis[i] = next[i] / length;
+        }
+    }
+    const float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+    for (float &a: axis) {
+        a /= axisLength;
+    }
+
+    float minProjection = 0.0f, maxProjection = 0.0f;
+    for (uint32_t t = 0; t < TexelCount; ++t) {
+        float projection = 0.0f;
+        for (int c = 0; c < 4; ++c) {
+            projection += (Rgba[t * 4 + c] - mean[c]) * axis[c];
+        }
+        minProjection = std::min(minProjection, projection);
+        maxProjection = std::max(maxProjection, projection);
+    }
+
+    float low[4], high[4];
+    for (int c = 0; c < 4; ++c) {
+        low[c] = mean[c] + axis[c] * minProjection;
+        high[c] = mean[c] + axis[c] * maxProjection;
+    }
+
+    Mode6Endpoints endpoints = QuantizeEndpoints(low, high);
+    uint8_t indices[TexelCount];
+    uint32_t error = FindIndices(Rgba, endpoints, indices);
+
+    for (int refit = 0; refit < 2 && error > 0; ++refit) {
+        if (!RefitEndpoints(Rgba, indices, low, high)) {
+            break;
+        }
+
+        const Mode6Endpoints candidate = QuantizeEndpoints(low, high);
+        uint8_t candidateIndices[TexelCount];
+        const uint32_t candidateError = FindIndices(Rgba, candidate, candidateIndices);
+        if (candidateError >= error) {
+            break;
+        }
+
+        endpoints = candidate;
+        error = candidateError;
+        std::memcpy(indices, candidateIndices, sizeof(indices));
+    }
+
+    // The anchor texel only stores 3 index bits, its top bit has to be zero
+    if (indices[0] & 8u) {
+        std::swap(endpoints.color[0], endpoints.color[1]);
+        std::swap(endpoints.pbit[0], endpoints.pbit[1]);
+        for (uint8_t &index: indices) {
+            index = 15 - index;
+        }
+    }
+
+    std::memset(Block, 0, 16);
+    BitWriter writer{Block};
+    writer.Write(1u << 6, 7);
+    for (int c = 0; c < 4; ++c) {
+        writer.Write(endpoints.color[0][c], 7);
+        writer.Write(endpoints.color[1][c], 7);
+    }
+    writer.Write(endpoints.pbit[0], 1);
+    writer.Write(endpoints.pbit[1], 1);
+    writer.Write(indices[0], 3);
+    for (uint32_t t = 1; t < TexelCount; ++t) {
+        writer.Write(indices[t], 4);
+    }
+}
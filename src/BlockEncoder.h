@@ -0,0 +1,29 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef BLOCKENCODER_H
+#define BLOCKENCODER_H
+
+#include <cstdint>
+
+// CPU encoders for single 4x4 blocks of the BC formats the texture cache cooks into.
+// Texels are passed row major, 16 per block. Stateless, so any number of threads can encode at once.
+class BlockEncoder {
+public:
+    static constexpr uint32_t BlockDim = 4;
+    static constexpr uint32_t TexelCount = BlockDim * BlockDim;
+
+    // One channel into 8 bytes, endpoints at the block's min and max with the six values in between
+    static void EncodeBC4(const uint8_t *Texels, uint8_t *Block);
+
+    // Two channels into 16 bytes, one BC4 block each
+    static void EncodeBC5(const uint8_t *Red, const uint8_t *Green, uint8_t *Block);
+
+    // RGBA into 16 bytes. Only mode 6 is searched: a single subset with 7.7.7.7 endpoints plus a p-bit and 4 bit
+    // indices. The endpoints start on the principal axis of the block and get refit to the chosen indices
+    static void EncodeBC7(const uint8_t *Rgba, uint8_t *Block);
+};
+
+
+#endif //BLOCKENCODER_H
@@ -28,6 +28,11 @@ public:
 
     glm::mat4 GetProjectionMatrix(float aspectRatio) const;
 
+    // Vertical field of view in degrees
+    float GetFov() const { return fov; }
+    float GetNearPlane() const { return nearPlane; }
+    float GetFarPlane() const { return farPlane; }
+
     float yaw = -90.0f;
     float pitch = 0.0f;
 
@@ -18,13 +18,15 @@
 
 void DescriptorSets::CreateFrameDescriptorSet(
     const vk::DescriptorSetLayout &FrameLayout,
-    const std::tuple<vk::ImageView, vk::ImageView, vk::ImageView> &ColorImageViews,
+    const std::pair<vk::ImageView, vk::ImageView> &ColorImageViews,
     const vk::ImageView &DepthImageView,
-    const BufferInfo &UniformBufferInfo,
-    const BufferInfo &ShadowBufferInfo,
+    const BufferInfo &UniformRing,
+    uint32_t ShadowViews,
     const std::vector<vk::ImageView> &ShadowImageViews,
     const vk::ImageView& CubemapImage,
-    const vk::ImageView& IrradianceImage
+    const vk::ImageView& IrradianceImage,
+    const vk::ImageView& ShadowMaskImage,
+    const vk::ImageView& HDRImage
     )
 {
 
@@ -42,34 +44,29 @@ void DescriptorSets::CreateFrameDescriptorSet(
 
     // Descriptor buffer info
     vk::DescriptorBufferInfo bufferInfo{};
-    bufferInfo.buffer = UniformBufferInfo.m_Buffer;
+    bufferInfo.buffer = UniformRing.m_Buffer;
     bufferInfo.offset = 0;
     bufferInfo.range = sizeof(MVP);
 
     vk::DescriptorImageInfo DiffuseImageInfo{};
     DiffuseImageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    DiffuseImageInfo.imageView = std::get<0>(ColorImageViews);
+    DiffuseImageInfo.imageView = ColorImageViews.first;
     DiffuseImageInfo.sampler = nullptr;
 
     vk::DescriptorImageInfo NormalImageInfo{};
     NormalImageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    NormalImageInfo.imageView = std::get<1>(ColorImageViews);
+    NormalImageInfo.imageView = ColorImageViews.second;
     NormalImageInfo.sampler = nullptr;
 
-    vk::DescriptorImageInfo MaterialImageInfo{};
-    MaterialImageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    MaterialImageInfo.imageView = std::get<2>(ColorImageViews);
-    MaterialImageInfo.sampler = nullptr;
-
     vk::DescriptorImageInfo DepthImageInfo{};
     DepthImageInfo.imageLayout = vk::ImageLayout::eDepthReadOnlyOptimal;
     DepthImageInfo.imageView = DepthImageView;
     DepthImageInfo.sampler = nullptr;
 
     vk::DescriptorBufferInfo shadowBufferInfo{};
-    shadowBufferInfo.buffer = ShadowBufferInfo.m_Buffer;
+    shadowBufferInfo.buffer = UniformRing.m_Buffer;
     shadowBufferInfo.offset = 0;
-    shadowBufferInfo.range = sizeof(ShadowMVP);
+    shadowBufferInfo.range = sizeof(ShadowViewsHeader) + sizeof(glm::mat4) * ShadowViews;
 
     vk::DescriptorImageInfo CubemapImageInfo{};
     CubemapImageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
@@ -81,11 +78,21 @@ void DescriptorSets::CreateFrameDescriptorSet(
     IrradianceImageInfo.imageView = IrradianceImage;
     IrradianceImageInfo.sampler = nullptr;
 
+    vk::DescriptorImageInfo ShadowMaskImageInfo{};
+    ShadowMaskImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+    ShadowMaskImageInfo.imageView = ShadowMaskImage;
+    ShadowMaskImageInfo.sampler = nullptr;
+
+    vk::DescriptorImageInfo HDRImageInfo{};
+    HDRImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+    HDRImageInfo.imageView = HDRImage;
+    HDRImageInfo.sampler = nullptr;
+
     std::vector<vk::DescriptorImageInfo> shadowImageInfos;
     shadowImageInfos.reserve(ShadowImageViews.size());
     for (const auto& view : ShadowImageViews) {
         vk::DescriptorImageInfo info{};
-        info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        info.imageLayout = vk::ImageLayout::eDepthReadOnlyOptimal;
         info.imageView = view;
         info.sampler = nullptr;
         shadowImageInfos.push_back(info);
@@ -100,7 +107,7 @@ void DescriptorSets::CreateFrameDescriptorSet(
         writeUBO.dstBinding = 0;
         writeUBO.dstArrayElement = 0;
         writeUBO.descriptorCount = 1;
-        writeUBO.descriptorType = vk::DescriptorType::eUniformBuffer;
+        writeUBO.descriptorType = vk::DescriptorType::eUniformBufferDynamic;
         writeUBO.pBufferInfo = &bufferInfo;
         writes.push_back(writeUBO);
 
@@ -124,15 +131,6 @@ void DescriptorSets::CreateFrameDescriptorSet(
         writeNormal.pImageInfo = &NormalImageInfo;
         writes.push_back(writeNormal);
 
-        // Material texture
-        vk::WriteDescriptorSet writeMaterial{};
-        writeMaterial.dstSet = ds;
-        writeMaterial.dstBinding = 3;
-        writeMaterial.dstArrayElement = 0;
-        writeMaterial.descriptorCount = 1;
-        writeMaterial.descriptorType = vk::DescriptorType::eSampledImage;
-        writeMaterial.pImageInfo = &MaterialImageInfo;
-        writes.push_back(writeMaterial);
 
         // Depth texture
         vk::WriteDescriptorSet writeDepth{};
@@ -144,15 +142,15 @@ void DescriptorSets::CreateFrameDescriptorSet(
         writeDepth.pImageInfo = &DepthImageInfo;
         writes.push_back(writeDepth);
 
-        // Shadow UBO
-        vk::WriteDescriptorSet writeShadowUBO{};
-        writeShadowUBO.dstSet = ds;
-        writeShadowUBO.dstBinding = 5;
-        writeShadowUBO.dstArrayElement = 0;
-        writeShadowUBO.descriptorCount = 1;
-        writeShadowUBO.descriptorType = vk::DescriptorType::eUniformBuffer;
-        writeShadowUBO.pBufferInfo = &shadowBufferInfo;
-        writes.push_back(writeShadowUBO);
+        // Shadow views
+        vk::WriteDescriptorSet writeShadowViews{};
+        writeShadowViews.dstSet = ds;
+        writeShadowViews.dstBinding = 5;
+        writeShadowViews.dstArrayElement = 0;
+        writeShadowViews.descriptorCount = 1;
+        writeShadowViews.descriptorType = vk::DescriptorType::eStorageBufferDynamic;
+        writeShadowViews.pBufferInfo = &shadowBufferInfo;
+        writes.push_back(writeShadowViews);
 
         // Shadow texture array
         vk::WriteDescriptorSet writeShadowTextures{};
@@ -182,6 +180,26 @@ void DescriptorSets::CreateFrameDescriptorSet(
         writeIrradiance.pImageInfo = &CubemapImageInfo;
         writes.push_back(writeIrradiance);
 
+        // Shadow mask, written by the mask pass and read by the lighting pass
+        vk::WriteDescriptorSet writeShadowMask{};
+        writeShadowMask.dstSet = ds;
+        writeShadowMask.dstBinding = 9;
+        writeShadowMask.dstArrayElement = 0;
+        writeShadowMask.descriptorCount = 1;
+        writeShadowMask.descriptorType = vk::DescriptorType::eStorageImage;
+        writeShadowMask.pImageInfo = &ShadowMaskImageInfo;
+        writes.push_back(writeShadowMask);
+
+        // Output of the compute lighting path, read by the tonemap pass
+        vk::WriteDescriptorSet writeHDR{};
+        writeHDR.dstSet = ds;
+        writeHDR.dstBinding = 10;
+        writeHDR.dstArrayElement = 0;
+        writeHDR.descriptorCount = 1;
+        writeHDR.descriptorType = vk::DescriptorType::eStorageImage;
+        writeHDR.pImageInfo = &HDRImageInfo;
+        writes.push_back(writeHDR);
+
         m_Device.updateDescriptorSets(writes, {});
     }
 }
@@ -192,22 +210,35 @@ void DescriptorSets::CreateDescriptorPool(uint32_t DirectionalLights) {
 
 
     vk::DescriptorPoolSize UboPoolSize{};
-    UboPoolSize.type = vk::DescriptorType::eUniformBuffer;
-    UboPoolSize.descriptorCount = 4;
+    UboPoolSize.type = vk::DescriptorType::eUniformBufferDynamic;
+    UboPoolSize.descriptorCount = 2;
 
     vk::DescriptorPoolSize SamplerPoolSize{};
     SamplerPoolSize.type = vk::DescriptorType::eSampler;
-    SamplerPoolSize.descriptorCount = 4;
+    SamplerPoolSize.descriptorCount = 6;
 
     vk::DescriptorPoolSize TexturesPoolSize{};
     TexturesPoolSize.type = vk::DescriptorType::eSampledImage;
     TexturesPoolSize.descriptorCount = 14 + DirectionalLights;
 
-    vk::DescriptorPoolSize PoolSizeArr[] = {UboPoolSize, SamplerPoolSize, TexturesPoolSize};
+    vk::DescriptorPoolSize StoragePoolSize{};
+    StoragePoolSize.type = vk::DescriptorType::eStorageBuffer;
+    StoragePoolSize.descriptorCount = 6;
+
+    vk::DescriptorPoolSize DynamicStoragePoolSize{};
+    DynamicStoragePoolSize.type = vk::DescriptorType::eStorageBufferDynamic;
+    DynamicStoragePoolSize.descriptorCount = 4;
+
+    vk::DescriptorPoolSize StorageImagePoolSize{};
+    StorageImagePoolSize.type = vk::DescriptorType::eStorageImage;
+    StorageImagePoolSize.descriptorCount = 4;
+
+    vk::DescriptorPoolSize PoolSizeArr[] = {UboPoolSize, SamplerPoolSize, TexturesPoolSize, StoragePoolSize, DynamicStoragePoolSize,
+                                            StorageImagePoolSize};
 
     vk::DescriptorPoolCreateInfo poolInfo{};
     poolInfo.maxSets = 4;
-    poolInfo.poolSizeCount = 3;
+    poolInfo.poolSizeCount = 6;
     poolInfo.pPoolSizes = PoolSizeArr;
     poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
 
@@ -218,10 +249,11 @@ void DescriptorSets::CreateDescriptorPool(uint32_t DirectionalLights) {
 
 void DescriptorSets::CreateGlobalDescriptorSet(
     const vk::DescriptorSetLayout &GlobalLayout, const vk::Sampler &Sampler,
-    const std::pair<BufferInfo, uint32_t> &PointLights, const std::pair<BufferInfo, uint32_t> &DirectionalLights,
+    const BufferInfo &UniformRing, const BufferInfo &PointLights, uint32_t DirectionalLights,
+    const std::pair<BufferInfo, uint32_t> &Draws,
     const std::vector<ImageResource> &ImageResources,
     const std::vector<vk::ImageView> &SwapchainImageViews,
-    const vk::Sampler &ShadowSampler
+    const vk::Sampler &ShadowSampler, const vk::Sampler &ShadowDepthSampler, const BufferInfo &ClusterLights
 ) {
 
     // global descriptor set
@@ -234,6 +266,8 @@ void DescriptorSets::CreateGlobalDescriptorSet(
 
     auto dev = *m_Device;
     m_GlobalDescriptorSets = dev.allocateDescriptorSets(GlobalAllocInfo);
+    m_PointLights = PointLights;
+    m_bPointLightsStale.assign(m_GlobalDescriptorSets.size(), false);
 
     vk::DescriptorImageInfo SamplerInfo{};
     SamplerInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
@@ -241,20 +275,35 @@ void DescriptorSets::CreateGlobalDescriptorSet(
     SamplerInfo.sampler = Sampler;
 
     vk::DescriptorBufferInfo LightBufferInfo{};
-    LightBufferInfo.buffer = PointLights.first.m_Buffer;
+    LightBufferInfo.buffer = PointLights.m_Buffer;
     LightBufferInfo.offset = 0;
-    LightBufferInfo.range = sizeof(PointLight) * PointLights.second;
+    LightBufferInfo.range = VK_WHOLE_SIZE;
 
     vk::DescriptorBufferInfo DirectionalLightBufferInfo{};
-    DirectionalLightBufferInfo.buffer = DirectionalLights.first.m_Buffer;
+    DirectionalLightBufferInfo.buffer = UniformRing.m_Buffer;
     DirectionalLightBufferInfo.offset = 0;
-    DirectionalLightBufferInfo.range = sizeof(DirectionalLight) * DirectionalLights.second;
+    DirectionalLightBufferInfo.range = sizeof(DirectionalLight) * DirectionalLights;
+
+    vk::DescriptorBufferInfo DrawBufferInfo{};
+    DrawBufferInfo.buffer = Draws.first.m_Buffer;
+    DrawBufferInfo.offset = 0;
+    DrawBufferInfo.range = sizeof(DrawData) * Draws.second;
+
+    vk::DescriptorBufferInfo ClusterBufferInfo{};
+    ClusterBufferInfo.buffer = ClusterLights.m_Buffer;
+    ClusterBufferInfo.offset = 0;
+    ClusterBufferInfo.range = VK_WHOLE_SIZE;
 
     vk::DescriptorImageInfo ShadowSamplerInfo{};
     ShadowSamplerInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
     ShadowSamplerInfo.imageView = VK_NULL_HANDLE;
     ShadowSamplerInfo.sampler = ShadowSampler;
 
+    vk::DescriptorImageInfo ShadowDepthSamplerInfo{};
+    ShadowDepthSamplerInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    ShadowDepthSamplerInfo.imageView = VK_NULL_HANDLE;
+    ShadowDepthSamplerInfo.sampler = ShadowDepthSampler;
+
     for (auto &ds: m_GlobalDescriptorSets) {
         std::vector<vk::WriteDescriptorSet> descriptorWrites{};
         descriptorWrites.emplace_back();
@@ -295,7 +344,7 @@ void DescriptorSets::CreateGlobalDescriptorSet(
         descriptorWrites[3].dstSet = ds;
         descriptorWrites[3].dstBinding = 3;
         descriptorWrites[3].dstArrayElement = 0;
-        descriptorWrites[3].descriptorType = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[3].descriptorType = vk::DescriptorType::eStorageBufferDynamic;
         descriptorWrites[3].descriptorCount = 1;
         descriptorWrites[3].pBufferInfo = &DirectionalLightBufferInfo;
 
@@ -307,6 +356,59 @@ void DescriptorSets::CreateGlobalDescriptorSet(
         descriptorWrites[4].descriptorCount = 1;
         descriptorWrites[4].pImageInfo = &ShadowSamplerInfo;
 
+        descriptorWrites.emplace_back();
+        descriptorWrites[5].dstSet = ds;
+        descriptorWrites[5].dstBinding = 5;
+        descriptorWrites[5].dstArrayElement = 0;
+        descriptorWrites[5].descriptorType = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[5].descriptorCount = 1;
+        descriptorWrites[5].pBufferInfo = &DrawBufferInfo;
+
+        descriptorWrites.emplace_back();
+        descriptorWrites[6].dstSet = ds;
+        descriptorWrites[6].dstBinding = 6;
+        descriptorWrites[6].dstArrayElement = 0;
+        descriptorWrites[6].descriptorType = vk::DescriptorType::eStorageBuffer;
+        descriptorWrites[6].descriptorCount = 1;
+        descriptorWrites[6].pBufferInfo = &ClusterBufferInfo;
+
+        descriptorWrites.emplace_back();
+        descriptorWrites[7].dstSet = ds;
+        descriptorWrites[7].dstBinding = 7;
+        descriptorWrites[7].dstArrayElement = 0;
+        descriptorWrites[7].descriptorType = vk::DescriptorType::eSampler;
+        descriptorWrites[7].descriptorCount = 1;
+        descriptorWrites[7].pImageInfo = &ShadowDepthSamplerInfo;
+
         m_Device.updateDescriptorSets(descriptorWrites, nullptr);
     }
 }
+
+void DescriptorSets::WritePointLights(uint32_t CurrentFrame, const BufferInfo &PointLights) {
+    m_PointLights = PointLights;
+    m_bPointLightsStale.assign(m_GlobalDescriptorSets.size(), true);
+
+    RefreshPointLights(CurrentFrame);
+}
+
+void DescriptorSets::RefreshPointLights(uint32_t CurrentFrame) {
+    if (CurrentFrame >= m_bPointLightsStale.size() || !m_bPointLightsStale[CurrentFrame]) {
+        return;
+    }
+    m_bPointLightsStale[CurrentFrame] = false;
+
+    vk::DescriptorBufferInfo LightBufferInfo{};
+    LightBufferInfo.buffer = m_PointLights.m_Buffer;
+    LightBufferInfo.offset = 0;
+    LightBufferInfo.range = VK_WHOLE_SIZE;
+
+    vk::WriteDescriptorSet write{};
+    write.dstSet = m_GlobalDescriptorSets[CurrentFrame];
+    write.dstBinding = 2;
+    write.dstArrayElement = 0;
+    write.descriptorType = vk::DescriptorType::eStorageBuffer;
+    write.descriptorCount = 1;
+    write.pBufferInfo = &LightBufferInfo;
+
+    m_Device.updateDescriptorSets(write, nullptr);
+}
@@ -27,33 +27,62 @@ class DescriptorSets {
     void CreateDescriptorPool(uint32_t DirectionalLights);
 
     void CreateFrameDescriptorSet(const ::vk::DescriptorSetLayout &FrameLayout,
-                                  const std::tuple<vk::ImageView, vk::ImageView, vk::ImageView> & ColorImageViews, const vk::ImageView &DepthImageView,
-                                  const BufferInfo &UniformBufferInfo, const BufferInfo &ShadowBufferInfo, const std::vector<vk::ImageView> &
-                                  ShadowImageViews, const vk::ImageView &CubemapImage, const vk::ImageView &IrradianceImage);
+                                  const std::pair<vk::ImageView, vk::ImageView> & ColorImageViews, const vk::ImageView &DepthImageView,
+                                  const BufferInfo &UniformRing, uint32_t ShadowViews, const std::vector<vk::ImageView> &
+                                  ShadowImageViews, const vk::ImageView &CubemapImage, const vk::ImageView &IrradianceImage,
+                                  const vk::ImageView &ShadowMaskImage, const vk::ImageView &HDRImage);
 
     void CreateGlobalDescriptorSet(
         const vk::DescriptorSetLayout &GlobalLayout,
-        const vk::Sampler &Sampler, const std::pair<BufferInfo, uint32_t> &PointLights,
-        const std::pair<BufferInfo, uint32_t> &DirectionalLights,
+        const vk::Sampler &Sampler, const BufferInfo &UniformRing, const BufferInfo &PointLights,
+        uint32_t DirectionalLights,
+        const std::pair<BufferInfo, uint32_t> &Draws,
         const std::vector<ImageResource> &ImageResources,
-        const std::vector<vk::ImageView> &SwapchainImageViews, const vk::Sampler &ShadowSampler);
+        const std::vector<vk::ImageView> &SwapchainImageViews, const vk::Sampler &ShadowSampler,
+        const vk::Sampler &ShadowDepthSampler, const BufferInfo &ClusterLights);
+
+    // The light buffer grew. Only the frame's global set is rewritten, its fence has to be waited on already. The
+    // other frames may still be in flight, their sets follow in RefreshPointLights once their fence came around.
+    // Relies on the passes binding GetDescriptorSets of the frame they record, never a pair kept from another frame
+    void WritePointLights(uint32_t CurrentFrame, const BufferInfo &PointLights);
+
+    // Points the frame's global set at the current light buffer if it still binds a replaced one
+    void RefreshPointLights(uint32_t CurrentFrame);
 
     // 0 descriptor pool, 1 descriptor set
     std::pair<vk::DescriptorPool, vk::DescriptorSet> GetFrameDescriptorSet(uint32_t CurrentFrame) const { return {m_DescriptorPool,m_FrameDescriptorSets[CurrentFrame]}; };
     std::pair<vk::DescriptorPool, vk::DescriptorSet> GetGlobalDescriptorSet(uint32_t CurrentFrame) const { return {m_DescriptorPool,m_GlobalDescriptorSets[CurrentFrame]}; };
 
-    // 0 frame 1 global
+    // 0 frame 1 global, bound at record time so each frame in flight keeps its own pair
     std::vector<vk::DescriptorSet> GetDescriptorSets(uint32_t CurrentFrame) const { return { m_FrameDescriptorSets[CurrentFrame], m_GlobalDescriptorSets[CurrentFrame] }; };
 
     vk::DescriptorPool GetPool() const {return m_DescriptorPool; };
+
+    // Offsets into the uniform ring, in the order the dynamic bindings appear in the frame and global sets
+    enum DynamicOffsetSlot : uint32_t {
+        MVPOffset = 0,
+        ShadowViewOffset,
+        DirectionalLightOffset,
+        DynamicOffsetCount
+    };
+
+    // Passes bind with whatever is set here at record time
+    void SetDynamicOffset(DynamicOffsetSlot Slot, uint32_t Offset) { m_DynamicOffsets[Slot] = Offset; };
+    const std::vector<uint32_t>& GetDynamicOffsets() const { return m_DynamicOffsets; };
 private:
 
     const vk::raii::Device& m_Device;
     std::vector<vk::DescriptorSet> m_FrameDescriptorSets{};
     std::vector<vk::DescriptorSet> m_GlobalDescriptorSets{};
 
+    // Light buffer every global set should bind, and which sets still bind the one it replaced
+    BufferInfo m_PointLights{};
+    std::vector<bool> m_bPointLightsStale{};
+
 	vk::DescriptorPool m_DescriptorPool{};
 
+    std::vector<uint32_t> m_DynamicOffsets = std::vector<uint32_t>(DynamicOffsetCount, 0);
+
 };
 
 
@@ -6,67 +6,35 @@
 
 #include "Buffer.h"
 #define STB_IMAGE_IMPLEMENTATION
+#include <algorithm>
+#include <bit>
 #include <filesystem>
 #include <iostream>
 
 #include "stb_image.h"
+#include "TextureCache.h"
+#include "UploadBatcher.h"
 
-ImageResource ImageFactory::LoadTexture(Buffer* buff,
-    const std::string &filename,
-    const vk::raii::Device &device,
-    VmaAllocator allocator,
-    const vk::raii::CommandPool &commandPool,
-    const vk::raii::Queue &graphicsQueue,
-    vk::Format ColorFormat,
-    vk::ImageAspectFlagBits aspect,
-    ResourceTracker* AllocationTracker)
+static ImageResource CreateSampledImage(VmaAllocator allocator, uint32_t width, uint32_t height,
+                                        vk::Format format, vk::ImageAspectFlagBits aspect, uint32_t mipLevels = 1,
+                                        vk::ImageUsageFlags extraUsage = {})
 {
     ImageResource imgResource{};
     imgResource.imageAspectFlags = aspect;
-    imgResource.format = ColorFormat;
-
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(filename.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    std::filesystem::path absPath = std::filesystem::absolute(filename);
-
-    if (!pixels) {
-        throw std::runtime_error("Failed to load texture image: " + absPath.string());
-    }
-
-    if (texWidth == 0 || texHeight == 0) {
-        stbi_image_free(pixels);
-        throw std::runtime_error("Loaded texture has zero size: " + absPath.string());
-    }
-
-    imgResource.extent = vk::Extent2D(texWidth, texHeight);
-
-    vk::DeviceSize imageSize = texWidth * texHeight * 4;
-
-    // Create a staging buffer, mapped to CPU memory, for uploading texture data
-    BufferInfo StagingBuffer = buff->CreateMapped(
-        allocator,
-        imageSize,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        VMA_MEMORY_USAGE_CPU_ONLY,
-        0,
-        AllocationTracker,
-        filename + "StagingBuffer"
-    );
+    imgResource.format = format;
+    imgResource.extent = vk::Extent2D(width, height);
+    imgResource.imageLayout = vk::ImageLayout::eUndefined;
+    imgResource.mipLevels = mipLevels;
 
-    // Upload pixel data into staging buffer
-    Buffer::UploadData(StagingBuffer, pixels, static_cast<size_t>(imageSize));
-    stbi_image_free(pixels);
-
-    // === Create VkImage via VMA ===
     vk::ImageCreateInfo imageInfo{};
     imageInfo.imageType = vk::ImageType::e2D;
-    imageInfo.extent = vk::Extent3D{ static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1 };
-    imageInfo.mipLevels = 1;
+    imageInfo.extent = vk::Extent3D{ width, height, 1 };
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
-    imageInfo.format = ColorFormat;
+    imageInfo.format = format;
     imageInfo.tiling = vk::ImageTiling::eOptimal;
     imageInfo.initialLayout = vk::ImageLayout::eUndefined;
-    imageInfo.usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+    imageInfo.usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled | extraUsage;
     imageInfo.samples = vk::SampleCountFlagBits::e1;
     imageInfo.sharingMode = vk::SharingMode::eExclusive;
 
@@ -95,88 +63,89 @@ ImageResource ImageFactory::LoadTexture(Buffer* buff,
     imgResource.image = rawImage;
     imgResource.allocation = allocation;
 
-    // === Transition image layout and copy from staging buffer ===
-    vk::raii::CommandBuffer commandBuffer = std::move(device.allocateCommandBuffers(
-        vk::CommandBufferAllocateInfo{
-            *commandPool,
-            vk::CommandBufferLevel::ePrimary,
-            1
-        })->front());
+    return imgResource;
+}
 
-    commandBuffer.begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+ImageResource ImageFactory::LoadTexture(UploadBatcher &uploader,
+    const std::string &filename,
+    VmaAllocator allocator,
+    vk::Format ColorFormat,
+    vk::ImageAspectFlagBits aspect,
+    bool GenerateMips)
+{
+    const DecodedImage decoded = DecodeTexture(filename);
+    return UploadTexture(uploader, decoded, allocator, ColorFormat, aspect, GenerateMips);
+}
 
-    ShiftImageLayout(
-        *commandBuffer, imgResource,
-        vk::ImageLayout::eUndefined,
-        vk::AccessFlags(),
-        vk::AccessFlagBits::eTransferWrite,
-        vk::PipelineStageFlagBits::eTopOfPipe,
-        vk::PipelineStageFlagBits::eTransfer);
+DecodedImage ImageFactory::DecodeTexture(const std::string &filename)
+{
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load(filename.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    std::filesystem::path absPath = std::filesystem::absolute(filename);
 
-    ShiftImageLayout(
-        *commandBuffer, imgResource,
-        vk::ImageLayout::eTransferDstOptimal,
-        vk::AccessFlags(),
-        vk::AccessFlagBits::eTransferWrite,
-        vk::PipelineStageFlagBits::eTransfer,
-        vk::PipelineStageFlagBits::eTransfer);
+    if (!pixels) {
+        throw std::runtime_error("Failed to load texture image: " + absPath.string());
+    }
 
-    vk::BufferImageCopy copyRegion{};
-    copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-    copyRegion.imageSubresource.mipLevel = 0;
-    copyRegion.imageSubresource.baseArrayLayer = 0;
-    copyRegion.imageSubresource.layerCount = 1;
-    copyRegion.imageExtent = vk::Extent3D{ static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1 };
-    copyRegion.bufferOffset = 0;
-    copyRegion.bufferRowLength = 0;
-    copyRegion.bufferImageHeight = 0;
+    if (texWidth == 0 || texHeight == 0) {
+        stbi_image_free(pixels);
+        throw std::runtime_error("Loaded texture has zero size: " + absPath.string());
+    }
 
-    commandBuffer.copyBufferToImage(
-        StagingBuffer.m_Buffer,
-        imgResource.image,
-        vk::ImageLayout::eTransferDstOptimal,
-        copyRegion);
+    DecodedImage decoded{};
+    decoded.pixels = {pixels, stbi_image_free};
+    decoded.extent = vk::Extent2D(static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+    return decoded;
+}
 
-    ShiftImageLayout(
-        *commandBuffer, imgResource,
-        vk::ImageLayout::eShaderReadOnlyOptimal,
-        vk::AccessFlagBits::eTransferWrite,
-        vk::AccessFlagBits::eShaderRead,
-        vk::PipelineStageFlagBits::eTransfer,
-        vk::PipelineStageFlagBits::eFragmentShader);
+ImageResource ImageFactory::UploadTexture(UploadBatcher &uploader,
+    const DecodedImage &decoded,
+    VmaAllocator allocator,
+    vk::Format ColorFormat,
+    vk::ImageAspectFlagBits aspect,
+    bool GenerateMips)
+{
+    const uint32_t mipLevels = GenerateMips ? GetMipLevelCount(decoded.extent.width, decoded.extent.height) : 1;
+    // The chain is blitted down from mip 0
+    const vk::ImageUsageFlags blitUsage = mipLevels > 1 ? vk::ImageUsageFlagBits::eTransferSrc : vk::ImageUsageFlags{};
+    ImageResource imgResource = CreateSampledImage(allocator, decoded.extent.width, decoded.extent.height,
+                                                   ColorFormat, aspect, mipLevels, blitUsage);
 
-    commandBuffer.end();
+    // The batcher copies the pixels into its staging ring, the decoded data can go right away
+    vk::DeviceSize imageSize = static_cast<vk::DeviceSize>(decoded.extent.width) * decoded.extent.height * 4;
+    uploader.UploadImage(imgResource, decoded.pixels.get(), imageSize);
 
-    vk::SubmitInfo submitInfo{};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &*commandBuffer;
-    graphicsQueue.submit(submitInfo);
-    graphicsQueue.waitIdle();
+    return imgResource;
+}
 
-    Buffer::Destroy(allocator, StagingBuffer.m_Buffer, StagingBuffer.m_Allocation, AllocationTracker);
+ImageResource ImageFactory::LoadCookedTexture(UploadBatcher &uploader, const CookedTexture &texture,
+    VmaAllocator allocator,
+    bool AllMips)
+{
+    const uint32_t mipLevels = AllMips ? static_cast<uint32_t>(texture.levelOffsets.size()) : 1;
+    ImageResource imgResource = CreateSampledImage(allocator, texture.extent.width, texture.extent.height,
+                                                   texture.format, vk::ImageAspectFlagBits::eColor, mipLevels);
 
-    imgResource.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    // Straight from the mapping into the staging ring, the blocks need no decoding
+    uploader.UploadImage(imgResource, texture.data.data(), texture.data.size(),
+                         std::span(texture.levelOffsets).first(mipLevels));
 
     return imgResource;
 }
 
+uint32_t ImageFactory::GetMipLevelCount(uint32_t width, uint32_t height)
+{
+    // Down to 1x1, the shorter side stays at 1 once it got there
+    return static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+}
 
 
-
-ImageResource ImageFactory::LoadHDRTexture(Buffer* buff,
+ImageResource ImageFactory::LoadHDRTexture(UploadBatcher &uploader,
     const std::string &filename,
-    const vk::raii::Device &device,
     VmaAllocator allocator,
-    const vk::raii::CommandPool &commandPool,
-    const vk::raii::Queue &graphicsQueue,
     vk::Format ColorFormat,
-    vk::ImageAspectFlagBits aspect,
-    ResourceTracker* AllocationTracker)
+    vk::ImageAspectFlagBits aspect)
 {
-    ImageResource imgResource{};
-    imgResource.imageAspectFlags = aspect;
-    imgResource.format = ColorFormat;
-
     int texWidth, texHeight, texChannels;
     float* pixels = stbi_loadf(filename.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
     std::filesystem::path absPath = std::filesystem::absolute(filename);
@@ -190,125 +159,13 @@ ImageResource ImageFactory::LoadHDRTexture(Buffer* buff,
         throw std::runtime_error("Loaded texture has zero size: " + absPath.string());
     }
 
-    imgResource.extent = vk::Extent2D(texWidth, texHeight);
-
-    vk::DeviceSize imageSize = texWidth * texHeight * sizeof(float) * 4 ;
-
-    // Create a staging buffer, mapped to CPU memory, for uploading texture data
-    BufferInfo StagingBuffer = buff->CreateMapped(
-        allocator,
-        imageSize,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        VMA_MEMORY_USAGE_CPU_ONLY,
-        0,
-        AllocationTracker,
-        filename + "StagingBuffer"
-    );
+    ImageResource imgResource = CreateSampledImage(allocator, static_cast<uint32_t>(texWidth),
+                                                   static_cast<uint32_t>(texHeight), ColorFormat, aspect);
 
-    // Upload pixel data into staging buffer
-    Buffer::UploadData(StagingBuffer, pixels, static_cast<size_t>(imageSize));
+    vk::DeviceSize imageSize = static_cast<vk::DeviceSize>(texWidth) * texHeight * sizeof(float) * 4;
+    uploader.UploadImage(imgResource, pixels, imageSize);
     stbi_image_free(pixels);
 
-    // === Create VkImage via VMA ===
-    vk::ImageCreateInfo imageInfo{};
-    imageInfo.imageType = vk::ImageType::e2D;
-    imageInfo.extent = vk::Extent3D{ static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1 };
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = ColorFormat;
-    imageInfo.tiling = vk::ImageTiling::eOptimal;
-    imageInfo.initialLayout = vk::ImageLayout::eUndefined;
-    imageInfo.usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
-    imageInfo.samples = vk::SampleCountFlagBits::e1;
-    imageInfo.sharingMode = vk::SharingMode::eExclusive;
-
-    VkImageCreateInfo imgInfo = static_cast<VkImageCreateInfo>(imageInfo);
-
-    VmaAllocationCreateInfo allocCreateInfo{};
-    allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
-
-    VkImage rawImage = VK_NULL_HANDLE;
-    VmaAllocation allocation = VK_NULL_HANDLE;
-    VmaAllocationInfo allocationInfo{};
-
-    VkResult result = vmaCreateImage(
-        allocator,
-        &imgInfo,
-        &allocCreateInfo,
-        &rawImage,
-        &allocation,
-        &allocationInfo
-    );
-
-    if (result != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create image with VMA.");
-    }
-
-    imgResource.image = rawImage;
-    imgResource.allocation = allocation;
-
-    // === Transition image layout and copy from staging buffer ===
-    vk::raii::CommandBuffer commandBuffer = std::move(device.allocateCommandBuffers(
-        vk::CommandBufferAllocateInfo{
-            *commandPool,
-            vk::CommandBufferLevel::ePrimary,
-            1
-        })->front());
-
-    commandBuffer.begin({ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
-
-    ShiftImageLayout(
-        *commandBuffer, imgResource,
-        vk::ImageLayout::eUndefined,
-        vk::AccessFlags(),
-        vk::AccessFlagBits::eTransferWrite,
-        vk::PipelineStageFlagBits::eTopOfPipe,
-        vk::PipelineStageFlagBits::eTransfer);
-
-    ShiftImageLayout(
-        *commandBuffer, imgResource,
-        vk::ImageLayout::eTransferDstOptimal,
-        vk::AccessFlags(),
-        vk::AccessFlagBits::eTransferWrite,
-        vk::PipelineStageFlagBits::eTransfer,
-        vk::PipelineStageFlagBits::eTransfer);
-
-    vk::BufferImageCopy copyRegion{};
-    copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-    copyRegion.imageSubresource.mipLevel = 0;
-    copyRegion.imageSubresource.baseArrayLayer = 0;
-    copyRegion.imageSubresource.layerCount = 1;
-    copyRegion.imageExtent = vk::Extent3D{ static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 1 };
-    copyRegion.bufferOffset = 0;
-    copyRegion.bufferRowLength = 0;
-    copyRegion.bufferImageHeight = 0;
-
-    commandBuffer.copyBufferToImage(
-        StagingBuffer.m_Buffer,
-        imgResource.image,
-        vk::ImageLayout::eTransferDstOptimal,
-        copyRegion);
-
-    ShiftImageLayout(
-        *commandBuffer, imgResource,
-        vk::ImageLayout::eShaderReadOnlyOptimal,
-        vk::AccessFlagBits::eTransferWrite,
-        vk::AccessFlagBits::eShaderRead,
-        vk::PipelineStageFlagBits::eTransfer,
-        vk::PipelineStageFlagBits::eFragmentShader);
-
-    commandBuffer.end();
-
-    vk::SubmitInfo submitInfo{};
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &*commandBuffer;
-    graphicsQueue.submit(submitInfo);
-    graphicsQueue.waitIdle();
-
-    Buffer::Destroy(allocator, StagingBuffer.m_Buffer, StagingBuffer.m_Allocation, AllocationTracker);
-
-    imgResource.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-
     return imgResource;
 }
 
@@ -462,7 +319,9 @@ ImageResource ImageFactory::LoadTextureFromMemory(
 
 
 VkImageView ImageFactory::CreateImageView(const vk::raii::Device &device, vk::Image Image, vk::Format Format, vk::ImageAspectFlags Aspect, ::ResourceTracker *
-                                          ResourceTracker, const std::string &Name, uint32_t BaseArrLayer, vk::ImageViewType ViewType) {
+                                          ResourceTracker, const std::string &Name, uint32_t BaseArrLayer, vk::ImageViewType ViewType,
+                                          uint32_t BaseMipLevel, uint32_t MipLevelCount, uint32_t LayerCount,
+                                          vk::ComponentMapping Components) {
 
     VkImageViewCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -471,16 +330,13 @@ VkImageView ImageFactory::CreateImageView(const vk::raii::Device &device, vk::Im
     createInfo.format = static_cast<VkFormat>(Format);
 
 
-    createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components = static_cast<VkComponentMapping>(Components);
 
     createInfo.subresourceRange.aspectMask = static_cast<VkImageAspectFlags>(Aspect);
-    createInfo.subresourceRange.baseMipLevel = 0;
-    createInfo.subresourceRange.levelCount = 1;
+    createInfo.subresourceRange.baseMipLevel = BaseMipLevel;
+    createInfo.subresourceRange.levelCount = MipLevelCount;
     createInfo.subresourceRange.baseArrayLayer = BaseArrLayer;
-    createInfo.subresourceRange.layerCount = (ViewType == vk::ImageViewType::eCube) ? 6u : 1u;
+    createInfo.subresourceRange.layerCount = (ViewType == vk::ImageViewType::eCube) ? 6u : LayerCount;
 
     VkImageView imageView;
     VkResult result = vkCreateImageView(*device, &createInfo, NULL, &imageView);
@@ -541,7 +397,7 @@ void ImageFactory::ShiftImageLayout(
     vk::ImageSubresourceRange subresourceRange{};
     subresourceRange.aspectMask = aspectFlags;
     subresourceRange.baseMipLevel = 0;
-    subresourceRange.levelCount = 1;
+    subresourceRange.levelCount = image.mipLevels;
     subresourceRange.baseArrayLayer = 0;
     subresourceRange.layerCount = layerCount;
 
@@ -566,3 +422,63 @@ void ImageFactory::ShiftImageLayout(
         nullptr,
         barrier);
 }
+
+void ImageFactory::RecordMipChain(const vk::CommandBuffer& commandBuffer, ImageResource& image)
+{
+    vk::ImageMemoryBarrier barrier{};
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image.image;
+    barrier.subresourceRange.aspectMask = image.imageAspectFlags;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    int32_t mipWidth = static_cast<int32_t>(image.extent.width);
+    int32_t mipHeight = static_cast<int32_t>(image.extent.height);
+
+    for (uint32_t mip = 1; mip < image.mipLevels; ++mip)
+    {
+        // The level above was just written, by the copy or the previous blit
+        barrier.subresourceRange.baseMipLevel = mip - 1;
+        barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+                                      {}, nullptr, nullptr, barrier);
+
+        const int32_t nextWidth = std::max(mipWidth / 2, 1);
+        const int32_t nextHeight = std::max(mipHeight / 2, 1);
+
+        vk::ImageBlit blit{};
+        blit.srcSubresource = vk::ImageSubresourceLayers{image.imageAspectFlags, mip - 1, 0, 1};
+        blit.srcOffsets[1] = vk::Offset3D{mipWidth, mipHeight, 1};
+        blit.dstSubresource = vk::ImageSubresourceLayers{image.imageAspectFlags, mip, 0, 1};
+        blit.dstOffsets[1] = vk::Offset3D{nextWidth, nextHeight, 1};
+        commandBuffer.blitImage(image.image, vk::ImageLayout::eTransferSrcOptimal,
+                                image.image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+
+        // Done reading it, the level goes straight to the shaders
+        barrier.oldLayout = vk::ImageLayout::eTransferSrcOptimal;
+        barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+                                      {}, nullptr, nullptr, barrier);
+
+        mipWidth = nextWidth;
+        mipHeight = nextHeight;
+    }
+
+    // The last level was only ever written
+    barrier.subresourceRange.baseMipLevel = image.mipLevels - 1;
+    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+    barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+                                  {}, nullptr, nullptr, barrier);
+
+    image.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+}
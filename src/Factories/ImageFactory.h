@@ -5,6 +5,8 @@
 #ifndef IMAGEFACTORY_H
 #define IMAGEFACTORY_H
 
+#include <memory>
+
 #include "Buffer.h"
 #include "ResourceTracker.h"
 #include <vk_mem_alloc.h>
@@ -17,7 +19,13 @@ struct ImageResource {
     vk::ImageAspectFlags imageAspectFlags{};
     vk::ImageLayout imageLayout{};
     VmaAllocation allocation{};
+    uint32_t mipLevels{ 1 };
+};
 
+// Tightly packed RGBA8 texels of a decoded image file
+struct DecodedImage {
+    std::unique_ptr<unsigned char, void (*)(void *)> pixels{ nullptr, nullptr };
+    vk::Extent2D extent{};
 };
 
 class ImageFactory {
@@ -30,18 +38,28 @@ public:
     ImageFactory& operator=(const ImageFactory&) = delete;
     ImageFactory& operator=(ImageFactory&&) noexcept = delete;
 
-    static ImageResource LoadTexture(
-        Buffer *buff,
-        const std::string &filename,
-        const vk::raii::Device &device,
-        VmaAllocator allocator,
-        const vk::raii::CommandPool &commandPool, const vk::raii::Queue &graphicsQueue, vk::Format ColorFormat, vk::
-        ImageAspectFlagBits aspect, ResourceTracker *AllocationTracker);
+    // Decode on the CPU and record the upload into the batcher, the image is ready once the batch is signaled.
+    // With GenerateMips the rest of the chain is blitted down from mip 0 in the same batch
+    static ImageResource LoadTexture(class UploadBatcher &uploader, const std::string &filename, VmaAllocator allocator,
+                                     vk::Format ColorFormat, vk::ImageAspectFlagBits aspect, bool GenerateMips = false);
+
+    // The CPU half of LoadTexture, touches no Vulkan state so any thread can decode
+    static DecodedImage DecodeTexture(const std::string &filename);
 
-    static ImageResource LoadHDRTexture(Buffer *buff, const std::string &filename, const vk::raii::Device &device,
-                                 VmaAllocator allocator, const vk::raii::CommandPool &commandPool,
-                                 const vk::raii::Queue &graphicsQueue, vk::Format ColorFormat,
-                                 vk::ImageAspectFlagBits aspect, ResourceTracker *AllocationTracker);
+    // The GPU half of LoadTexture, has to run on the thread that records into the batcher
+    static ImageResource UploadTexture(class UploadBatcher &uploader, const DecodedImage &decoded,
+                                       VmaAllocator allocator, vk::Format ColorFormat, vk::ImageAspectFlagBits aspect,
+                                       bool GenerateMips = false);
+
+    // Uploads the prebuilt chain of a cooked texture as is, or only its mip 0 without AllMips
+    static ImageResource LoadCookedTexture(class UploadBatcher &uploader, const struct CookedTexture &texture,
+                                           VmaAllocator allocator, bool AllMips = true);
+
+    static uint32_t GetMipLevelCount(uint32_t width, uint32_t height);
+
+    static ImageResource LoadHDRTexture(class UploadBatcher &uploader, const std::string &filename,
+                                        VmaAllocator allocator, vk::Format ColorFormat,
+                                        vk::ImageAspectFlagBits aspect);
 
     ImageResource LoadTextureFromMemory(Buffer *buff, const unsigned char *data,
                                         size_t dataSize, const vk::raii::Device &device,
@@ -51,7 +69,9 @@ public:
 
 
     static VkImageView CreateImageView(const vk::raii::Device &device, vk::Image Image, vk::Format Format, vk::ImageAspectFlags Aspect, ::ResourceTracker *
-                                       ResourceTracker, const std::string &Name, uint32_t BaseArrLayer = 0, vk::ImageViewType ViewType = vk::ImageViewType::e2D);
+                                       ResourceTracker, const std::string &Name, uint32_t BaseArrLayer = 0, vk::ImageViewType ViewType = vk::ImageViewType::e2D,
+                                       uint32_t BaseMipLevel = 0, uint32_t MipLevelCount = 1, uint32_t LayerCount = 1,
+                                       vk::ComponentMapping Components = {});
 
     static void CreateImage(const vk::raii::Device &device, VmaAllocator Allocator, ImageResource &Image, vk::ImageCreateInfo imageInfo, const std
                             ::string &name);
@@ -62,6 +82,11 @@ public:
         vk::AccessFlags srcAccessMask, vk::AccessFlags dstAccessMask,
         vk::PipelineStageFlags srcStage, vk::PipelineStageFlags dstStage, uint32_t layerCount = 1
     );
+
+    // Every mip has to be in TransferDstOptimal with mip 0 written. Each level is filtered from the one above it,
+    // sRGB formats are decoded before the filter and encoded after it, so the chain stays gamma correct.
+    // Leaves the whole chain in ShaderReadOnlyOptimal
+    static void RecordMipChain(const vk::CommandBuffer &commandBuffer, ImageResource &image);
 };
 
 
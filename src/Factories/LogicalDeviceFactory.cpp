@@ -77,10 +77,17 @@ vk::raii::Device LogicalDeviceFactory::Build_Device(const vk::raii::PhysicalDevi
 
     vk::PhysicalDeviceVulkan12Features Vulkan12Features = {};
     Vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    Vulkan12Features.timelineSemaphore = VK_TRUE;
+    Vulkan12Features.drawIndirectCount = VK_TRUE;
+    Vulkan12Features.samplerFilterMinmax = VK_TRUE;
     Vulkan12Features.pNext = &Vulkan13Features;
 
     vk::PhysicalDeviceFeatures2 Features{};
     Features.features.samplerAnisotropy = VK_TRUE;
+    Features.features.multiDrawIndirect = VK_TRUE;
+    Features.features.drawIndirectFirstInstance = VK_TRUE;
+    // Cooked textures are only used when it is there, see MeshFactory::EnableCookedTextures
+    Features.features.textureCompressionBC = PhysicalDevice.getFeatures().textureCompressionBC;
     Features.pNext = &Vulkan12Features;
 
 
@@ -1,42 +1,91 @@
 #include "MeshFactory.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <iostream>
 #include <unordered_map>
 #include <assimp/scene.h>
+#include <assimp/GltfMaterial.h>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include "glm/ext/matrix_transform.hpp"
 #include "Buffer.h"
+#include "GeometryPool.h"
 #include "ImageFactory.h"
 #include "ResourceTracker.h"
+#include "TextureCache.h"
+#include "Math/math.h"
 #include "Structs/UBOStructs.h"
+#include "UploadBatcher.h"
+
+static constexpr uint32_t ImportFlags =
+        aiProcess_Triangulate |
+        aiProcess_FlipUVs |
+        aiProcess_GenSmoothNormals |
+        aiProcess_CalcTangentSpace;
 
 std::vector<Mesh> MeshFactory::LoadModelFromGLTF(
     const std::string& path,
     VmaAllocator& allocator,
     std::deque<std::function<void(VmaAllocator)>>& deletionQueue,
-    const vk::CommandBuffer& commandBuffer,
-    const vk::raii::Queue& graphicsQueue,
+    UploadBatcher& uploader,
+    GeometryPool& geometryPool,
     vk::raii::Device& device,
-    const vk::raii::CommandPool& cmdPool,
     std::vector<ImageResource>& textures,
     std::vector<vk::ImageView>& textureImageViews,
     ResourceTracker* allocTracker
 ) {
+    const ModelData model = LoadModelData(path);
+
+    return UploadModel(model, std::filesystem::path(path).parent_path(), allocator, deletionQueue, uploader,
+                       geometryPool, device, textures, textureImageViews, allocTracker);
+}
+
+ModelData MeshFactory::LoadModelData(const std::string& path, bool forceImport) {
+    const auto start = std::chrono::steady_clock::now();
+
+    if (!forceImport) {
+        if (std::optional<ModelData> cached = MeshCache::Load(path, ImportFlags)) {
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "Loaded " << path << " from mesh cache in " << elapsed.count() << " ms" << std::endl;
+            return std::move(*cached);
+        }
+    }
+
+    ModelData model = ImportModel(path);
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Imported " << path << " with Assimp in " << elapsed.count() << " ms" << std::endl;
+
+    if (!WriteModelCache(path, model)) {
+        std::cerr << "Failed to write mesh cache for " << path << std::endl;
+    }
+
+    return model;
+}
+
+bool MeshFactory::WriteModelCache(const std::string& path, const ModelData& model) {
+    return MeshCache::Write(path, ImportFlags, model);
+}
+
+ModelData MeshFactory::ImportModel(const std::string& path) {
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path,
-        aiProcess_Triangulate |
-        aiProcess_FlipUVs |
-        aiProcess_GenSmoothNormals |
-        aiProcess_CalcTangentSpace);
+    const aiScene* scene = importer.ReadFile(path, ImportFlags);
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         throw std::runtime_error("Failed to load model: " + std::filesystem::absolute(path).string());
     }
 
-    std::filesystem::path baseDir = std::filesystem::path(path).parent_path();
-    std::unordered_map<std::string, uint32_t> textureCache;
-    std::vector<Mesh> meshes;
+    ModelData model{};
+    std::unordered_map<std::string, int> textureTable;
+    std::vector<Vertex> vertices;
+
+    // Every PackedVertex member goes to the end of its own stream
+    auto appendStream = [&model](VertexStream stream, const auto& member) {
+        const auto* bytes = reinterpret_cast<const std::byte*>(&member);
+        model.ownedVertexStreams[stream].insert(model.ownedVertexStreams[stream].end(), bytes, bytes + sizeof(member));
+    };
 
     std::function<void(aiNode*, const aiScene*)> processNode;
     processNode = [&](aiNode* node, const aiScene* currentScene) {
@@ -44,13 +93,14 @@ std::vector<Mesh> MeshFactory::LoadModelFromGLTF(
             aiMesh* ai_mesh = currentScene->mMeshes[node->mMeshes[i]];
             aiMaterial* materialPtr = currentScene->mMaterials[ai_mesh->mMaterialIndex];
 
-            // Process vertices
-            std::vector<Vertex> vertices;
-            vertices.reserve(ai_mesh->mNumVertices);
-            std::vector<glm::vec3> worldPos;
-            worldPos.reserve(ai_mesh->mNumVertices);
+            MeshRecord record{};
+            record.firstVertex = model.vertexCount;
+            record.vertexCount = ai_mesh->mNumVertices;
+            record.firstIndex = static_cast<uint32_t>(model.ownedIndices.size());
 
+            // Process vertices, they stay at full precision until the bounds they get quantized in are known
             aiMatrix4x4 transform = currentScene->mRootNode->mTransformation;
+            vertices.clear();
 
             for (unsigned int v = 0; v < ai_mesh->mNumVertices; ++v) {
                 Vertex vert{};
@@ -76,49 +126,59 @@ std::vector<Mesh> MeshFactory::LoadModelFromGLTF(
                 }
 
                 vertices.push_back(vert);
-                worldPos.push_back(vert.pos);
             }
 
+            record.bounds = VulkanMath::ComputeMeshBounds(vertices);
+            for (const Vertex& vert : vertices) {
+                const PackedVertex packed = VulkanMath::PackVertex(vert, record.bounds);
+                appendStream(PositionStream, packed.position);
+                appendStream(TexCoordStream, packed.texCoord);
+                appendStream(TangentFrameStream, packed.tangentFrame);
+            }
+            model.vertexCount += record.vertexCount;
+
             // Process indices
-            std::vector<uint32_t> indices;
             for (unsigned int f = 0; f < ai_mesh->mNumFaces; ++f) {
                 const aiFace& face = ai_mesh->mFaces[f];
                 for (unsigned int j = 0; j < face.mNumIndices; ++j)
-                    indices.push_back(face.mIndices[j]);
+                    model.ownedIndices.push_back(face.mIndices[j]);
             }
+            record.indexCount = static_cast<uint32_t>(model.ownedIndices.size()) - record.firstIndex;
 
-            // Load material textures
-            Material material{};
-            auto loadTextureIndex = [&](aiMaterial* mat, aiTextureType type, vk::Format format = vk::Format::eR8G8B8A8Srgb) -> int {
+            // Material textures are stored as indices into the model texture table
+            auto loadTextureIndex = [&](aiMaterial* mat, aiTextureType type, vk::Format format, TextureUsage usage) -> int {
                 if (mat->GetTextureCount(type) > 0) {
                     aiString texPath;
                     if (mat->GetTexture(type, 0, &texPath) == AI_SUCCESS) {
-                        return LoadTextureGeneric(scene, texPath.C_Str(), baseDir, textureCache,
-                                                  textures, textureImageViews,
-                                                  allocator, deletionQueue, device, cmdPool, graphicsQueue, allocTracker, format);
+                        auto [it, inserted] = textureTable.try_emplace(texPath.C_Str(), static_cast<int>(model.textures.size()));
+                        if (inserted) {
+                            model.textures.push_back({texPath.C_Str(), format, usage});
+                        }
+                        return it->second;
                     }
                 }
                 return -1;
             };
 
-            material.diffuseIdx   = loadTextureIndex(materialPtr, aiTextureType_DIFFUSE,          vk::Format::eR8G8B8A8Srgb);
-            material.normalIdx    = loadTextureIndex(materialPtr, aiTextureType_NORMALS,          vk::Format::eR8G8B8A8Unorm);
+            Material& material = record.material;
+            material.diffuseIdx   = loadTextureIndex(materialPtr, aiTextureType_DIFFUSE,          vk::Format::eR8G8B8A8Srgb,  TextureUsage::Color);
+            material.normalIdx    = loadTextureIndex(materialPtr, aiTextureType_NORMALS,          vk::Format::eR8G8B8A8Unorm, TextureUsage::Normal);
 
-            material.metallicIdx  = loadTextureIndex(materialPtr, aiTextureType_METALNESS,        vk::Format::eR8G8B8A8Unorm);
-            material.roughnessIdx = loadTextureIndex(materialPtr, aiTextureType_DIFFUSE_ROUGHNESS,vk::Format::eR8G8B8A8Unorm);
-            material.aoIdx        = loadTextureIndex(materialPtr, aiTextureType_AMBIENT_OCCLUSION,vk::Format::eR8G8B8A8Unorm);
-
-            material.emissiveIdx  = loadTextureIndex(materialPtr, aiTextureType_EMISSIVE,         vk::Format::eR8G8B8A8Srgb);
+            material.metallicIdx  = loadTextureIndex(materialPtr, aiTextureType_METALNESS,        vk::Format::eR8G8B8A8Unorm, TextureUsage::MetallicRoughness);
+            material.roughnessIdx = loadTextureIndex(materialPtr, aiTextureType_DIFFUSE_ROUGHNESS,vk::Format::eR8G8B8A8Unorm, TextureUsage::MetallicRoughness);
+            material.aoIdx        = loadTextureIndex(materialPtr, aiTextureType_AMBIENT_OCCLUSION,vk::Format::eR8G8B8A8Unorm, TextureUsage::Occlusion);
 
+            material.emissiveIdx  = loadTextureIndex(materialPtr, aiTextureType_EMISSIVE,         vk::Format::eR8G8B8A8Srgb,  TextureUsage::Color);
 
+            // glTF says which materials are cutouts, other formats keep the alpha test whenever there is a diffuse map
+            aiString alphaMode;
+            if (materialPtr->Get(AI_MATKEY_GLTF_ALPHAMODE, alphaMode) == AI_SUCCESS) {
+                record.bAlphaTested = std::strcmp(alphaMode.C_Str(), "OPAQUE") != 0;
+            } else {
+                record.bAlphaTested = material.diffuseIdx >= 0;
+            }
 
-            // Build GPU buffers for mesh
-            Mesh meshObj = Build_Mesh(
-                allocator, deletionQueue, commandBuffer, graphicsQueue,
-                vertices, indices, allocTracker, "Mesh");
-            meshObj.m_Material = material;
-            meshObj.m_Positions = std::move(worldPos);
-            meshes.push_back(meshObj);
+            model.meshes.push_back(record);
         }
 
         for (unsigned int i = 0; i < node->mNumChildren; ++i)
@@ -126,108 +186,176 @@ std::vector<Mesh> MeshFactory::LoadModelFromGLTF(
     };
 
     processNode(scene->mRootNode, scene);
-    return meshes;
-}
 
+    for (uint32_t stream = 0; stream < VertexStreamCount; ++stream) {
+        model.vertexStreams[stream] = model.ownedVertexStreams[stream];
+    }
+    model.indices = model.ownedIndices;
+    return model;
+}
 
-Mesh MeshFactory::Build_Mesh(
-    VmaAllocator &allocator,
-    std::deque<std::function<void(VmaAllocator)>> &deletionQueue,
-    const vk::CommandBuffer &commandBuffer,
-    vk::Queue graphicsQueue,
-    const std::vector<Vertex>& vertices,
-    const std::vector<uint32_t> indices,
-    ResourceTracker* allocTracker,
-    const std::string& allocName
+std::vector<Mesh> MeshFactory::UploadModel(
+    const ModelData& model,
+    const std::filesystem::path& baseDir,
+    VmaAllocator& allocator,
+    std::deque<std::function<void(VmaAllocator)>>& deletionQueue,
+    UploadBatcher& uploader,
+    GeometryPool& geometryPool,
+    vk::raii::Device& device,
+    std::vector<ImageResource>& textures,
+    std::vector<vk::ImageView>& textureImageViews,
+    ResourceTracker* allocTracker
 ) {
-    Mesh mesh{};
-    mesh.m_IndexCount = static_cast<uint32_t>(indices.size());
-
-    // Vertex Buffer
-    BufferInfo vertexStaging = m_MeshBuffer->CreateMapped(allocator, vertices.size() * sizeof(Vertex),
-        vk::BufferUsageFlagBits::eTransferSrc,
-        VMA_MEMORY_USAGE_AUTO,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_STRATEGY_MIN_MEMORY_BIT,
-        allocTracker, "VertexStaging");
-    Buffer::UploadData(vertexStaging, vertices.data(), vertices.size() * sizeof(Vertex));
-
-    mesh.m_VertexBufferInfo = m_MeshBuffer->CreateMapped(allocator,
-        vertices.size() * sizeof(Vertex),
-        vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-        VMA_MEMORY_USAGE_AUTO, 0, allocTracker, allocName);
-
-    Buffer::Copy(vertexStaging.m_Buffer, vertexStaging.m_AllocInfo,
-        mesh.m_VertexBufferInfo.m_Buffer, mesh.m_VertexBufferInfo.m_AllocInfo,
-        graphicsQueue, commandBuffer);
-
-    Buffer::Destroy(allocator, vertexStaging.m_Buffer, vertexStaging.m_Allocation, allocTracker);
-
-    // Index Buffer
-    BufferInfo indexStaging = m_MeshBuffer->CreateMapped(allocator, indices.size() * sizeof(indices[0]),
-        vk::BufferUsageFlagBits::eTransferSrc,
-        VMA_MEMORY_USAGE_AUTO,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_STRATEGY_MIN_MEMORY_BIT,
-        allocTracker, "IndexStaging");
-    Buffer::UploadData(indexStaging, indices.data(), indices.size() * sizeof(indices[0]));
-
-    mesh.m_IndexBufferInfo = m_MeshBuffer->CreateMapped(allocator,
-        indices.size() * sizeof(indices[0]),
-        vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-        VMA_MEMORY_USAGE_AUTO, 0, allocTracker, "IndexBuffer");
-
-    Buffer::Copy(indexStaging.m_Buffer, indexStaging.m_AllocInfo,
-        mesh.m_IndexBufferInfo.m_Buffer, mesh.m_IndexBufferInfo.m_AllocInfo,
-        graphicsQueue, commandBuffer);
-
-    Buffer::Destroy(allocator, indexStaging.m_Buffer, indexStaging.m_Allocation, allocTracker);
-
-    // Schedule GPU buffer deletion
-    auto vb = mesh.m_VertexBufferInfo.m_Buffer;
-    auto va = mesh.m_VertexBufferInfo.m_Allocation;
-    auto ib = mesh.m_IndexBufferInfo.m_Buffer;
-    auto ia = mesh.m_IndexBufferInfo.m_Allocation;
-
-    deletionQueue.emplace_back([vb, va, ib, ia, allocTracker](VmaAllocator alloc) {
-        Buffer::Destroy(alloc, vb, va, allocTracker);
-        Buffer::Destroy(alloc, ib, ia, allocTracker);
-    });
+    std::unordered_map<std::string, uint32_t> textureCache;
+
+    const auto textureStart = std::chrono::steady_clock::now();
+    const size_t firstTexture = textures.size();
+
+    // Model texture table -> index into the global texture array.
+    // Reading and decoding runs on the job system, creating the images and recording their uploads stays on this
+    // thread. Going in batches of a few textures per thread bounds how many decoded images are held at once
+    std::vector<int> textureIndices;
+    textureIndices.reserve(model.textures.size());
+
+    const uint32_t textureCount = static_cast<uint32_t>(model.textures.size());
+    const uint32_t batchSize = m_JobSystem->GetThreadCount() * 2;
+    for (uint32_t batchStart = 0; batchStart < textureCount; batchStart += batchSize) {
+        const uint32_t batchCount = std::min(batchSize, textureCount - batchStart);
+
+        std::vector<DecodedTexture> decoded(batchCount);
+        m_JobSystem->ParallelFor(batchCount, [&](uint32_t i) {
+            // The cache is only written once the batch is decoded, so reading it here is safe
+            const std::string fullPath = (baseDir / model.textures[batchStart + i].path).string();
+            if (!textureCache.contains(fullPath)) {
+                decoded[i] = DecodeTexture(fullPath, model.textures[batchStart + i].usage);
+            }
+        });
+
+        for (uint32_t i = 0; i < batchCount; ++i) {
+            const TextureRef& texture = model.textures[batchStart + i];
+            textureIndices.push_back(LoadTextureGeneric((baseDir / texture.path).string(), decoded[i], textureCache,
+                                                        textures, textureImageViews, allocator, deletionQueue, device,
+                                                        uploader, allocTracker, texture.format, texture.usage));
+        }
+    }
+
+    // Device memory of the new images without allocator overhead, to compare cooked against decoded loads
+    uint32_t cookedCount = 0;
+    vk::DeviceSize textureBytes = 0;
+    for (size_t i = firstTexture; i < textures.size(); ++i) {
+        const ImageResource& image = textures[i];
+        const bool bCooked = image.format != vk::Format::eR8G8B8A8Srgb && image.format != vk::Format::eR8G8B8A8Unorm;
+        cookedCount += bCooked ? 1 : 0;
+
+        for (uint32_t level = 0; level < image.mipLevels; ++level) {
+            const vk::DeviceSize width = std::max(image.extent.width >> level, 1u);
+            const vk::DeviceSize height = std::max(image.extent.height >> level, 1u);
+            if (bCooked) {
+                const vk::DeviceSize blockBytes = image.format == vk::Format::eBc4UnormBlock ? 8 : 16;
+                textureBytes += ((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+            } else {
+                textureBytes += width * height * 4;
+            }
+        }
+    }
+
+    const std::chrono::duration<double, std::milli> textureTime = std::chrono::steady_clock::now() - textureStart;
+    std::cout << "Loaded " << textures.size() - firstTexture << " textures (" << cookedCount << " cooked) in "
+              << textureTime.count() << " ms on " << m_JobSystem->GetThreadCount() << " threads, "
+              << static_cast<double>(textureBytes) / (1024.0 * 1024.0) << " MiB" << std::endl;
+    if (m_bCookedTextures && cookedCount < textures.size() - firstTexture) {
+        std::cout << "Run with --cook-textures to block compress the rest" << std::endl;
+    }
 
-    return mesh;
+    auto remap = [&textureIndices](int idx) {
+        return idx < 0 ? -1 : textureIndices[idx];
+    };
+
+    // The whole model lives in one range of the shared pool, sub-meshes are addressed by offset
+    const GeometryAllocation geometry = geometryPool.Allocate(model.vertexCount,
+                                                              static_cast<uint32_t>(model.indices.size()));
+
+    for (uint32_t stream = 0; stream < VertexStreamCount; ++stream) {
+        uploader.UploadBuffer(geometryPool.GetVertexBuffer(static_cast<VertexStream>(stream)),
+                              model.vertexStreams[stream].data(), model.vertexStreams[stream].size_bytes(),
+                              static_cast<vk::DeviceSize>(geometry.firstVertex) * PackedVertex::StreamStrides[stream]);
+    }
+    uploader.UploadBuffer(geometryPool.GetIndexBuffer(), model.indices.data(), model.indices.size_bytes(),
+                          static_cast<vk::DeviceSize>(geometry.firstIndex) * sizeof(uint32_t));
+
+    std::vector<Mesh> meshes;
+    meshes.reserve(model.meshes.size());
+
+    for (const MeshRecord& record : model.meshes) {
+        Mesh meshObj{};
+        meshObj.m_VertexOffset = static_cast<int32_t>(geometry.firstVertex + record.firstVertex);
+        meshObj.m_FirstIndex = geometry.firstIndex + record.firstIndex;
+        meshObj.m_IndexCount = record.indexCount;
+
+        meshObj.m_Material.diffuseIdx   = remap(record.material.diffuseIdx);
+        meshObj.m_Material.normalIdx    = remap(record.material.normalIdx);
+        meshObj.m_Material.metallicIdx  = remap(record.material.metallicIdx);
+        meshObj.m_Material.roughnessIdx = remap(record.material.roughnessIdx);
+        meshObj.m_Material.aoIdx        = remap(record.material.aoIdx);
+        meshObj.m_Material.emissiveIdx  = remap(record.material.emissiveIdx);
+        meshObj.m_Bounds = record.bounds;
+        meshObj.m_bAlphaTested = record.bAlphaTested;
+
+        meshes.push_back(std::move(meshObj));
+    }
+
+    return meshes;
 }
 
 
+MeshFactory::DecodedTexture MeshFactory::DecodeTexture(const std::string& fullPath, TextureUsage usage) const {
+    DecodedTexture decoded{};
+
+    // An up to date cooked file replaces the source, its blocks go to the GPU without any decoding
+    if (m_bCookedTextures) {
+        decoded.cooked = TextureCache::Load(fullPath, usage);
+    }
+    if (!decoded.cooked) {
+        decoded.image = ImageFactory::DecodeTexture(fullPath);
+    }
+
+    return decoded;
+}
 
 int MeshFactory::LoadTextureGeneric(
-    const aiScene* ,
-    const std::string& texPathStr,
-    const std::filesystem::path& baseDir,
+    const std::string& fullPath,
+    const DecodedTexture& decoded,
     std::unordered_map<std::string, uint32_t>& textureCache,
     std::vector<ImageResource>& textures,
     std::vector<vk::ImageView>& textureImageViews,
     VmaAllocator& allocator,
     std::deque<std::function<void(VmaAllocator)>>& deletionQueue,
     vk::raii::Device& device,
-    const vk::raii::CommandPool& cmdPool,
-    const vk::raii::Queue& graphicsQueue,
+    UploadBatcher& uploader,
     ResourceTracker* allocTracker,
-    vk::Format format = vk::Format::eR8G8B8A8Srgb
+    vk::Format format,
+    TextureUsage usage
 ) {
-    std::string fullPath = (baseDir / texPathStr).string();
-
     if (textureCache.contains(fullPath)) {
         return textureCache[fullPath];
     }
 
-    auto texture = ImageFactory::LoadTexture(
-        m_MeshBuffer.get(), fullPath, device, allocator, cmdPool,
-        graphicsQueue, format, vk::ImageAspectFlagBits::eColor, allocTracker);
+    ImageResource texture{};
+    vk::ComponentMapping components{};
+    if (decoded.cooked) {
+        texture = ImageFactory::LoadCookedTexture(uploader, *decoded.cooked, allocator, m_bTextureMips);
+        components = TextureCache::GetComponentMapping(usage);
+    } else {
+        texture = ImageFactory::UploadTexture(
+            uploader, decoded.image, allocator, format, vk::ImageAspectFlagBits::eColor, m_bTextureMips);
+    }
 
     textures.emplace_back(texture);
 
     auto imageView = ImageFactory::CreateImageView(
-        device, texture.image, format,
+        device, texture.image, texture.format,
         vk::ImageAspectFlagBits::eColor, allocTracker,
-        "textureImageView: " + fullPath);
+        "textureImageView: " + fullPath, 0, vk::ImageViewType::e2D, 0, texture.mipLevels, 1, components);
 
     textureImageViews.emplace_back(imageView);
     int textureIdx = static_cast<int>(textures.size() - 1);
@@ -5,6 +5,7 @@
 #ifndef MESHFACTORY_H
 #define MESHFACTORY_H
 #include <deque>
+#include <span>
 
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
@@ -16,6 +17,12 @@
 #include "glm/glm.hpp"
 #include "vulkan/vulkan_raii.hpp"
 #include "Structs/Mesh.h"
+#include "JobSystem.h"
+#include "MeshCache.h"
+#include "TextureCache.h"
+
+class UploadBatcher;
+class GeometryPool;
 
 class MeshFactory {
 
@@ -28,30 +35,59 @@ public:
     MeshFactory& operator=(const MeshFactory&) = delete;
     MeshFactory& operator=(MeshFactory&&) noexcept = delete;
 
+    // Textures loaded afterwards get a full mip chain, on by default
+    void EnableTextureMips(bool bEnable) { m_bTextureMips = bEnable; }
+
+    // Textures loaded afterwards come from their block compressed KTX2 copy when it is up to date, on by default.
+    // The device has to support textureCompressionBC
+    void EnableCookedTextures(bool bEnable) { m_bCookedTextures = bEnable; }
 
     std::vector<Mesh> LoadModelFromGLTF(const std::string &path, VmaAllocator &Allocator,
                                         std::deque<std::function<void(VmaAllocator)>> &DeletionQueue,
-                                        const vk::CommandBuffer &CommandBuffer, const vk::raii::Queue &GraphicsQueue,
+                                        class UploadBatcher &Uploader, class GeometryPool &Pool,
                                         vk::raii::Device &device,
-                                        const vk::raii::CommandPool &CmdPool, std::vector<ImageResource> &textures, std::vector<vk::ImageView> &
+                                        std::vector<ImageResource> &textures, std::vector<vk::ImageView> &
                                         TextureImageViews, class ResourceTracker *AllocTracker);
 
-    Mesh Build_Mesh(VmaAllocator &Allocator, std::deque<std::function<void(VmaAllocator)>> &DeletionQueue,
-                    const vk::CommandBuffer &CommandBuffer, vk::Queue GraphicsQueue,
-                    const std::vector<Vertex> &vertices, std::vector<uint32_t> indices, ResourceTracker *AllocationTracker, const std::
-                    string &AllocName);
+    // Runs the full Assimp import, no cache involved
+    static ModelData ImportModel(const std::string &path);
+
+    // Stores an imported model in the mesh cache under the import flags this factory uses
+    static bool WriteModelCache(const std::string &path, const ModelData &model);
+
+    // Returns the cached model when it is up to date, otherwise imports it and refreshes the cache
+    static ModelData LoadModelData(const std::string &path, bool forceImport = false);
+
+    std::vector<Mesh> UploadModel(const ModelData &model, const std::filesystem::path &baseDir, VmaAllocator &Allocator,
+                                  std::deque<std::function<void(VmaAllocator)>> &DeletionQueue,
+                                  UploadBatcher &Uploader, GeometryPool &Pool, vk::raii::Device &device,
+                                  std::vector<ImageResource> &textures, std::vector<vk::ImageView> &TextureImageViews,
+                                  ResourceTracker *AllocTracker);
+
+    // One texture read on a worker: its cooked copy when there is an up to date one, otherwise the decoded source
+    struct DecodedTexture {
+        std::optional<CookedTexture> cooked{};
+        DecodedImage image{};
+    };
+
+    // Safe to run on the job system
+    DecodedTexture DecodeTexture(const std::string &fullPath, TextureUsage usage) const;
 
-    int LoadTextureGeneric(const aiScene *scene, const std::string &texPathStr, const std::filesystem::path &baseDir,
+    // Creates the image and its view and records the upload, on the thread that owns the batcher
+    int LoadTextureGeneric(const std::string &fullPath, const DecodedTexture &decoded,
                            std::unordered_map<std::string, uint32_t> &textureCache,
                            std::vector<ImageResource> &textures,
                            std::vector<vk::ImageView> &textureImageViews, VmaAllocator &allocator,
                            std::deque<std::function<void(VmaAllocator)>> &deletionQueue, vk::raii::Device &device,
-                           const vk::raii::CommandPool &cmdPool, const vk::raii::Queue &graphicsQueue,
-                           ResourceTracker *allocTracker, vk::Format format);
+                           UploadBatcher &uploader, ResourceTracker *allocTracker, vk::Format format,
+                           TextureUsage usage);
 
 private:
-    std::unique_ptr<Buffer> m_MeshBuffer = std::make_unique<Buffer>();
+    bool m_bTextureMips{ true };
+    bool m_bCookedTextures{ true };
 
+    // Sized to the hardware cores, decodes the textures of every model this factory uploads
+    std::unique_ptr<JobSystem> m_JobSystem{ std::make_unique<JobSystem>() };
 };
 
 
@@ -95,3 +95,11 @@ vk::raii::Pipeline PipelineFactory::Build() {
 
     return {m_Device, nullptr, pipelineInfo};
 }
+
+vk::raii::Pipeline PipelineFactory::BuildCompute(const vk::PipelineShaderStageCreateInfo& computeStage) const {
+    vk::ComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.setStage(computeStage);
+    pipelineInfo.setLayout(*m_PipelineLayout);
+
+    return {m_Device, nullptr, pipelineInfo};
+}
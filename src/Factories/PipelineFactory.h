@@ -23,6 +23,9 @@ public:
 
     vk::raii::Pipeline Build();
 
+    // Only the layout set through SetLayout is used, the graphics state is ignored
+    vk::raii::Pipeline BuildCompute(const vk::PipelineShaderStageCreateInfo& computeStage) const;
+
 private:
     const vk::raii::Device& m_Device;
 
@@ -59,4 +59,24 @@ std::vector<vk::raii::ShaderModule> ShaderFactory::Build_ShaderModules(const vk:
     modules.emplace_back(device, fragmentModuleInfo);
 
     return modules;
-}
\ No newline at end of file
+}
+
+vk::raii::ShaderModule ShaderFactory::Build_ComputeModule(const vk::raii::Device& device, const char* ComputeFile) {
+    auto computeCode = File::ReadSpirvFile(ComputeFile);
+    if (computeCode.empty()) throw std::runtime_error("Failed to read compute shader");
+
+    vk::ShaderModuleCreateInfo computeModuleInfo{};
+    computeModuleInfo.setCode(computeCode);
+
+    return {device, computeModuleInfo};
+}
+
+vk::raii::ShaderModule ShaderFactory::Build_VertexModule(const vk::raii::Device& device, const char* VertexFile) {
+    auto vertexCode = File::ReadSpirvFile(VertexFile);
+    if (vertexCode.empty()) throw std::runtime_error("Failed to read vertex shader");
+
+    vk::ShaderModuleCreateInfo vertexModuleInfo{};
+    vertexModuleInfo.setCode(vertexCode);
+
+    return {device, vertexModuleInfo};
+}
@@ -24,6 +24,11 @@ public:
 
     static std::vector<vk::raii::ShaderModule> Build_ShaderModules(const vk::raii::Device &device, const char *VertexFile,
                                                             const char *FragmentFile);
+
+    static vk::raii::ShaderModule Build_ComputeModule(const vk::raii::Device &device, const char *ComputeFile);
+
+    // Vertex stage alone, for depth only pipelines without a fragment shader
+    static vk::raii::ShaderModule Build_VertexModule(const vk::raii::Device &device, const char *VertexFile);
 };
 
 
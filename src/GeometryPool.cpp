@@ -0,0 +1,116 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "GeometryPool.h"
+
+#include <iostream>
+
+#include "ResourceTracker.h"
+
+GeometryPool::GeometryPool(VmaAllocator allocator, ResourceTracker *tracker, uint32_t vertexCapacity,
+                           uint32_t indexCapacity)
+    : m_Allocator(allocator)
+      , m_AllocationTracker(tracker)
+      , m_Buffer(std::make_unique<Buffer>()) {
+    constexpr std::array<const char *, VertexStreamCount> streamNames{
+        "GeometryPoolPositions", "GeometryPoolTexCoords", "GeometryPoolTangentFrames"
+    };
+    for (uint32_t stream = 0; stream < VertexStreamCount; ++stream) {
+        m_VertexBuffers[stream] = m_Buffer->CreateUnmapped(m_Allocator,
+                                                           static_cast<vk::DeviceSize>(vertexCapacity) *
+                                                           PackedVertex::StreamStrides[stream],
+                                                           vk::BufferUsageFlagBits::eVertexBuffer |
+                                                           vk::BufferUsageFlagBits::eTransferDst,
+                                                           VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, m_AllocationTracker,
+                                                           streamNames[stream]);
+    }
+
+    m_IndexBuffer = m_Buffer->CreateUnmapped(m_Allocator,
+                                             static_cast<vk::DeviceSize>(indexCapacity) * sizeof(uint32_t),
+                                             vk::BufferUsageFlagBits::eIndexBuffer |
+                                             vk::BufferUsageFlagBits::eTransferDst,
+                                             VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, m_AllocationTracker,
+                                             "GeometryPoolIndices");
+
+    VmaVirtualBlockCreateInfo blockInfo{};
+    blockInfo.size = vertexCapacity;
+    if (vmaCreateVirtualBlock(&blockInfo, &m_VertexBlock) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create geometry pool vertex block!");
+    }
+
+    blockInfo.size = indexCapacity;
+    if (vmaCreateVirtualBlock(&blockInfo, &m_IndexBlock) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create geometry pool index block!");
+    }
+}
+
+GeometryAllocation GeometryPool::Allocate(uint32_t vertexCount, uint32_t indexCount) {
+    GeometryAllocation allocation{};
+    VkDeviceSize offset{};
+
+    VmaVirtualAllocationCreateInfo allocInfo{};
+    allocInfo.size = vertexCount;
+    if (vmaVirtualAllocate(m_VertexBlock, &allocInfo, &allocation.vertexAllocation, &offset) != VK_SUCCESS) {
+        throw std::runtime_error("Geometry pool is out of vertex space!");
+    }
+    allocation.firstVertex = static_cast<uint32_t>(offset);
+
+    allocInfo.size = indexCount;
+    if (vmaVirtualAllocate(m_IndexBlock, &allocInfo, &allocation.indexAllocation, &offset) != VK_SUCCESS) {
+        vmaVirtualFree(m_VertexBlock, allocation.vertexAllocation);
+        throw std::runtime_error("Geometry pool is out of index space!");
+    }
+    allocation.firstIndex = static_cast<uint32_t>(offset);
+
+    return allocation;
+}
+
+void GeometryPool::Free(const GeometryAllocation &allocation) {
+    if (allocation.vertexAllocation) {
+        vmaVirtualFree(m_VertexBlock, allocation.vertexAllocation);
+    }
+    if (allocation.indexAllocation) {
+        vmaVirtualFree(m_IndexBlock, allocation.indexAllocation);
+    }
+}
+
+void GeometryPool::Bind(vk::CommandBuffer commandBuffer, uint32_t StreamCount) const {
+    std::array<vk::Buffer, VertexStreamCount> buffers{};
+    std::array<vk::DeviceSize, VertexStreamCount> offsets{};
+    for (uint32_t stream = 0; stream < StreamCount; ++stream) {
+        buffers[stream] = m_VertexBuffers[stream].m_Buffer;
+    }
+    commandBuffer.bindVertexBuffers(0, StreamCount, buffers.data(), offsets.data());
+    commandBuffer.bindIndexBuffer(m_IndexBuffer.m_Buffer, 0, vk::IndexType::eUint32);
+}
+
+void GeometryPool::Destroy() {
+    if (m_VertexBlock) {
+        VmaStatistics vertexStats{};
+        VmaStatistics indexStats{};
+        vmaGetVirtualBlockStatistics(m_VertexBlock, &vertexStats);
+        vmaGetVirtualBlockStatistics(m_IndexBlock, &indexStats);
+        std::cout << "Geometry pool: " << vertexStats.allocationBytes << " vertices, "
+                << indexStats.allocationBytes << " indices still allocated" << std::endl;
+
+        // Meshes don't free their ranges individually, the whole pool goes at once
+        vmaClearVirtualBlock(m_VertexBlock);
+        vmaClearVirtualBlock(m_IndexBlock);
+        vmaDestroyVirtualBlock(m_VertexBlock);
+        vmaDestroyVirtualBlock(m_IndexBlock);
+        m_VertexBlock = {};
+        m_IndexBlock = {};
+    }
+
+    for (BufferInfo &vertexBuffer: m_VertexBuffers) {
+        if (vertexBuffer.m_Buffer) {
+            Buffer::Destroy(m_Allocator, vertexBuffer.m_Buffer, vertexBuffer.m_Allocation, m_AllocationTracker);
+            vertexBuffer = {};
+        }
+    }
+    if (m_IndexBuffer.m_Buffer) {
+        Buffer::Destroy(m_Allocator, m_IndexBuffer.m_Buffer, m_IndexBuffer.m_Allocation, m_AllocationTracker);
+        m_IndexBuffer = {};
+    }
+}
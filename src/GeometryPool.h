@@ -0,0 +1,69 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef GEOMETRYPOOL_H
+#define GEOMETRYPOOL_H
+
+#include <array>
+#include <memory>
+
+#include <vulkan/vulkan.hpp>
+#include <vk_mem_alloc.h>
+
+#include "Buffer.h"
+#include "Structs/Mesh.h"
+
+class ResourceTracker;
+
+struct GeometryAllocation {
+    VmaVirtualAllocation vertexAllocation{};
+    VmaVirtualAllocation indexAllocation{};
+    uint32_t firstVertex{};
+    uint32_t firstIndex{};
+};
+
+// One device-local buffer per VertexStream and one index buffer shared by every mesh.
+// Ranges are handed out by VMA virtual blocks that count in elements (vertices / indices), not bytes,
+// so the returned offsets can go straight into drawIndexed as vertexOffset / firstIndex.
+class GeometryPool {
+public:
+    static constexpr uint32_t DefaultVertexCapacity = 1u << 20;
+    static constexpr uint32_t DefaultIndexCapacity = 1u << 22;
+
+    GeometryPool(VmaAllocator allocator, ResourceTracker *tracker, uint32_t vertexCapacity = DefaultVertexCapacity,
+                 uint32_t indexCapacity = DefaultIndexCapacity);
+    virtual ~GeometryPool() = default;
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool(GeometryPool&&) noexcept = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+    GeometryPool& operator=(GeometryPool&&) noexcept = delete;
+
+    // Throws when either block has no contiguous range left
+    GeometryAllocation Allocate(uint32_t vertexCount, uint32_t indexCount);
+    void Free(const GeometryAllocation &allocation);
+
+    // Binds the index buffer and the first StreamCount vertex streams, every draw afterwards only needs its offsets
+    void Bind(vk::CommandBuffer commandBuffer, uint32_t StreamCount = VertexStreamCount) const;
+
+    [[nodiscard]] vk::Buffer GetVertexBuffer(VertexStream Stream) const { return m_VertexBuffers[Stream].m_Buffer; }
+    [[nodiscard]] vk::Buffer GetIndexBuffer() const { return m_IndexBuffer.m_Buffer; }
+
+    // Frees the virtual blocks and both buffers, call before the allocator is destroyed
+    void Destroy();
+
+private:
+    VmaAllocator m_Allocator{};
+    ResourceTracker *m_AllocationTracker{};
+
+    std::unique_ptr<Buffer> m_Buffer{};
+    std::array<BufferInfo, VertexStreamCount> m_VertexBuffers{};
+    BufferInfo m_IndexBuffer{};
+
+    VmaVirtualBlock m_VertexBlock{};
+    VmaVirtualBlock m_IndexBlock{};
+};
+
+
+#endif //GEOMETRYPOOL_H
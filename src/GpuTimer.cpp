@@ -0,0 +1,70 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "GpuTimer.h"
+
+namespace {
+    constexpr uint32_t QueriesPerFrame = GpuTimer::ScopeCount * 2;
+}
+
+GpuTimer::GpuTimer(const vk::raii::Device &Device,
+                   const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer,
+                   const vk::PhysicalDeviceLimits &Limits, uint32_t FramesInFlight)
+    : m_CommandBuffer(CommandBuffer)
+    , m_TimestampPeriod(Limits.timestampPeriod)
+    , m_bSupported(Limits.timestampComputeAndGraphics)
+    , m_bPending(FramesInFlight, false) {
+    if (!m_bSupported) {
+        return;
+    }
+
+    vk::QueryPoolCreateInfo poolInfo{};
+    poolInfo.queryType = vk::QueryType::eTimestamp;
+    poolInfo.queryCount = QueriesPerFrame * FramesInFlight;
+
+    m_QueryPool = std::make_unique<vk::raii::QueryPool>(Device, poolInfo);
+}
+
+void GpuTimer::BeginFrame(uint32_t CurrentFrame) {
+    if (!m_bSupported) {
+        return;
+    }
+
+    const uint32_t firstQuery = CurrentFrame * QueriesPerFrame;
+
+    // The fence of this slot was waited on, every timestamp it wrote is available
+    if (m_bPending[CurrentFrame]) {
+        auto [result, timestamps] = m_QueryPool->getResults<uint64_t>(firstQuery, QueriesPerFrame,
+                                                                      QueriesPerFrame * sizeof(uint64_t),
+                                                                      sizeof(uint64_t),
+                                                                      vk::QueryResultFlagBits::e64);
+        if (result == vk::Result::eSuccess) {
+            for (uint32_t scope = 0; scope < ScopeCount; ++scope) {
+                const uint64_t ticks = timestamps[scope * 2 + 1] - timestamps[scope * 2];
+                m_Milliseconds[scope] = static_cast<double>(ticks) * m_TimestampPeriod * 1e-6;
+            }
+        }
+    }
+
+    m_CommandBuffer[CurrentFrame]->resetQueryPool(**m_QueryPool, firstQuery, QueriesPerFrame);
+    m_bPending[CurrentFrame] = true;
+}
+
+void GpuTimer::Begin(uint32_t CurrentFrame, Scope scope) const {
+    if (!m_bSupported) {
+        return;
+    }
+
+    m_CommandBuffer[CurrentFrame]->writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, **m_QueryPool,
+                                                  CurrentFrame * QueriesPerFrame + scope * 2);
+}
+
+void GpuTimer::End(uint32_t CurrentFrame, Scope scope) const {
+    if (!m_bSupported) {
+        return;
+    }
+
+    m_CommandBuffer[CurrentFrame]->writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, **m_QueryPool,
+                                                  CurrentFrame * QueriesPerFrame + scope * 2 + 1);
+}
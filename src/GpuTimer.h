@@ -0,0 +1,60 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+
+// Timestamp pairs around the big parts of the frame. Every frame in flight owns its own range of the query pool,
+// it is read back in BeginFrame once the frame's fence was waited on, so reading never stalls.
+// Every scope has to be begun and ended each frame, otherwise the readback of its slot would not be ready.
+class GpuTimer {
+public:
+    enum Scope : uint32_t {
+        Shadows = 0,
+        Geometry, // culling, depth prepass and G-buffer
+        ShadowMask,
+        LightCulling,
+        Lighting,
+        GBuffer, // inside Geometry, only the G-buffer fill
+        ScopeCount
+    };
+
+    GpuTimer(const vk::raii::Device &Device, const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer,
+             const vk::PhysicalDeviceLimits &Limits, uint32_t FramesInFlight);
+    virtual ~GpuTimer() = default;
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer(GpuTimer&&) noexcept = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+    GpuTimer& operator=(GpuTimer&&) noexcept = delete;
+
+    // Reads what this slot measured last time and resets its queries, record right after the command buffer began
+    void BeginFrame(uint32_t CurrentFrame);
+
+    void Begin(uint32_t CurrentFrame, Scope scope) const;
+    void End(uint32_t CurrentFrame, Scope scope) const;
+
+    // Milliseconds of the last frame that finished on the GPU, 0 without timestamp support
+    [[nodiscard]] double GetMilliseconds(Scope scope) const { return m_Milliseconds[scope]; }
+
+private:
+    const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &m_CommandBuffer;
+
+    std::unique_ptr<vk::raii::QueryPool> m_QueryPool{};
+    double m_TimestampPeriod{};
+    bool m_bSupported{};
+
+    std::vector<bool> m_bPending{};
+    std::array<double, ScopeCount> m_Milliseconds{};
+};
+
+
+#endif //GPUTIMER_H
@@ -0,0 +1,50 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+// FNV-1a, the source keys of the on-disk caches are built from it
+class Hash {
+public:
+    static constexpr uint64_t OffsetBasis = 0xcbf29ce484222325ull;
+    static constexpr uint64_t Prime = 0x100000001b3ull;
+
+    static uint64_t Bytes(uint64_t hash, const void *data, size_t size) {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= Prime;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    static uint64_t Value(uint64_t hash, const T &value) {
+        return Bytes(hash, &value, sizeof(T));
+    }
+
+    // False if the file can't be opened, the hash is left untouched then
+    static bool File(uint64_t &hash, const std::filesystem::path &path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        std::vector<char> chunk(1 << 20);
+        while (file) {
+            file.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            hash = Bytes(hash, chunk.data(), static_cast<size_t>(file.gcount()));
+        }
+        return true;
+    }
+};
+
+#endif //HASH_H
@@ -0,0 +1,251 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "IndirectDrawBuffer.h"
+
+#include <cstddef>
+
+#include "ResourceTracker.h"
+#include "UploadBatcher.h"
+#include "Math/math.h"
+
+IndirectDrawBuffer::IndirectDrawBuffer(VmaAllocator allocator, ResourceTracker *tracker, uint32_t framesInFlight)
+    : m_Allocator(allocator)
+      , m_AllocationTracker(tracker)
+      , m_Buffer(std::make_unique<Buffer>())
+      , m_FramesInFlight(framesInFlight) {
+}
+
+void IndirectDrawBuffer::Build(const std::vector<Mesh> &meshes, UploadBatcher &uploader, uint32_t shadowListCount) {
+    Destroy();
+
+    m_DrawCount = static_cast<uint32_t>(meshes.size());
+    if (m_DrawCount == 0) {
+        return;
+    }
+
+    std::vector<vk::DrawIndexedIndirectCommand> commands;
+    std::vector<DrawData> drawData;
+    std::vector<DrawBounds> bounds;
+    commands.reserve(meshes.size());
+    drawData.reserve(meshes.size());
+    bounds.reserve(meshes.size());
+
+    for (uint32_t drawIdx = 0; drawIdx < m_DrawCount; ++drawIdx) {
+        const Mesh &mesh = meshes[drawIdx];
+
+        vk::DrawIndexedIndirectCommand command{};
+        command.indexCount = mesh.m_IndexCount;
+        command.instanceCount = 1;
+        command.firstIndex = mesh.m_FirstIndex;
+        command.vertexOffset = mesh.m_VertexOffset;
+        command.firstInstance = drawIdx;
+        commands.push_back(command);
+
+        DrawData data{};
+        data.material = mesh.m_Material;
+        data.positionOffset = glm::vec4(mesh.m_Bounds.min, 0.0f);
+        data.positionScale = glm::vec4(mesh.m_Bounds.max - mesh.m_Bounds.min, 0.0f);
+        drawData.push_back(data);
+
+        const glm::vec3 center = 0.5f * (mesh.m_Bounds.min + mesh.m_Bounds.max);
+        const glm::vec3 extents = 0.5f * (mesh.m_Bounds.max - mesh.m_Bounds.min);
+
+        DrawBounds drawBounds{};
+        drawBounds.sphere = glm::vec4(center, mesh.m_Bounds.radius);
+        drawBounds.extents = glm::vec4(extents, mesh.m_bAlphaTested ? 1.0f : 0.0f);
+        bounds.push_back(drawBounds);
+
+        m_CpuBounds.push_back(mesh.m_Bounds);
+    }
+    m_CpuCommands = commands;
+
+    const vk::DeviceSize commandBytes = commands.size() * sizeof(vk::DrawIndexedIndirectCommand);
+    const vk::DeviceSize drawDataBytes = drawData.size() * sizeof(DrawData);
+    const vk::DeviceSize boundsBytes = bounds.size() * sizeof(DrawBounds);
+    const vk::DeviceSize visibilityBytes = m_DrawCount * sizeof(uint32_t);
+
+    m_Commands = m_Buffer->CreateUnmapped(m_Allocator, commandBytes,
+                                          vk::BufferUsageFlagBits::eIndirectBuffer |
+                                          vk::BufferUsageFlagBits::eStorageBuffer |
+                                          vk::BufferUsageFlagBits::eTransferDst,
+                                          VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, m_AllocationTracker,
+                                          "IndirectCommands");
+
+    m_DrawData = m_Buffer->CreateUnmapped(m_Allocator, drawDataBytes,
+                                          vk::BufferUsageFlagBits::eStorageBuffer |
+                                          vk::BufferUsageFlagBits::eTransferDst,
+                                          VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, m_AllocationTracker,
+                                          "DrawData");
+
+    m_Bounds = m_Buffer->CreateUnmapped(m_Allocator, boundsBytes,
+                                        vk::BufferUsageFlagBits::eStorageBuffer |
+                                        vk::BufferUsageFlagBits::eTransferDst,
+                                        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, m_AllocationTracker,
+                                        "DrawBounds");
+
+    m_Visibility = m_Buffer->CreateUnmapped(m_Allocator, visibilityBytes,
+                                            vk::BufferUsageFlagBits::eStorageBuffer |
+                                            vk::BufferUsageFlagBits::eTransferDst,
+                                            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, m_AllocationTracker,
+                                            "DrawVisibility");
+
+    for (uint32_t frame = 0; frame < m_FramesInFlight; ++frame) {
+        m_VisibleCommands.push_back(m_Buffer->CreateUnmapped(m_Allocator, 2 * DrawBucketCount * commandBytes,
+                                                             vk::BufferUsageFlagBits::eIndirectBuffer |
+                                                             vk::BufferUsageFlagBits::eStorageBuffer,
+                                                             VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0,
+                                                             m_AllocationTracker, "VisibleCommands"));
+
+        m_VisibleCounts.push_back(m_Buffer->CreateUnmapped(m_Allocator, CountSlotCount * sizeof(uint32_t),
+                                                           vk::BufferUsageFlagBits::eIndirectBuffer |
+                                                           vk::BufferUsageFlagBits::eStorageBuffer |
+                                                           vk::BufferUsageFlagBits::eTransferDst |
+                                                           vk::BufferUsageFlagBits::eTransferSrc,
+                                                           VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0,
+                                                           m_AllocationTracker, "VisibleCount"));
+
+        if (shadowListCount > 0) {
+            m_ShadowLists.push_back(m_Buffer->CreateMapped(m_Allocator, shadowListCount * commandBytes,
+                                                           vk::BufferUsageFlagBits::eIndirectBuffer,
+                                                           VMA_MEMORY_USAGE_CPU_TO_GPU, 0,
+                                                           m_AllocationTracker, "ShadowLists"));
+            m_ShadowListSizes.emplace_back(shadowListCount, 0);
+        }
+    }
+    m_ShadowListCount = shadowListCount;
+
+    uploader.UploadBuffer(m_Commands.m_Buffer, commands.data(), commandBytes);
+    uploader.UploadBuffer(m_DrawData.m_Buffer, drawData.data(), drawDataBytes);
+    uploader.UploadBuffer(m_Bounds.m_Buffer, bounds.data(), boundsBytes);
+
+    // Nothing was visible before the first frame, so everything goes through the late phase once
+    const std::vector<uint32_t> visibility(m_DrawCount, 0);
+    uploader.UploadBuffer(m_Visibility.m_Buffer, visibility.data(), visibilityBytes);
+}
+
+void IndirectDrawBuffer::Draw(vk::CommandBuffer commandBuffer) const {
+    if (m_DrawCount == 0) {
+        return;
+    }
+
+    commandBuffer.drawIndexedIndirect(m_Commands.m_Buffer, 0, m_DrawCount, sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+void IndirectDrawBuffer::DrawVisible(vk::CommandBuffer commandBuffer, uint32_t frame, DrawBucket bucket) const {
+    if (m_DrawCount == 0) {
+        return;
+    }
+
+    const CountSlot countSlot = bucket == AlphaTested ? EarlyAlphaTested : EarlyDraws;
+    commandBuffer.drawIndexedIndirectCount(m_VisibleCommands[frame].m_Buffer,
+                                           2 * bucket * m_DrawCount * sizeof(vk::DrawIndexedIndirectCommand),
+                                           m_VisibleCounts[frame].m_Buffer, countSlot * sizeof(uint32_t), m_DrawCount,
+                                           sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+void IndirectDrawBuffer::DrawVisibleLate(vk::CommandBuffer commandBuffer, uint32_t frame, DrawBucket bucket) const {
+    if (m_DrawCount == 0) {
+        return;
+    }
+
+    const CountSlot countSlot = bucket == AlphaTested ? LateAlphaTested : LateDraws;
+    commandBuffer.drawIndexedIndirectCount(m_VisibleCommands[frame].m_Buffer,
+                                           (2 * bucket + 1) * m_DrawCount * sizeof(vk::DrawIndexedIndirectCommand),
+                                           m_VisibleCounts[frame].m_Buffer, countSlot * sizeof(uint32_t), m_DrawCount,
+                                           sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+uint32_t IndirectDrawBuffer::BuildShadowList(uint32_t frame, uint32_t list, const std::array<glm::vec4, 6> &planes,
+                                             const glm::mat4 &lightView, const glm::vec4 &receivers) {
+    auto *commands = static_cast<vk::DrawIndexedIndirectCommand *>(m_ShadowLists[frame].m_MappedData) +
+                     static_cast<size_t>(list) * m_DrawCount;
+
+    uint32_t count = 0;
+    for (uint32_t drawIdx = 0; drawIdx < m_DrawCount; ++drawIdx) {
+        const MeshBounds &bounds = m_CpuBounds[drawIdx];
+        if (VulkanMath::IsAABBInFrustum(planes, bounds.min, bounds.max) &&
+            VulkanMath::CanAABBShadowSphere(lightView, bounds.min, bounds.max, receivers)) {
+            commands[count++] = m_CpuCommands[drawIdx];
+        }
+    }
+
+    m_ShadowListSizes[frame][list] = count;
+    return count;
+}
+
+void IndirectDrawBuffer::DrawShadowList(vk::CommandBuffer commandBuffer, uint32_t frame, uint32_t list) const {
+    const uint32_t count = m_ShadowListSizes[frame][list];
+    if (count == 0) {
+        return;
+    }
+
+    commandBuffer.drawIndexedIndirect(m_ShadowLists[frame].m_Buffer,
+                                      static_cast<vk::DeviceSize>(list) * m_DrawCount *
+                                      sizeof(vk::DrawIndexedIndirectCommand),
+                                      count, sizeof(vk::DrawIndexedIndirectCommand));
+}
+
+void IndirectDrawBuffer::MoveDraw(vk::CommandBuffer commandBuffer, uint32_t draw, const glm::vec3 &offset) {
+    MeshBounds &bounds = m_CpuBounds[draw];
+    bounds.min += offset;
+    bounds.max += offset;
+
+    const glm::vec4 positionOffset{bounds.min, 0.0f};
+    const glm::vec4 sphere{0.5f * (bounds.min + bounds.max), bounds.radius};
+
+    // Earlier frames may still read both buffers in their cull and geometry passes
+    constexpr vk::PipelineStageFlags readers = vk::PipelineStageFlagBits::eComputeShader |
+                                               vk::PipelineStageFlagBits::eVertexShader |
+                                               vk::PipelineStageFlagBits::eFragmentShader;
+    commandBuffer.pipelineBarrier(readers, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, nullptr);
+
+    commandBuffer.updateBuffer(m_DrawData.m_Buffer,
+                               draw * sizeof(DrawData) + offsetof(DrawData, positionOffset),
+                               sizeof(positionOffset), &positionOffset);
+    commandBuffer.updateBuffer(m_Bounds.m_Buffer,
+                               draw * sizeof(DrawBounds) + offsetof(DrawBounds, sphere),
+                               sizeof(sphere), &sphere);
+
+    vk::MemoryBarrier updateBarrier{};
+    updateBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    updateBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, readers, {}, updateBarrier, nullptr, nullptr);
+}
+
+void IndirectDrawBuffer::Destroy() {
+    if (m_Commands.m_Buffer) {
+        Buffer::Destroy(m_Allocator, m_Commands.m_Buffer, m_Commands.m_Allocation, m_AllocationTracker);
+        m_Commands = {};
+    }
+    if (m_DrawData.m_Buffer) {
+        Buffer::Destroy(m_Allocator, m_DrawData.m_Buffer, m_DrawData.m_Allocation, m_AllocationTracker);
+        m_DrawData = {};
+    }
+    if (m_Bounds.m_Buffer) {
+        Buffer::Destroy(m_Allocator, m_Bounds.m_Buffer, m_Bounds.m_Allocation, m_AllocationTracker);
+        m_Bounds = {};
+    }
+    if (m_Visibility.m_Buffer) {
+        Buffer::Destroy(m_Allocator, m_Visibility.m_Buffer, m_Visibility.m_Allocation, m_AllocationTracker);
+        m_Visibility = {};
+    }
+
+    for (const BufferInfo &visible: m_VisibleCommands) {
+        Buffer::Destroy(m_Allocator, visible.m_Buffer, visible.m_Allocation, m_AllocationTracker);
+    }
+    for (const BufferInfo &count: m_VisibleCounts) {
+        Buffer::Destroy(m_Allocator, count.m_Buffer, count.m_Allocation, m_AllocationTracker);
+    }
+    m_VisibleCommands.clear();
+    m_VisibleCounts.clear();
+
+    for (const BufferInfo &shadowList: m_ShadowLists) {
+        Buffer::Destroy(m_Allocator, shadowList.m_Buffer, shadowList.m_Allocation, m_AllocationTracker);
+    }
+    m_ShadowLists.clear();
+    m_ShadowListSizes.clear();
+    m_CpuCommands.clear();
+    m_CpuBounds.clear();
+}
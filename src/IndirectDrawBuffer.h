@@ -0,0 +1,116 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef INDIRECTDRAWBUFFER_H
+#define INDIRECTDRAWBUFFER_H
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vk_mem_alloc.h>
+#include <glm/glm.hpp>
+
+#include "Buffer.h"
+#include "Structs/Mesh.h"
+
+class ResourceTracker;
+class UploadBatcher;
+
+// Scene wide indirect draw list: one VkDrawIndexedIndirectCommand per mesh plus a per-draw SSBO.
+// Every command's firstInstance is its own index, shaders look their DrawData up with gl_InstanceIndex.
+// Each frame in flight also owns the compacted lists written by the two CullPass phases plus their draw counts,
+// and a persistent per-draw flag remembers which draws passed the occlusion test last frame.
+// Every phase compacts opaque and alpha tested draws into separate lists, so the opaque depth can be drawn without
+// a fragment shader.
+// Shadow lists are compacted on the CPU, one per shadow cascade, into a mapped buffer owned by the frame. They keep
+// the casters inside the light frustum whose shadow can still reach the part of the camera frustum it covers.
+class IndirectDrawBuffer {
+public:
+    // uint32 slots of the per-frame count buffer
+    enum CountSlot : uint32_t {
+        EarlyDraws = 0, // visible last frame and still in the frustum, drawn before the Hi-Z is built
+        LateDraws,      // newly revealed by the Hi-Z test, drawn after it
+        InFrustum,
+        Occluded,
+        EarlyAlphaTested, // same as EarlyDraws and LateDraws, for the alpha tested bucket
+        LateAlphaTested,
+        CountSlotCount
+    };
+
+    enum DrawBucket : uint32_t {
+        Opaque = 0,
+        AlphaTested,
+        DrawBucketCount
+    };
+
+    IndirectDrawBuffer(VmaAllocator allocator, ResourceTracker *tracker, uint32_t framesInFlight);
+    virtual ~IndirectDrawBuffer() = default;
+
+    IndirectDrawBuffer(const IndirectDrawBuffer&) = delete;
+    IndirectDrawBuffer(IndirectDrawBuffer&&) noexcept = delete;
+    IndirectDrawBuffer& operator=(const IndirectDrawBuffer&) = delete;
+    IndirectDrawBuffer& operator=(IndirectDrawBuffer&&) noexcept = delete;
+
+    // Records the uploads of the draw list, the previous buffers must not be in use anymore
+    void Build(const std::vector<Mesh> &meshes, UploadBatcher &uploader, uint32_t shadowListCount = 0);
+
+    // Geometry has to be bound already, the whole list is a single draw call
+    void Draw(vk::CommandBuffer commandBuffer) const;
+
+    // Same as Draw, but only the draws of the bucket the early cull phase kept
+    void DrawVisible(vk::CommandBuffer commandBuffer, uint32_t frame, DrawBucket bucket) const;
+
+    // The draws of the bucket the late cull phase found visible that were not part of the early list
+    void DrawVisibleLate(vk::CommandBuffer commandBuffer, uint32_t frame, DrawBucket bucket) const;
+
+    // Keeps the draws whose box touches the planes (inward facing, see VulkanMath::ExtractFrustumPlanes) and can
+    // shadow the receiver sphere, see VulkanMath::CanAABBShadowSphere.
+    // Only call once the frame's fence was waited on, the list is written through the mapping
+    uint32_t BuildShadowList(uint32_t frame, uint32_t list, const std::array<glm::vec4, 6> &planes,
+                             const glm::mat4 &lightView, const glm::vec4 &receivers);
+
+    void DrawShadowList(vk::CommandBuffer commandBuffer, uint32_t frame, uint32_t list) const;
+
+    // Translates one draw: records the updates of its DrawData offset and culling bounds and moves the CPU bounds the
+    // shadow lists are built from. Has to be recorded before the frame's cull pass
+    void MoveDraw(vk::CommandBuffer commandBuffer, uint32_t draw, const glm::vec3 &offset);
+
+    [[nodiscard]] const BufferInfo &GetCommands() const { return m_Commands; }
+    [[nodiscard]] const BufferInfo &GetDrawData() const { return m_DrawData; }
+    [[nodiscard]] const BufferInfo &GetBounds() const { return m_Bounds; }
+    [[nodiscard]] const BufferInfo &GetVisibleCommands(uint32_t frame) const { return m_VisibleCommands[frame]; }
+    [[nodiscard]] const BufferInfo &GetVisibleCount(uint32_t frame) const { return m_VisibleCounts[frame]; }
+    [[nodiscard]] const BufferInfo &GetVisibility() const { return m_Visibility; }
+    [[nodiscard]] uint32_t GetDrawCount() const { return m_DrawCount; }
+
+    void Destroy();
+
+private:
+    VmaAllocator m_Allocator{};
+    ResourceTracker *m_AllocationTracker{};
+
+    std::unique_ptr<Buffer> m_Buffer{};
+    BufferInfo m_Commands{};
+    BufferInfo m_DrawData{};
+    BufferInfo m_Bounds{};
+    BufferInfo m_Visibility{};
+    uint32_t m_DrawCount{};
+
+    uint32_t m_FramesInFlight{};
+    // Four lists of m_DrawCount commands: early and late opaque, then early and late alpha tested
+    std::vector<BufferInfo> m_VisibleCommands{};
+    std::vector<BufferInfo> m_VisibleCounts{};
+
+    // CPU copies for the shadow lists, bounds are in object space like the ones the cull pass reads
+    std::vector<vk::DrawIndexedIndirectCommand> m_CpuCommands{};
+    std::vector<MeshBounds> m_CpuBounds{};
+    uint32_t m_ShadowListCount{};
+    std::vector<BufferInfo> m_ShadowLists{};
+    std::vector<std::vector<uint32_t>> m_ShadowListSizes{};
+};
+
+
+#endif //INDIRECTDRAWBUFFER_H
@@ -0,0 +1,91 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <latch>
+
+JobSystem::JobSystem(uint32_t ThreadCount) {
+    // hardware_concurrency may not know and report 0, the caller alone still gets everything done
+    const uint32_t workerCount = std::max(ThreadCount, 1u) - 1;
+    m_Workers.reserve(workerCount);
+    for (uint32_t i = 0; i < workerCount; ++i) {
+        m_Workers.emplace_back(&JobSystem::WorkerLoop, this);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard lock(m_Mutex);
+        m_bStopping = true;
+    }
+    m_WakeWorkers.notify_all();
+
+    for (std::thread &worker: m_Workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::ParallelFor(uint32_t Count, const std::function<void(uint32_t)> &Job) {
+    if (Count == 0) {
+        return;
+    }
+
+    std::atomic<uint32_t> next{0};
+    std::mutex errorMutex{};
+    std::exception_ptr error{};
+
+    auto run = [&] {
+        for (uint32_t i = next++; i < Count; i = next++) {
+            try {
+                Job(i);
+            } catch (...) {
+                std::lock_guard lock(errorMutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+
+    // No point waking more workers than there are indices left once the caller took its own
+    const uint32_t helperCount = std::min(static_cast<uint32_t>(m_Workers.size()), Count - 1);
+    std::latch done(helperCount);
+    {
+        std::lock_guard lock(m_Mutex);
+        for (uint32_t i = 0; i < helperCount; ++i) {
+            m_Jobs.emplace_back([&run, &done] {
+                run();
+                done.count_down();
+            });
+        }
+    }
+    m_WakeWorkers.notify_all();
+
+    run();
+    done.wait();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void JobSystem::WorkerLoop() {
+    while (true) {
+        std::function<void()> job{};
+        {
+            std::unique_lock lock(m_Mutex);
+            m_WakeWorkers.wait(lock, [this] { return m_bStopping || !m_Jobs.empty(); });
+            if (m_Jobs.empty()) {
+                return;
+            }
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,48 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads, sized so that the workers plus the calling thread cover every hardware core.
+// Work goes in as ParallelFor, which the caller helps with and which returns once every index ran.
+// Not reentrant: a job must not start another ParallelFor on the same pool.
+class JobSystem {
+public:
+    explicit JobSystem(uint32_t ThreadCount = std::thread::hardware_concurrency());
+    virtual ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem(JobSystem&&) noexcept = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    JobSystem& operator=(JobSystem&&) noexcept = delete;
+
+    // Runs Job for every index in [0, Count), indices are handed out one at a time to whichever thread is free.
+    // The first exception a job throws is rethrown here after the rest finished
+    void ParallelFor(uint32_t Count, const std::function<void(uint32_t)> &Job);
+
+    // Workers plus the calling thread
+    [[nodiscard]] uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()) + 1; }
+
+private:
+    void WorkerLoop();
+
+    std::mutex m_Mutex{};
+    std::condition_variable m_WakeWorkers{};
+    std::deque<std::function<void()>> m_Jobs{};
+    bool m_bStopping{ false };
+
+    std::vector<std::thread> m_Workers{};
+};
+
+
+#endif //JOBSYSTEM_H
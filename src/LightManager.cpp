@@ -0,0 +1,185 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "LightManager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "ResourceTracker.h"
+#include "UniformRing.h"
+
+LightManager::LightManager(const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer,
+                           VmaAllocator Allocator, ResourceTracker *AllocationTracker, uint32_t FramesInFlight,
+                           uint32_t Capacity)
+    : m_CommandBuffer(CommandBuffer)
+      , m_Allocator(Allocator)
+      , m_AllocationTracker(AllocationTracker)
+      , m_Buffer(std::make_unique<Buffer>())
+      , m_Retired(FramesInFlight) {
+    CreateBuffer(std::max(Capacity, MinCapacity));
+}
+
+LightManager::Handle LightManager::Add(const PointLight &Light) {
+    Handle slot{};
+    if (!m_FreeSlots.empty()) {
+        slot = m_FreeSlots.back();
+        m_FreeSlots.pop_back();
+        m_Lights[slot] = Light;
+    } else {
+        slot = static_cast<Handle>(m_Lights.size());
+        m_Lights.push_back(Light);
+        m_bDirty.push_back(false);
+    }
+
+    MarkDirty(slot);
+    return slot;
+}
+
+void LightManager::Remove(Handle Light) {
+    // No range, shaders skip the slot until it is handed out again
+    m_Lights[Light] = {};
+    m_FreeSlots.push_back(Light);
+    MarkDirty(Light);
+}
+
+void LightManager::Set(Handle Light, const PointLight &Value) {
+    m_Lights[Light] = Value;
+    MarkDirty(Light);
+}
+
+void LightManager::SetPosition(Handle Light, const glm::vec3 &Position) {
+    glm::vec4 &position = m_Lights[Light].Position;
+    position = glm::vec4(Position, position.w);
+    MarkDirty(Light);
+}
+
+void LightManager::Grow(uint32_t CurrentFrame) {
+    uint32_t capacity = m_Capacity;
+    while (capacity < m_Lights.size()) {
+        capacity *= 2;
+    }
+
+    // Not copied out of yet, nothing in flight reads it either
+    if (m_GrownFrom.m_Buffer) {
+        m_Retired[CurrentFrame].push_back(m_LightBuffer);
+    } else {
+        m_GrownFrom = m_LightBuffer;
+        m_GrownFromCapacity = m_Capacity;
+    }
+
+    CreateBuffer(capacity);
+}
+
+void LightManager::Update(uint32_t CurrentFrame, UniformRing &Ring) {
+    using AF = vk::AccessFlagBits;
+    using PS = vk::PipelineStageFlagBits;
+
+    for (BufferInfo &retired: m_Retired[CurrentFrame]) {
+        Buffer::Destroy(m_Allocator, retired.m_Buffer, retired.m_Allocation, m_AllocationTracker);
+    }
+    m_Retired[CurrentFrame].clear();
+
+    if (!m_bClearPending && !m_GrownFrom.m_Buffer && m_DirtySlots.empty()) {
+        return;
+    }
+    if (NeedsGrowth()) {
+        throw std::runtime_error("Light buffer has to grow before it is updated!");
+    }
+
+    const vk::raii::CommandBuffer &cmd = *m_CommandBuffer[CurrentFrame];
+
+    // The buffer is shared between frames, the previous one may still be reading it
+    vk::MemoryBarrier readBarrier{};
+    readBarrier.srcAccessMask = AF::eShaderRead;
+    readBarrier.dstAccessMask = AF::eTransferWrite;
+    cmd.pipelineBarrier(PS::eComputeShader | PS::eFragmentShader, PS::eTransfer, {}, readBarrier, nullptr, nullptr);
+
+    if (m_bClearPending || m_GrownFrom.m_Buffer) {
+        // Slots past the old contents may be walked before their light was staged, they have to read as free
+        const vk::DeviceSize kept = sizeof(PointLight) * m_GrownFromCapacity;
+        cmd.fillBuffer(m_LightBuffer.m_Buffer, kept, VK_WHOLE_SIZE, 0);
+
+        if (m_GrownFrom.m_Buffer) {
+            cmd.copyBuffer(m_GrownFrom.m_Buffer, m_LightBuffer.m_Buffer, vk::BufferCopy{0, 0, kept});
+            m_Retired[CurrentFrame].push_back(m_GrownFrom);
+        }
+
+        m_GrownFrom = {};
+        m_GrownFromCapacity = 0;
+        m_bClearPending = false;
+
+        vk::MemoryBarrier fillBarrier{};
+        fillBarrier.srcAccessMask = AF::eTransferWrite;
+        fillBarrier.dstAccessMask = AF::eTransferWrite;
+        cmd.pipelineBarrier(PS::eTransfer, PS::eTransfer, {}, fillBarrier, nullptr, nullptr);
+    }
+
+    if (!m_DirtySlots.empty()) {
+        // Sorted, neighbouring slots become one copy region
+        std::sort(m_DirtySlots.begin(), m_DirtySlots.end());
+        const uint32_t uploads = std::min(static_cast<uint32_t>(m_DirtySlots.size()), MaxUploadsPerFrame);
+
+        uint32_t stagingOffset{};
+        std::byte *staging = Ring.Allocate(sizeof(PointLight) * uploads, stagingOffset);
+
+        std::vector<vk::BufferCopy> regions{};
+        for (uint32_t i = 0; i < uploads; ++i) {
+            const Handle slot = m_DirtySlots[i];
+            std::memcpy(staging + sizeof(PointLight) * i, &m_Lights[slot], sizeof(PointLight));
+            m_bDirty[slot] = false;
+
+            if (i > 0 && m_DirtySlots[i - 1] + 1 == slot) {
+                regions.back().size += sizeof(PointLight);
+            } else {
+                regions.emplace_back(stagingOffset + sizeof(PointLight) * i, sizeof(PointLight) * slot,
+                                     sizeof(PointLight));
+            }
+        }
+        cmd.copyBuffer(Ring.GetBuffer().m_Buffer, m_LightBuffer.m_Buffer, regions);
+
+        m_DirtySlots.erase(m_DirtySlots.begin(), m_DirtySlots.begin() + uploads);
+    }
+
+    vk::MemoryBarrier writeBarrier{};
+    writeBarrier.srcAccessMask = AF::eTransferWrite;
+    writeBarrier.dstAccessMask = AF::eShaderRead;
+    cmd.pipelineBarrier(PS::eTransfer, PS::eComputeShader | PS::eFragmentShader, {}, writeBarrier, nullptr, nullptr);
+}
+
+void LightManager::Destroy() {
+    for (auto &frame: m_Retired) {
+        for (BufferInfo &retired: frame) {
+            Buffer::Destroy(m_Allocator, retired.m_Buffer, retired.m_Allocation, m_AllocationTracker);
+        }
+        frame.clear();
+    }
+    if (m_GrownFrom.m_Buffer) {
+        Buffer::Destroy(m_Allocator, m_GrownFrom.m_Buffer, m_GrownFrom.m_Allocation, m_AllocationTracker);
+        m_GrownFrom = {};
+    }
+    if (m_LightBuffer.m_Buffer) {
+        Buffer::Destroy(m_Allocator, m_LightBuffer.m_Buffer, m_LightBuffer.m_Allocation, m_AllocationTracker);
+        m_LightBuffer = {};
+    }
+}
+
+void LightManager::CreateBuffer(uint32_t Capacity) {
+    m_Capacity = Capacity;
+    m_LightBuffer = m_Buffer->CreateUnmapped(m_Allocator, sizeof(PointLight) * Capacity,
+                                             vk::BufferUsageFlagBits::eStorageBuffer |
+                                             vk::BufferUsageFlagBits::eTransferDst |
+                                             vk::BufferUsageFlagBits::eTransferSrc,
+                                             VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, m_AllocationTracker,
+                                             "PointLights");
+    m_bClearPending = true;
+}
+
+void LightManager::MarkDirty(Handle Light) {
+    if (!m_bDirty[Light]) {
+        m_bDirty[Light] = true;
+        m_DirtySlots.push_back(Light);
+    }
+}
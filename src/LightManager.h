@@ -0,0 +1,93 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef LIGHTMANAGER_H
+#define LIGHTMANAGER_H
+
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.h>
+#include <glm/glm.hpp>
+
+#include "Buffer.h"
+#include "Structs/Lights.h"
+
+class ResourceTracker;
+class UniformRing;
+
+// Point lights in one device local SSBO that grows by doubling. Slots of removed lights go to a free list and are
+// handed out again, until then they hold a light without range that every shader skips. The CPU keeps a copy of
+// every slot, only the slots changed since the last frame are staged through the uniform ring and copied over.
+// Shaders read the slot count from the camera UBO, so adding lights never touches a pipeline.
+class LightManager {
+public:
+    using Handle = uint32_t;
+
+    static constexpr uint32_t MinCapacity = 256;
+    // Slots staged per frame at most, what is left over goes out with the next frames
+    static constexpr uint32_t MaxUploadsPerFrame = 4096;
+
+    LightManager(const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer, VmaAllocator Allocator,
+                 ResourceTracker *AllocationTracker, uint32_t FramesInFlight, uint32_t Capacity = MinCapacity);
+    virtual ~LightManager() = default;
+
+    LightManager(const LightManager&) = delete;
+    LightManager(LightManager&&) noexcept = delete;
+    LightManager& operator=(const LightManager&) = delete;
+    LightManager& operator=(LightManager&&) noexcept = delete;
+
+    Handle Add(const PointLight &Light);
+    void Remove(Handle Light);
+    void Set(Handle Light, const PointLight &Value);
+    void SetPosition(Handle Light, const glm::vec3 &Position);
+
+    [[nodiscard]] const PointLight &Get(Handle Light) const { return m_Lights[Light]; }
+
+    // Slots the shaders walk, free ones included
+    [[nodiscard]] uint32_t GetSlotCount() const { return static_cast<uint32_t>(m_Lights.size()); }
+    [[nodiscard]] uint32_t GetLightCount() const { return GetSlotCount() - static_cast<uint32_t>(m_FreeSlots.size()); }
+
+    // More slots are in use than the buffer holds. Grow swaps the buffer, the replaced one stays alive until every
+    // frame in flight is done with it, so each frame's descriptor set can be rewritten once its fence was waited on
+    [[nodiscard]] bool NeedsGrowth() const { return m_Lights.size() > m_Capacity; }
+    void Grow(uint32_t CurrentFrame);
+
+    // Records the copies of the changed slots, after the command buffer began and before any pass reads the lights
+    void Update(uint32_t CurrentFrame, UniformRing &Ring);
+
+    [[nodiscard]] const BufferInfo &GetBuffer() const { return m_LightBuffer; }
+
+    void Destroy();
+
+private:
+    void CreateBuffer(uint32_t Capacity);
+    void MarkDirty(Handle Light);
+
+    const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &m_CommandBuffer;
+
+    VmaAllocator m_Allocator{};
+    ResourceTracker *m_AllocationTracker{};
+    std::unique_ptr<Buffer> m_Buffer{};
+
+    BufferInfo m_LightBuffer{};
+    uint32_t m_Capacity{};
+
+    // Contents of the previous buffer still have to be copied into the grown one
+    BufferInfo m_GrownFrom{};
+    uint32_t m_GrownFromCapacity{};
+    bool m_bClearPending{};
+    // Replaced buffers, destroyed once the frame that copied out of them came around again
+    std::vector<std::vector<BufferInfo>> m_Retired{};
+
+    std::vector<PointLight> m_Lights{};
+    std::vector<Handle> m_FreeSlots{};
+    std::vector<Handle> m_DirtySlots{};
+    std::vector<bool> m_bDirty{};
+};
+
+
+#endif //LIGHTMANAGER_H
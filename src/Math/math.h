@@ -6,7 +6,18 @@
 #define MATH_H
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <span>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define VULKANMATH_SSE
+#endif
 
 #include "Structs/Mesh.h"
 
@@ -25,20 +36,194 @@ public:
         };
     }
 
-    static std::pair<glm::vec3, glm::vec3> ComputeSceneAABB(const std::vector<Mesh>& Meshes) {
-        glm::vec3 outMin = glm::vec3(std::numeric_limits<float>::infinity());
-        glm::vec3 outMax = glm::vec3(-std::numeric_limits<float>::infinity());
+    // Min/max reduction over the positions with SSE, then a second pass for the sphere radius around the box center.
+    // Runs once per sub-mesh at import, the result travels with the MeshRecord through the mesh cache.
+    static MeshBounds ComputeMeshBounds(std::span<const Vertex> vertices) {
+        MeshBounds bounds{};
+        if (vertices.empty()) {
+            return bounds;
+        }
+
+#ifdef VULKANMATH_SSE
+        // pos is followed by texCoord inside Vertex, so the 4th lane of every load is in bounds and simply ignored
+        static_assert(offsetof(Vertex, pos) == 0 && sizeof(Vertex) >= 4 * sizeof(float));
+
+        __m128 minPos = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        __m128 maxPos = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        for (const Vertex& vertex : vertices) {
+            const __m128 pos = _mm_loadu_ps(&vertex.pos.x);
+            minPos = _mm_min_ps(minPos, pos);
+            maxPos = _mm_max_ps(maxPos, pos);
+        }
+
+        const __m128 center = _mm_mul_ps(_mm_add_ps(minPos, maxPos), _mm_set1_ps(0.5f));
+        __m128 maxDistanceSq = _mm_setzero_ps();
+        for (const Vertex& vertex : vertices) {
+            const __m128 offset = _mm_sub_ps(_mm_loadu_ps(&vertex.pos.x), center);
+            const __m128 squared = _mm_mul_ps(offset, offset);
+            __m128 distanceSq = _mm_add_ss(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(1, 1, 1, 1)));
+            distanceSq = _mm_add_ss(distanceSq, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(2, 2, 2, 2)));
+            maxDistanceSq = _mm_max_ss(maxDistanceSq, distanceSq);
+        }
+
+        alignas(16) float outMin[4];
+        alignas(16) float outMax[4];
+        _mm_store_ps(outMin, minPos);
+        _mm_store_ps(outMax, maxPos);
+
+        bounds.min = glm::vec3(outMin[0], outMin[1], outMin[2]);
+        bounds.max = glm::vec3(outMax[0], outMax[1], outMax[2]);
+        bounds.radius = std::sqrt(_mm_cvtss_f32(maxDistanceSq));
+#else
+        for (const Vertex& vertex : vertices) {
+            bounds.min = glm::min(bounds.min, vertex.pos);
+            bounds.max = glm::max(bounds.max, vertex.pos);
+        }
+
+        const glm::vec3 center = 0.5f * (bounds.min + bounds.max);
+        float maxDistanceSq = 0.0f;
+        for (const Vertex& vertex : vertices) {
+            const glm::vec3 offset = vertex.pos - center;
+            maxDistanceSq = std::max(maxDistanceSq, glm::dot(offset, offset));
+        }
+        bounds.radius = std::sqrt(maxDistanceSq);
+#endif
+
+        return bounds;
+    }
+
+    // Folds the unit sphere onto the [-1, 1] square, the lower hemisphere ends up in the corners
+    static glm::vec2 OctahedralEncode(const glm::vec3& n) {
+        const float length = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        if (length == 0.0f) {
+            return glm::vec2(0.0f);
+        }
+
+        const glm::vec3 p = n / length;
+        if (p.z >= 0.0f) {
+            return glm::vec2(p.x, p.y);
+        }
+        return glm::vec2((1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                         (1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+    }
+
+    // Same unfold as octahedralDecode in GBuffer.vert
+    static glm::vec3 OctahedralDecode(const glm::vec2& e) {
+        glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+        const float t = std::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+
+    // Quantizes the position inside the bounds of its sub-mesh, those have to be the ones DrawData gets
+    static PackedVertex PackVertex(const Vertex& vertex, const MeshBounds& bounds) {
+        PackedVertex packed{};
+
+        const glm::vec3 scale = bounds.max - bounds.min;
+        for (int axis = 0; axis < 3; ++axis) {
+            const float unorm = scale[axis] > 0.0f ? (vertex.pos[axis] - bounds.min[axis]) / scale[axis] : 0.0f;
+            packed.position[axis] = glm::packUnorm1x16(unorm);
+        }
+        const float handedness = glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent);
+        packed.position[3] = handedness < 0.0f ? 0 : 0xFFFF;
+
+        const glm::vec2 normal = OctahedralEncode(vertex.normal);
+        const glm::vec2 tangent = OctahedralEncode(vertex.tangent);
+        packed.tangentFrame[0] = static_cast<int16_t>(glm::packSnorm1x16(normal.x));
+        packed.tangentFrame[1] = static_cast<int16_t>(glm::packSnorm1x16(normal.y));
+        packed.tangentFrame[2] = static_cast<int16_t>(glm::packSnorm1x16(tangent.x));
+        packed.tangentFrame[3] = static_cast<int16_t>(glm::packSnorm1x16(tangent.y));
+
+        packed.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+        packed.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+        return packed;
+    }
+
+    // CPU mirror of what the vertex shaders decode, the bitangent comes back orthogonal to normal and tangent
+    static Vertex UnpackVertex(const PackedVertex& packed, const MeshBounds& bounds) {
+        Vertex vertex{};
+
+        const glm::vec3 unorm(glm::unpackUnorm1x16(packed.position[0]), glm::unpackUnorm1x16(packed.position[1]),
+                              glm::unpackUnorm1x16(packed.position[2]));
+        vertex.pos = bounds.min + unorm * (bounds.max - bounds.min);
+
+        auto snorm = [&packed](int i) { return glm::unpackSnorm1x16(static_cast<uint16_t>(packed.tangentFrame[i])); };
+        vertex.normal = OctahedralDecode(glm::vec2(snorm(0), snorm(1)));
+        vertex.tangent = OctahedralDecode(glm::vec2(snorm(2), snorm(3)));
+        vertex.bitangent = glm::cross(vertex.normal, vertex.tangent) * (packed.position[3] != 0 ? 1.0f : -1.0f);
+
+        vertex.texCoord = glm::vec2(glm::unpackHalf1x16(packed.texCoord[0]), glm::unpackHalf1x16(packed.texCoord[1]));
+        return vertex;
+    }
+
+    // Grows the scene bounds by one mesh without touching its vertices, the sphere becomes the one around the box
+    static void ExpandBounds(MeshBounds& scene, const MeshBounds& mesh) {
+        scene.min = glm::min(scene.min, mesh.min);
+        scene.max = glm::max(scene.max, mesh.max);
+        scene.radius = 0.5f * glm::length(scene.max - scene.min);
+    }
+
+    // Gribb/Hartmann planes of a zero-to-one depth clip space, normalized so xyz.dot(p) + w is a distance.
+    // Order: left, right, bottom, top, near, far. The normals point inwards.
+    static std::array<glm::vec4, 6> ExtractFrustumPlanes(const glm::mat4& clip) {
+        const glm::vec4 row0{clip[0][0], clip[1][0], clip[2][0], clip[3][0]};
+        const glm::vec4 row1{clip[0][1], clip[1][1], clip[2][1], clip[3][1]};
+        const glm::vec4 row2{clip[0][2], clip[1][2], clip[2][2], clip[3][2]};
+        const glm::vec4 row3{clip[0][3], clip[1][3], clip[2][3], clip[3][3]};
 
-        for (const auto& mesh : Meshes)
-        {
-            for (const glm::vec3& pos : mesh.m_Positions)
-            {
-                outMin = glm::min(outMin, pos);
-                outMax = glm::max(outMax, pos);
+        std::array<glm::vec4, 6> planes{
+            row3 + row0,
+            row3 - row0,
+            row3 + row1,
+            row3 - row1,
+            row2,
+            row3 - row2
+        };
+
+        for (auto& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+
+        return planes;
+    }
+
+    // Conservative box test against inward facing planes: only the corner furthest along each normal is checked
+    static bool IsAABBInFrustum(const std::array<glm::vec4, 6>& planes, const glm::vec3& mn, const glm::vec3& mx) {
+        for (const auto& plane : planes) {
+            const glm::vec3 positive{
+                plane.x >= 0.f ? mx.x : mn.x,
+                plane.y >= 0.f ? mx.y : mn.y,
+                plane.z >= 0.f ? mx.z : mn.z
+            };
+            if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.f) {
+                return false;
             }
         }
+        return true;
+    }
+
+    // Whether a caster can throw shadow into the receiver sphere (xyz center, w radius). LightView is a rotation
+    // looking down -z along the light, the box is swept that way: it has to overlap the sphere's disk in light
+    // space and must not lie entirely past the sphere along the light
+    static bool CanAABBShadowSphere(const glm::mat4& lightView, const glm::vec3& mn, const glm::vec3& mx,
+                                    const glm::vec4& sphere) {
+        glm::vec3 boxMin{std::numeric_limits<float>::max()};
+        glm::vec3 boxMax{std::numeric_limits<float>::lowest()};
+        for (const auto& corner : GetAABBCorners(mn, mx)) {
+            const glm::vec3 lightSpace{lightView * glm::vec4(corner, 1.f)};
+            boxMin = glm::min(boxMin, lightSpace);
+            boxMax = glm::max(boxMax, lightSpace);
+        }
+
+        const glm::vec3 center{lightView * glm::vec4(glm::vec3(sphere), 1.f)};
+        if (boxMax.z < center.z - sphere.w) {
+            return false;
+        }
 
-        return { outMin, outMax };
+        const glm::vec2 closest = glm::clamp(glm::vec2(center), glm::vec2(boxMin), glm::vec2(boxMax));
+        const glm::vec2 offset = closest - glm::vec2(center);
+        return glm::dot(offset, offset) <= sphere.w * sphere.w;
     }
 
 };
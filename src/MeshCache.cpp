@@ -0,0 +1,308 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Hash.h"
+
+static_assert(std::is_trivially_copyable_v<PackedVertex>, "PackedVertex is written to the mesh cache as raw bytes");
+static_assert(std::is_trivially_copyable_v<MeshRecord>, "MeshRecord is written to the mesh cache as raw bytes");
+
+namespace {
+    // glTF keeps its geometry in external .bin buffers, which have to be part of the key as well.
+    std::vector<std::string> FindExternalBuffers(const std::filesystem::path &gltfPath) {
+        std::ifstream file(gltfPath, std::ios::binary);
+        std::string json{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+        std::vector<std::string> uris;
+        size_t pos = 0;
+        while ((pos = json.find("\"uri\"", pos)) != std::string::npos) {
+            pos += 5;
+            size_t open = json.find('"', json.find(':', pos));
+            if (open == std::string::npos) break;
+            size_t close = json.find('"', open + 1);
+            if (close == std::string::npos) break;
+
+            std::string uri = json.substr(open + 1, close - open - 1);
+            pos = close + 1;
+
+            if (uri.starts_with("data:")) continue;
+            if (uri.size() > 4 && uri.substr(uri.size() - 4) == ".bin") {
+                uris.emplace_back(std::move(uri));
+            }
+        }
+        return uris;
+    }
+
+    constexpr uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+MappedFile::MappedFile(const std::filesystem::path &path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    m_File = file;
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) return;
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return;
+    m_Mapping = mapping;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) return;
+
+    m_Data = static_cast<const std::byte *>(view);
+    m_Size = static_cast<size_t>(size.QuadPart);
+#else
+    m_FileDescriptor = open(path.c_str(), O_RDONLY);
+    if (m_FileDescriptor < 0) return;
+
+    struct stat st{};
+    if (fstat(m_FileDescriptor, &st) != 0 || st.st_size == 0) return;
+
+    void *view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, m_FileDescriptor, 0);
+    if (view == MAP_FAILED) return;
+
+    m_Data = static_cast<const std::byte *>(view);
+    m_Size = static_cast<size_t>(st.st_size);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (m_Data) UnmapViewOfFile(m_Data);
+    if (m_Mapping) CloseHandle(m_Mapping);
+    if (m_File) CloseHandle(m_File);
+#else
+    if (m_Data) munmap(const_cast<std::byte *>(m_Data), m_Size);
+    if (m_FileDescriptor >= 0) close(m_FileDescriptor);
+#endif
+}
+
+std::filesystem::path MeshCache::GetCachePath(const std::filesystem::path &sourcePath) {
+    std::filesystem::path cachePath = sourcePath;
+    cachePath += ".meshcache";
+    return cachePath;
+}
+
+uint64_t MeshCache::ComputeSourceKey(const std::filesystem::path &sourcePath, uint32_t importFlags) {
+    uint64_t hash = Hash::OffsetBasis;
+    if (!Hash::File(hash, sourcePath)) {
+        return 0;
+    }
+
+    if (sourcePath.extension() == ".gltf") {
+        for (const auto &uri: FindExternalBuffers(sourcePath)) {
+            Hash::File(hash, sourcePath.parent_path() / uri);
+        }
+    }
+
+    hash = Hash::Value(hash, importFlags);
+    hash = Hash::Value(hash, Version);
+    hash = Hash::Value(hash, static_cast<uint32_t>(sizeof(PackedVertex)));
+    return hash;
+}
+
+std::optional<ModelData> MeshCache::Load(const std::filesystem::path &sourcePath, uint32_t importFlags) {
+    const std::filesystem::path cachePath = GetCachePath(sourcePath);
+    if (!std::filesystem::exists(cachePath)) {
+        return std::nullopt;
+    }
+
+    auto mapping = std::make_unique<MappedFile>(cachePath);
+    if (!mapping->IsValid() || mapping->GetSize() < sizeof(Header)) {
+        std::cout << "Mesh cache unreadable, reimporting: " << cachePath << std::endl;
+        return std::nullopt;
+    }
+
+    Header header{};
+    std::memcpy(&header, mapping->GetData(), sizeof(Header));
+
+    if (header.magic != Magic || header.version != Version || header.vertexStride != sizeof(PackedVertex)) {
+        std::cout << "Mesh cache version mismatch, reimporting: " << cachePath << std::endl;
+        return std::nullopt;
+    }
+
+    if (header.sourceKey != ComputeSourceKey(sourcePath, importFlags)) {
+        std::cout << "Mesh cache is stale, reimporting: " << cachePath << std::endl;
+        return std::nullopt;
+    }
+
+    const uint64_t size = mapping->GetSize();
+    auto inRange = [size](uint64_t offset, uint64_t bytes) {
+        return offset <= size && bytes <= size - offset;
+    };
+
+    bool streamsInRange = header.vertexCount <= std::numeric_limits<uint32_t>::max();
+    for (uint32_t stream = 0; stream < VertexStreamCount; ++stream) {
+        streamsInRange &= inRange(header.vertexStreamOffsets[stream],
+                                  header.vertexCount * PackedVertex::StreamStrides[stream]) &&
+                          header.vertexStreamOffsets[stream] % alignof(PackedVertex) == 0;
+    }
+
+    if (header.fileSize != size ||
+        !inRange(header.meshesOffset, header.meshCount * sizeof(MeshRecord)) ||
+        !inRange(header.texturesOffset, header.textureCount * sizeof(TextureEntry)) ||
+        !inRange(header.stringsOffset, header.stringBytes) ||
+        !streamsInRange ||
+        !inRange(header.indicesOffset, header.indexCount * sizeof(uint32_t)) ||
+        header.indicesOffset % alignof(uint32_t) != 0) {
+        std::cout << "Mesh cache is corrupt, reimporting: " << cachePath << std::endl;
+        return std::nullopt;
+    }
+
+    const std::byte *data = mapping->GetData();
+
+    ModelData model{};
+    model.meshes.resize(header.meshCount);
+    std::memcpy(model.meshes.data(), data + header.meshesOffset, header.meshCount * sizeof(MeshRecord));
+
+    const char *strings = reinterpret_cast<const char *>(data + header.stringsOffset);
+    model.textures.reserve(header.textureCount);
+    for (uint32_t i = 0; i < header.textureCount; ++i) {
+        TextureEntry entry{};
+        std::memcpy(&entry, data + header.texturesOffset + i * sizeof(TextureEntry), sizeof(TextureEntry));
+        if (static_cast<uint64_t>(entry.pathOffset) + entry.pathLength > header.stringBytes ||
+            entry.usage > static_cast<uint32_t>(TextureUsage::Occlusion)) {
+            std::cout << "Mesh cache is corrupt, reimporting: " << cachePath << std::endl;
+            return std::nullopt;
+        }
+        model.textures.push_back({
+            std::string(strings + entry.pathOffset, entry.pathLength), static_cast<vk::Format>(entry.format),
+            static_cast<TextureUsage>(entry.usage)
+        });
+    }
+
+    for (const auto &mesh: model.meshes) {
+        if (static_cast<uint64_t>(mesh.firstVertex) + mesh.vertexCount > header.vertexCount ||
+            static_cast<uint64_t>(mesh.firstIndex) + mesh.indexCount > header.indexCount) {
+            std::cout << "Mesh cache is corrupt, reimporting: " << cachePath << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    for (uint32_t stream = 0; stream < VertexStreamCount; ++stream) {
+        model.vertexStreams[stream] = {
+            data + header.vertexStreamOffsets[stream],
+            static_cast<size_t>(header.vertexCount * PackedVertex::StreamStrides[stream])
+        };
+    }
+    model.vertexCount = static_cast<uint32_t>(header.vertexCount);
+    model.indices = {
+        reinterpret_cast<const uint32_t *>(data + header.indicesOffset), static_cast<size_t>(header.indexCount)
+    };
+    model.mapping = std::move(mapping);
+
+    return model;
+}
+
+bool MeshCache::Write(const std::filesystem::path &sourcePath, uint32_t importFlags, const ModelData &model) {
+    std::string strings;
+    std::vector<TextureEntry> textureEntries;
+    textureEntries.reserve(model.textures.size());
+    for (const auto &texture: model.textures) {
+        textureEntries.push_back({
+            static_cast<uint32_t>(texture.format),
+            static_cast<uint32_t>(texture.usage),
+            static_cast<uint32_t>(strings.size()),
+            static_cast<uint32_t>(texture.path.size())
+        });
+        strings += texture.path;
+    }
+
+    Header header{};
+    header.magic = Magic;
+    header.version = Version;
+    header.sourceKey = ComputeSourceKey(sourcePath, importFlags);
+    header.vertexStride = sizeof(PackedVertex);
+    header.meshCount = static_cast<uint32_t>(model.meshes.size());
+    header.textureCount = static_cast<uint32_t>(textureEntries.size());
+    header.stringBytes = static_cast<uint32_t>(strings.size());
+    header.vertexCount = model.vertexCount;
+    header.indexCount = model.indices.size();
+
+    header.meshesOffset = AlignUp(sizeof(Header), 16);
+    header.texturesOffset = AlignUp(header.meshesOffset + header.meshCount * sizeof(MeshRecord), 16);
+    header.stringsOffset = header.texturesOffset + header.textureCount * sizeof(TextureEntry);
+    uint64_t streamOffset = AlignUp(header.stringsOffset + header.stringBytes, 16);
+    for (uint32_t stream = 0; stream < VertexStreamCount; ++stream) {
+        header.vertexStreamOffsets[stream] = streamOffset;
+        streamOffset = AlignUp(streamOffset + header.vertexCount * PackedVertex::StreamStrides[stream], 16);
+    }
+    header.indicesOffset = streamOffset;
+    header.fileSize = header.indicesOffset + header.indexCount * sizeof(uint32_t);
+
+    if (header.sourceKey == 0) {
+        return false;
+    }
+
+    // Write next to the final file and swap it in, a crash mid-write must never leave a valid-looking cache behind
+    const std::filesystem::path cachePath = GetCachePath(sourcePath);
+    std::filesystem::path tempPath = cachePath;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open mesh cache for writing: " << std::filesystem::absolute(tempPath) << std::endl;
+            return false;
+        }
+
+        auto writeAt = [&file](uint64_t offset, const void *data, size_t size) {
+            static constexpr char zeros[16]{};
+            while (static_cast<uint64_t>(file.tellp()) < offset) {
+                file.write(zeros, static_cast<std::streamsize>(
+                               std::min<uint64_t>(sizeof(zeros), offset - static_cast<uint64_t>(file.tellp()))));
+            }
+            file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        };
+
+        writeAt(0, &header, sizeof(Header));
+        writeAt(header.meshesOffset, model.meshes.data(), model.meshes.size() * sizeof(MeshRecord));
+        writeAt(header.texturesOffset, textureEntries.data(), textureEntries.size() * sizeof(TextureEntry));
+        writeAt(header.stringsOffset, strings.data(), strings.size());
+        for (uint32_t stream = 0; stream < VertexStreamCount; ++stream) {
+            writeAt(header.vertexStreamOffsets[stream], model.vertexStreams[stream].data(),
+                    model.vertexStreams[stream].size_bytes());
+        }
+        writeAt(header.indicesOffset, model.indices.data(), model.indices.size_bytes());
+
+        if (!file) {
+            std::cerr << "Failed to write mesh cache: " << std::filesystem::absolute(tempPath) << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::cerr << "Failed to replace mesh cache: " << ec.message() << std::endl;
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+
+    return true;
+}
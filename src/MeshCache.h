@@ -0,0 +1,121 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "Structs/Mesh.h"
+
+// Read-only memory mapping of a whole file, unmapped on destruction.
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path &path);
+    virtual ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) noexcept = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+    [[nodiscard]] bool IsValid() const { return m_Data != nullptr; }
+    [[nodiscard]] const std::byte* GetData() const { return m_Data; }
+    [[nodiscard]] size_t GetSize() const { return m_Size; }
+
+private:
+    const std::byte* m_Data{};
+    size_t m_Size{};
+
+#ifdef _WIN32
+    void* m_File{};
+    void* m_Mapping{};
+#else
+    int m_FileDescriptor{ -1 };
+#endif
+};
+
+// What a material samples from a texture, decides the block format it is cooked into (see TextureCache)
+enum class TextureUsage : uint32_t {
+    Color = 0,         // diffuse and emissive, alpha is kept for the alpha test
+    Normal,            // tangent space normal, the shaders only read X and Y
+    MetallicRoughness, // glTF layout, roughness in G and metallic in B
+    Occlusion,         // red channel only
+};
+
+struct TextureRef {
+    std::string path; // relative to the model directory
+    vk::Format format{}; // uncompressed format the source decodes into
+    TextureUsage usage{};
+};
+
+// Everything needed to create the GPU resources of a model, without Assimp.
+// Vertex/index spans either point into the owned vectors (fresh import) or into the mapped cache file.
+// Vertices are split into one tightly packed span per VertexStream, uploaded as is into the GeometryPool streams.
+struct ModelData {
+    std::vector<MeshRecord> meshes{};
+    std::vector<TextureRef> textures{};
+
+    std::array<std::span<const std::byte>, VertexStreamCount> vertexStreams{};
+    uint32_t vertexCount{};
+    std::span<const uint32_t> indices{};
+
+    std::array<std::vector<std::byte>, VertexStreamCount> ownedVertexStreams{};
+    std::vector<uint32_t> ownedIndices{};
+    std::unique_ptr<MappedFile> mapping{};
+};
+
+class MeshCache {
+public:
+    static constexpr uint32_t Magic = 0x434D5256; // "VRMC"
+    static constexpr uint32_t Version = 6;
+
+    static std::filesystem::path GetCachePath(const std::filesystem::path &sourcePath);
+
+    // Hash of the source asset (plus the external buffers it references), the import flags and the vertex layout
+    static uint64_t ComputeSourceKey(const std::filesystem::path &sourcePath, uint32_t importFlags);
+
+    static std::optional<ModelData> Load(const std::filesystem::path &sourcePath, uint32_t importFlags);
+
+    static bool Write(const std::filesystem::path &sourcePath, uint32_t importFlags, const ModelData &model);
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceKey;
+        uint32_t vertexStride;
+        uint32_t meshCount;
+        uint32_t textureCount;
+        uint32_t stringBytes;
+        uint64_t vertexCount;
+        uint64_t indexCount;
+        uint64_t meshesOffset;
+        uint64_t texturesOffset;
+        uint64_t stringsOffset;
+        uint64_t vertexStreamOffsets[VertexStreamCount];
+        uint64_t indicesOffset;
+        uint64_t fileSize;
+    };
+
+    struct TextureEntry {
+        uint32_t format;
+        uint32_t usage;
+        uint32_t pathOffset;
+        uint32_t pathLength;
+    };
+};
+
+
+#endif //MESHCACHE_H
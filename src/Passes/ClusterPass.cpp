@@ -0,0 +1,76 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "ClusterPass.h"
+
+#include "DescriptorSets/DescriptorSets.h"
+#include "ResourceTracker.h"
+#include "Factories/ShaderFactory.h"
+
+ClusterPass::ClusterPass(const vk::raii::Device &Device,
+                         const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer)
+    : m_Device(Device)
+      , m_CommandBuffer(CommandBuffer)
+      , m_PipelineFactory(std::make_unique<PipelineFactory>(Device))
+      , m_Buffer(std::make_unique<Buffer>()) {
+}
+
+void ClusterPass::CreateBuffer(VmaAllocator Allocator, ResourceTracker *AllocationTracker) {
+    m_Allocator = Allocator;
+    m_AllocationTracker = AllocationTracker;
+
+    // One count per cluster, then every cluster's index list
+    const vk::DeviceSize size = sizeof(uint32_t) * ClusterCount * (1 + MaxLightsPerCluster);
+    m_Clusters = m_Buffer->CreateUnmapped(m_Allocator, size, vk::BufferUsageFlagBits::eStorageBuffer,
+                                          VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, m_AllocationTracker,
+                                          "ClusterLights");
+}
+
+void ClusterPass::CreatePipeline() {
+    vk::raii::ShaderModule clusterModule = ShaderFactory::Build_ComputeModule(m_Device, "shaders/clustercomp.spv");
+
+    vk::DebugUtilsObjectNameInfoEXT nameInfo{};
+    nameInfo.pObjectName = "CLUSTER";
+    nameInfo.objectType = vk::ObjectType::eShaderModule;
+    nameInfo.objectHandle = uint64_t(static_cast<VkShaderModule>(*clusterModule));
+    m_Device.setDebugUtilsObjectNameEXT(nameInfo);
+
+    vk::PipelineShaderStageCreateInfo computeStage{};
+    computeStage.setStage(vk::ShaderStageFlagBits::eCompute);
+    computeStage.setModule(clusterModule);
+    computeStage.setPName("main");
+
+    m_Pipeline = std::make_unique<vk::raii::Pipeline>(m_PipelineFactory
+        ->SetLayout(m_PipelineLayout)
+        .BuildCompute(computeStage));
+}
+
+void ClusterPass::DoPass(uint32_t CurrentFrame) {
+    using AF = vk::AccessFlagBits;
+    using PS = vk::PipelineStageFlagBits;
+
+    const vk::raii::CommandBuffer &cmd = *m_CommandBuffer[CurrentFrame];
+
+    // The lists are shared between frames, the lighting pass of the previous one may still be reading them
+    vk::MemoryBarrier readBarrier{};
+    readBarrier.srcAccessMask = AF::eShaderRead;
+    readBarrier.dstAccessMask = AF::eShaderWrite;
+    cmd.pipelineBarrier(PS::eFragmentShader, PS::eComputeShader, {}, readBarrier, nullptr, nullptr);
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, **m_Pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_PipelineLayout, 0, m_DescriptorSets->GetDescriptorSets(CurrentFrame), *m_DynamicOffsets);
+    cmd.dispatch(TilesX, TilesY, 1);
+
+    vk::MemoryBarrier writeBarrier{};
+    writeBarrier.srcAccessMask = AF::eShaderWrite;
+    writeBarrier.dstAccessMask = AF::eShaderRead;
+    cmd.pipelineBarrier(PS::eComputeShader, PS::eFragmentShader, {}, writeBarrier, nullptr, nullptr);
+}
+
+void ClusterPass::Destroy() {
+    if (m_Clusters.m_Buffer) {
+        Buffer::Destroy(m_Allocator, m_Clusters.m_Buffer, m_Clusters.m_Allocation, m_AllocationTracker);
+        m_Clusters = {};
+    }
+}
@@ -0,0 +1,73 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef CLUSTERPASS_H
+#define CLUSTERPASS_H
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.h>
+
+#include "Buffer.h"
+#include "Factories/PipelineFactory.h"
+
+class ResourceTracker;
+class DescriptorSets;
+
+// Assigns point lights to a froxel grid: screen tiles split into exponential depth slices between the camera planes.
+// One workgroup per tile reduces the tile's depth range from the depth buffer first, so only the slices that hold
+// geometry get a light list. Lists have a fixed capacity per cluster and live in one SSBO, counts first, which the
+// lighting shader reads through binding 6 of the global set. Runs with the shared pipeline layout.
+class ClusterPass {
+public:
+    // Match the CLUSTER_* defines in cluster.comp and shader.frag
+    static constexpr uint32_t TilesX = 16;
+    static constexpr uint32_t TilesY = 9;
+    static constexpr uint32_t Slices = 24;
+    static constexpr uint32_t MaxLightsPerCluster = 128;
+    static constexpr uint32_t ClusterCount = TilesX * TilesY * Slices;
+
+    ClusterPass(const vk::raii::Device &Device, const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer);
+    virtual ~ClusterPass() = default;
+
+    ClusterPass(const ClusterPass&) = delete;
+    ClusterPass(ClusterPass&&) noexcept = delete;
+    ClusterPass& operator=(const ClusterPass&) = delete;
+    ClusterPass& operator=(ClusterPass&&) noexcept = delete;
+
+    void CreateBuffer(VmaAllocator Allocator, ResourceTracker *AllocationTracker);
+
+    // Needs m_PipelineLayout
+    void CreatePipeline();
+
+    // The depth buffer has to be readable by compute already, the lists are readable by fragment shaders afterwards
+    void DoPass(uint32_t CurrentFrame);
+
+    [[nodiscard]] const BufferInfo &GetBuffer() const { return m_Clusters; }
+
+    void Destroy();
+
+    // Owned by DescriptorSets, the sets of the frame being recorded are bound
+    const DescriptorSets *m_DescriptorSets{};
+    // Owned by DescriptorSets, read at record time
+    const std::vector<uint32_t> *m_DynamicOffsets{};
+    vk::PipelineLayout m_PipelineLayout;
+
+private:
+    const vk::raii::Device &m_Device;
+    const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &m_CommandBuffer;
+
+    std::unique_ptr<PipelineFactory> m_PipelineFactory{};
+    std::unique_ptr<vk::raii::Pipeline> m_Pipeline{};
+
+    VmaAllocator m_Allocator{};
+    ResourceTracker *m_AllocationTracker{};
+    std::unique_ptr<Buffer> m_Buffer{};
+    BufferInfo m_Clusters{};
+};
+
+
+#endif //CLUSTERPASS_H
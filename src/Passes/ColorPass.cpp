@@ -7,20 +7,19 @@
 #include <iostream>
 #include <vulkan/vulkan.hpp>
 
+#include "DescriptorSets/DescriptorSets.h"
 #include "Factories/ShaderFactory.h"
-#include "Structs/Lights.h"
 
 ColorPass::ColorPass(const vk::raii::Device &Device, const vk::PipelineLayout &PipelineLayout,
                      const std::vector<std::unique_ptr<vk::raii::CommandBuffer> > &CommandBuffer,
-                     const std::pair<std::vector<DirectionalLight>, std::vector<PointLight> > &LightData,
-                     const std::pair<vk::Format, vk::Format> &ColorDepthFormat
+                     const std::pair<vk::Format, vk::Format> &ColorDepthFormat,
+                     const std::string &FragmentShader
 ) : m_Device(Device)
     , m_PipelineLayout(PipelineLayout)
     , m_CommandBuffer(CommandBuffer)
-    , m_LightData(LightData)
     , m_Format(ColorDepthFormat) {
     m_GraphicsPipelineFactory = std::make_unique<PipelineFactory>(Device);
-    CreateModules();
+    CreateModules(FragmentShader);
     CreateGraphicsPipeline();
 }
 
@@ -45,7 +44,7 @@ void ColorPass::DoPass(const std::vector<vk::raii::ImageView> &ImageView, int Cu
     m_CommandBuffer[CurrentFrame]->bindPipeline(vk::PipelineBindPoint::eGraphics, *m_GraphicsPipeline);
 
     m_CommandBuffer[CurrentFrame]->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_PipelineLayout, 0,
-                                                      m_DescriptorSets, {});
+                                                      m_DescriptorSets->GetDescriptorSets(CurrentFrame), *m_DynamicOffsets);
     m_CommandBuffer[CurrentFrame]->setViewport(0, viewport);
     m_CommandBuffer[CurrentFrame]->setScissor(0, scissor);
     m_CommandBuffer[CurrentFrame]->draw(3, 1, 0, 0);
@@ -93,31 +92,6 @@ void ColorPass::CreateGraphicsPipeline() {
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.vertexBindingDescriptionCount = 0;
 
-    struct LightSpecData {
-        uint32_t numPoint;
-        uint32_t numDir;
-    };
-    static_assert(sizeof(LightSpecData) == 8, "Unexpected padding");
-    static_assert(offsetof(LightSpecData, numPoint) == 0, "Offset mismatch");
-    static_assert(offsetof(LightSpecData, numDir) == 4, "Offset mismatch");
-
-    LightSpecData specData{
-        static_cast<uint32_t>(m_LightData.second.size()),
-        static_cast<uint32_t>(m_LightData.first.size())
-    };
-
-    std::array<vk::SpecializationMapEntry, 2> entries = {
-        vk::SpecializationMapEntry{2, offsetof(LightSpecData, numPoint), sizeof(uint32_t)},
-        vk::SpecializationMapEntry{3, offsetof(LightSpecData, numDir), sizeof(uint32_t)},
-    };
-
-    // Specialization info
-    vk::SpecializationInfo specializationInfo{};
-    specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
-    specializationInfo.pMapEntries = entries.data();
-    specializationInfo.dataSize = sizeof(LightSpecData);
-    specializationInfo.pData = &specData;
-
     // Shader stages
     vk::PipelineShaderStageCreateInfo vertexStageInfo{};
     vertexStageInfo.setStage(vk::ShaderStageFlagBits::eVertex);
@@ -128,7 +102,6 @@ void ColorPass::CreateGraphicsPipeline() {
     fragmentStageInfo.setStage(vk::ShaderStageFlagBits::eFragment);
     fragmentStageInfo.setModule(*m_ColorShaderModules[1]);
     fragmentStageInfo.setPName("main");
-    fragmentStageInfo.pSpecializationInfo = &specializationInfo;
 
     std::vector<vk::PipelineShaderStageCreateInfo> shaderStages = {vertexStageInfo, fragmentStageInfo};
 
@@ -160,9 +133,9 @@ void ColorPass::CreateGraphicsPipeline() {
         .Build());
 }
 
-void ColorPass::CreateModules() {
+void ColorPass::CreateModules(const std::string &FragmentShader) {
     auto ShaderModules = ShaderFactory::Build_ShaderModules(m_Device, "shaders/shadervert.spv",
-                                                            "shaders/shaderfrag.spv");
+                                                            FragmentShader.c_str());
     for (auto &shader: ShaderModules) {
         vk::DebugUtilsObjectNameInfoEXT nameInfo{};
         nameInfo.pObjectName = "color";
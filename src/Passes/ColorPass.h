@@ -4,12 +4,13 @@
 
 #ifndef COLORPASS_H
 #define COLORPASS_H
+#include <string>
+
 #include "Buffer.h"
 #include "Factories/PipelineFactory.h"
 #include "glm/glm.hpp"
 
-struct DirectionalLight;
-struct PointLight;
+class DescriptorSets;
 
 class ColorPass {
 
@@ -17,8 +18,8 @@ public:
 
 	ColorPass(const vk::raii::Device &Device, const vk::PipelineLayout &PipelineLayout,
 		  const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer,
-		  const std::pair<std::vector<DirectionalLight>, std::vector<PointLight>> &LightData,
-		  const std::pair<vk::Format, vk::Format> &ColorDepthFormat);
+		  const std::pair<vk::Format, vk::Format> &ColorDepthFormat,
+		  const std::string &FragmentShader = "shaders/shaderfrag.spv");
 
     virtual ~ColorPass() = default;
 
@@ -29,13 +30,16 @@ public:
 
 	void DoPass(const std::vector<vk::raii::ImageView> &ImageView, int CurrentFrame, glm::uint32_t imageIndex, int width, int height) const;
 
-    std::vector<vk::DescriptorSet> m_DescriptorSets;
+    // Owned by DescriptorSets, the sets of the frame being recorded are bound
+    const DescriptorSets *m_DescriptorSets{};
+    // Owned by DescriptorSets, read at record time
+    const std::vector<uint32_t> *m_DynamicOffsets{};
 
 	std::pair<vk::Format, vk::Format> m_Format{};
 
 private:
     void CreateGraphicsPipeline();
-	void CreateModules();
+	void CreateModules(const std::string &FragmentShader);
 
 	const vk::raii::Device& m_Device;
 	std::unique_ptr<vk::raii::Pipeline> m_GraphicsPipeline{};
@@ -45,8 +49,6 @@ private:
 
 	std::vector<vk::raii::ShaderModule> m_ColorShaderModules{};
 
-	std::pair<std::vector<DirectionalLight>, std::vector<PointLight>>  m_LightData{};
-
 
 
 
@@ -0,0 +1,114 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "ComputeLightingPass.h"
+
+#include "DescriptorSets/DescriptorSets.h"
+#include "ResourceTracker.h"
+#include "Factories/ShaderFactory.h"
+
+namespace {
+    // Matches local_size in lighting.comp
+    constexpr uint32_t LightingTileSize = 8;
+}
+
+ComputeLightingPass::ComputeLightingPass(const vk::raii::Device &Device,
+                                         const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer)
+    : m_Device(Device)
+      , m_CommandBuffer(CommandBuffer)
+      , m_PipelineFactory(std::make_unique<PipelineFactory>(Device)) {
+}
+
+void ComputeLightingPass::CreateImage(VmaAllocator Allocator, ResourceTracker *AllocationTracker, uint32_t width,
+                                      uint32_t height) {
+    m_Allocator = Allocator;
+    m_AllocationTracker = AllocationTracker;
+
+    vk::ImageCreateInfo imageInfo{};
+    imageInfo.imageType = vk::ImageType::e2D;
+    imageInfo.extent = vk::Extent3D{width, height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = Format;
+    imageInfo.tiling = vk::ImageTiling::eOptimal;
+    imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+    imageInfo.usage = vk::ImageUsageFlagBits::eStorage;
+    imageInfo.samples = vk::SampleCountFlagBits::e1;
+    imageInfo.sharingMode = vk::SharingMode::eExclusive;
+
+    ImageFactory::CreateImage(m_Device, m_Allocator, m_HDR, imageInfo, "HDRColor");
+    m_HDR.extent = vk::Extent2D{width, height};
+    m_HDR.imageAspectFlags = vk::ImageAspectFlagBits::eColor;
+    m_AllocationTracker->TrackAllocation(m_HDR.allocation, "HDRColor");
+
+    m_HDRView = ImageFactory::CreateImageView(m_Device, m_HDR.image, Format, vk::ImageAspectFlagBits::eColor,
+                                              m_AllocationTracker, "HDRColorView");
+}
+
+void ComputeLightingPass::RecreateImage(uint32_t width, uint32_t height) {
+    DestroyImage();
+    CreateImage(m_Allocator, m_AllocationTracker, width, height);
+}
+
+void ComputeLightingPass::DoPass(uint32_t CurrentFrame) {
+    using AF = vk::AccessFlagBits;
+    using PS = vk::PipelineStageFlagBits;
+
+    const vk::raii::CommandBuffer &cmd = *m_CommandBuffer[CurrentFrame];
+
+    // Lives in General, the tonemap pass of the previous frame may still be reading it
+    ImageFactory::ShiftImageLayout(*cmd,
+                                   m_HDR,
+                                   vk::ImageLayout::eGeneral,
+                                   AF::eShaderRead,
+                                   AF::eShaderWrite,
+                                   PS::eFragmentShader,
+                                   PS::eComputeShader);
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, **m_Pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_PipelineLayout, 0, m_DescriptorSets->GetDescriptorSets(CurrentFrame), *m_DynamicOffsets);
+    cmd.dispatch((m_HDR.extent.width + LightingTileSize - 1) / LightingTileSize,
+                 (m_HDR.extent.height + LightingTileSize - 1) / LightingTileSize, 1);
+
+    ImageFactory::ShiftImageLayout(*cmd,
+                                   m_HDR,
+                                   vk::ImageLayout::eGeneral,
+                                   AF::eShaderWrite,
+                                   AF::eShaderRead,
+                                   PS::eComputeShader,
+                                   PS::eFragmentShader);
+}
+
+void ComputeLightingPass::CreatePipeline() {
+    vk::raii::ShaderModule lightingModule = ShaderFactory::Build_ComputeModule(m_Device, "shaders/lightingcomp.spv");
+
+    vk::DebugUtilsObjectNameInfoEXT nameInfo{};
+    nameInfo.pObjectName = "COMPUTE LIGHTING";
+    nameInfo.objectType = vk::ObjectType::eShaderModule;
+    nameInfo.objectHandle = uint64_t(static_cast<VkShaderModule>(*lightingModule));
+    m_Device.setDebugUtilsObjectNameEXT(nameInfo);
+
+    vk::PipelineShaderStageCreateInfo computeStage{};
+    computeStage.setStage(vk::ShaderStageFlagBits::eCompute);
+    computeStage.setModule(lightingModule);
+    computeStage.setPName("main");
+
+    m_Pipeline = std::make_unique<vk::raii::Pipeline>(m_PipelineFactory
+        ->SetLayout(m_PipelineLayout)
+        .BuildCompute(computeStage));
+}
+
+void ComputeLightingPass::DestroyImage() {
+    if (m_HDRView) {
+        m_AllocationTracker->UntrackImageView(m_HDRView);
+        vkDestroyImageView(*m_Device, m_HDRView, nullptr);
+        m_HDRView = nullptr;
+    }
+
+    if (m_HDR.image) {
+        m_AllocationTracker->UntrackAllocation(m_HDR.allocation);
+        vmaDestroyImage(m_Allocator, m_HDR.image, m_HDR.allocation);
+        m_HDR = {};
+    }
+}
@@ -0,0 +1,73 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef COMPUTELIGHTINGPASS_H
+#define COMPUTELIGHTINGPASS_H
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.h>
+
+#include "Factories/ImageFactory.h"
+#include "Factories/PipelineFactory.h"
+
+class ResourceTracker;
+class DescriptorSets;
+
+// Alternative to the full screen ColorPass: lights the G-buffer in a compute shader, one workgroup per 8x8 tile with
+// the point lights touching the tile culled into shared memory first. Camera inverses come from the UBO instead of
+// being computed per pixel. The result is an RGBA16F storage image (binding 10 of the frame set), a ColorPass running
+// tonemap.frag presents it. Runs with the shared pipeline layout.
+class ComputeLightingPass {
+public:
+    static constexpr vk::Format Format = vk::Format::eR16G16B16A16Sfloat;
+
+    ComputeLightingPass(const vk::raii::Device &Device,
+                        const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer);
+    virtual ~ComputeLightingPass() = default;
+
+    ComputeLightingPass(const ComputeLightingPass&) = delete;
+    ComputeLightingPass(ComputeLightingPass&&) noexcept = delete;
+    ComputeLightingPass& operator=(const ComputeLightingPass&) = delete;
+    ComputeLightingPass& operator=(ComputeLightingPass&&) noexcept = delete;
+
+    void CreateImage(VmaAllocator Allocator, ResourceTracker *AllocationTracker, uint32_t width, uint32_t height);
+
+    void RecreateImage(uint32_t width, uint32_t height);
+
+    // Needs m_PipelineLayout
+    void CreatePipeline();
+
+    // The G-buffer, depth and shadow mask have to be readable by compute, the output is readable by fragment
+    // shaders afterwards
+    void DoPass(uint32_t CurrentFrame);
+
+    [[nodiscard]] vk::ImageView GetImageView() const { return m_HDRView; }
+
+    void DestroyImage();
+
+    // Owned by DescriptorSets, the sets of the frame being recorded are bound
+    const DescriptorSets *m_DescriptorSets{};
+    // Owned by DescriptorSets, read at record time
+    const std::vector<uint32_t> *m_DynamicOffsets{};
+    vk::PipelineLayout m_PipelineLayout;
+
+private:
+    const vk::raii::Device &m_Device;
+    const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &m_CommandBuffer;
+
+    std::unique_ptr<PipelineFactory> m_PipelineFactory{};
+    std::unique_ptr<vk::raii::Pipeline> m_Pipeline{};
+
+    ImageResource m_HDR{};
+    vk::ImageView m_HDRView{};
+
+    VmaAllocator m_Allocator{};
+    ResourceTracker *m_AllocationTracker{};
+};
+
+
+#endif //COMPUTELIGHTINGPASS_H
@@ -0,0 +1,289 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "CullPass.h"
+
+#include <algorithm>
+#include <array>
+
+#include "IndirectDrawBuffer.h"
+#include "ResourceTracker.h"
+#include "Factories/ShaderFactory.h"
+#include "Math/math.h"
+
+namespace {
+    constexpr uint32_t CullGroupSize = 64;
+}
+
+CullPass::CullPass(const vk::raii::Device &Device,
+                   const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer)
+    : m_Device(Device)
+      , m_CommandBuffer(CommandBuffer)
+      , m_PipelineFactory(std::make_unique<PipelineFactory>(Device))
+      , m_Buffer(std::make_unique<Buffer>()) {
+}
+
+void CullPass::CreateResources(const IndirectDrawBuffer &Draws, VmaAllocator Allocator,
+                               ResourceTracker *AllocationTracker, uint32_t FramesInFlight) {
+    m_Draws = &Draws;
+    m_Allocator = Allocator;
+    m_AllocationTracker = AllocationTracker;
+
+    if (Draws.GetDrawCount() == 0) {
+        return;
+    }
+
+    // 0 all commands, 1 bounds, 2 visible commands, 3 counts, 4 visibility, 5 depth pyramid, 6 uniforms
+    std::array<vk::DescriptorSetLayoutBinding, 7> bindings{};
+    for (uint32_t binding = 0; binding < bindings.size(); ++binding) {
+        bindings[binding].binding = binding;
+        bindings[binding].descriptorType = vk::DescriptorType::eStorageBuffer;
+        bindings[binding].descriptorCount = 1;
+        bindings[binding].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    }
+    bindings[5].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    bindings[6].descriptorType = vk::DescriptorType::eUniformBuffer;
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.setBindings(bindings);
+    m_DescriptorSetLayout = std::make_unique<vk::raii::DescriptorSetLayout>(m_Device, layoutInfo);
+
+    std::array<vk::DescriptorPoolSize, 3> poolSizes{
+        vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer, 5 * FramesInFlight},
+        vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, FramesInFlight},
+        vk::DescriptorPoolSize{vk::DescriptorType::eUniformBuffer, FramesInFlight}
+    };
+
+    vk::DescriptorPoolCreateInfo poolInfo{};
+    poolInfo.maxSets = FramesInFlight;
+    poolInfo.setPoolSizes(poolSizes);
+    m_DescriptorPool = std::make_unique<vk::raii::DescriptorPool>(m_Device, poolInfo);
+
+    std::vector<vk::DescriptorSetLayout> setLayouts(FramesInFlight, **m_DescriptorSetLayout);
+
+    vk::DescriptorSetAllocateInfo allocInfo{};
+    allocInfo.descriptorPool = **m_DescriptorPool;
+    allocInfo.setSetLayouts(setLayouts);
+
+    auto dev = *m_Device;
+    m_DescriptorSets = dev.allocateDescriptorSets(allocInfo);
+
+    for (uint32_t frame = 0; frame < FramesInFlight; ++frame) {
+        m_Uniforms.push_back(m_Buffer->CreateMapped(m_Allocator, sizeof(CullUniforms),
+                                                    vk::BufferUsageFlagBits::eUniformBuffer,
+                                                    VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                                    VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+                                                    m_AllocationTracker, "CullUniforms"));
+
+        std::array<vk::DescriptorBufferInfo, 5> bufferInfos{
+            vk::DescriptorBufferInfo{Draws.GetCommands().m_Buffer, 0, VK_WHOLE_SIZE},
+            vk::DescriptorBufferInfo{Draws.GetBounds().m_Buffer, 0, VK_WHOLE_SIZE},
+            vk::DescriptorBufferInfo{Draws.GetVisibleCommands(frame).m_Buffer, 0, VK_WHOLE_SIZE},
+            vk::DescriptorBufferInfo{Draws.GetVisibleCount(frame).m_Buffer, 0, VK_WHOLE_SIZE},
+            vk::DescriptorBufferInfo{Draws.GetVisibility().m_Buffer, 0, VK_WHOLE_SIZE}
+        };
+        vk::DescriptorBufferInfo uniformInfo{m_Uniforms[frame].m_Buffer, 0, sizeof(CullUniforms)};
+
+        std::vector<vk::WriteDescriptorSet> writes;
+        for (uint32_t binding = 0; binding < bufferInfos.size(); ++binding) {
+            vk::WriteDescriptorSet write{};
+            write.dstSet = m_DescriptorSets[frame];
+            write.dstBinding = binding;
+            write.dstArrayElement = 0;
+            write.descriptorCount = 1;
+            write.descriptorType = vk::DescriptorType::eStorageBuffer;
+            write.pBufferInfo = &bufferInfos[binding];
+            writes.push_back(write);
+        }
+
+        vk::WriteDescriptorSet uniformWrite{};
+        uniformWrite.dstSet = m_DescriptorSets[frame];
+        uniformWrite.dstBinding = 6;
+        uniformWrite.dstArrayElement = 0;
+        uniformWrite.descriptorCount = 1;
+        uniformWrite.descriptorType = vk::DescriptorType::eUniformBuffer;
+        uniformWrite.pBufferInfo = &uniformInfo;
+        writes.push_back(uniformWrite);
+
+        m_Device.updateDescriptorSets(writes, {});
+
+        m_StatsReadback.push_back(m_Buffer->CreateUnmapped(m_Allocator,
+                                                           IndirectDrawBuffer::CountSlotCount * sizeof(uint32_t),
+                                                           vk::BufferUsageFlagBits::eTransferDst,
+                                                           VMA_MEMORY_USAGE_AUTO,
+                                                           VMA_ALLOCATION_CREATE_MAPPED_BIT |
+                                                           VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT,
+                                                           m_AllocationTracker, "CullStatsReadback"));
+        m_bStatsPending.push_back(false);
+    }
+
+    CreatePipeline();
+}
+
+void CullPass::SetDepthPyramid(vk::ImageView PyramidView, vk::Sampler ReductionSampler, vk::Extent2D PyramidExtent) {
+    m_PyramidExtent = PyramidExtent;
+
+    vk::DescriptorImageInfo pyramidInfo{};
+    pyramidInfo.sampler = ReductionSampler;
+    pyramidInfo.imageView = PyramidView;
+    pyramidInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+    std::vector<vk::WriteDescriptorSet> writes;
+    for (vk::DescriptorSet set: m_DescriptorSets) {
+        vk::WriteDescriptorSet write{};
+        write.dstSet = set;
+        write.dstBinding = 5;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        write.pImageInfo = &pyramidInfo;
+        writes.push_back(write);
+    }
+
+    m_Device.updateDescriptorSets(writes, {});
+}
+
+void CullPass::DoPass(uint32_t CurrentFrame, const glm::mat4 &Clip) {
+    if (m_Draws->GetDrawCount() == 0) {
+        return;
+    }
+
+    ReadStats(CurrentFrame);
+
+    const vk::raii::CommandBuffer &cmd = *m_CommandBuffer[CurrentFrame];
+
+    CullUniforms uniforms{};
+    uniforms.clip = Clip;
+    const auto planes = VulkanMath::ExtractFrustumPlanes(Clip);
+    std::copy(planes.begin(), planes.end(), uniforms.planes);
+    uniforms.pyramidSize = glm::vec2(m_PyramidExtent.width, m_PyramidExtent.height);
+    uniforms.drawCount = m_Draws->GetDrawCount();
+    Buffer::UploadData(m_Uniforms[CurrentFrame], &uniforms, sizeof(uniforms));
+
+    cmd.fillBuffer(m_Draws->GetVisibleCount(CurrentFrame).m_Buffer, 0, VK_WHOLE_SIZE, 0);
+
+    // Also orders against the visibility flags the previous frame's late phase wrote
+    vk::MemoryBarrier clearBarrier{};
+    clearBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite | vk::AccessFlagBits::eShaderWrite;
+    clearBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eComputeShader, {}, clearBarrier, nullptr, nullptr);
+
+    Dispatch(cmd, CurrentFrame, 0);
+
+    // The early list feeds the first depth draws, the late phase keeps appending to the counts
+    vk::MemoryBarrier cullBarrier{};
+    cullBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    cullBarrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead |
+                                vk::AccessFlagBits::eShaderWrite;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader, {},
+                        cullBarrier, nullptr, nullptr);
+}
+
+void CullPass::DoLatePass(uint32_t CurrentFrame) {
+    if (m_Draws->GetDrawCount() == 0) {
+        return;
+    }
+
+    const vk::raii::CommandBuffer &cmd = *m_CommandBuffer[CurrentFrame];
+    const vk::Buffer visibleCount = m_Draws->GetVisibleCount(CurrentFrame).m_Buffer;
+
+    Dispatch(cmd, CurrentFrame, 1);
+
+    // The late list feeds the second depth draws and the G-buffer, the counts are also copied out for the stats
+    vk::MemoryBarrier cullBarrier{};
+    cullBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+    cullBarrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eTransferRead;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eTransfer, {},
+                        cullBarrier, nullptr, nullptr);
+
+    vk::BufferCopy region{0, 0, IndirectDrawBuffer::CountSlotCount * sizeof(uint32_t)};
+    cmd.copyBuffer(visibleCount, m_StatsReadback[CurrentFrame].m_Buffer, region);
+
+    vk::MemoryBarrier readbackBarrier{};
+    readbackBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    readbackBarrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {},
+                        readbackBarrier, nullptr, nullptr);
+
+    m_bStatsPending[CurrentFrame] = true;
+}
+
+void CullPass::Dispatch(const vk::raii::CommandBuffer &cmd, uint32_t CurrentFrame, uint32_t Phase) {
+    PushConstants constants{};
+    constants.phase = Phase;
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, **m_Pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, **m_PipelineLayout, 0, m_DescriptorSets[CurrentFrame], {});
+    cmd.pushConstants(**m_PipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+                      vk::ArrayProxy<const PushConstants>{constants});
+    cmd.dispatch((m_Draws->GetDrawCount() + CullGroupSize - 1) / CullGroupSize, 1, 1);
+}
+
+void CullPass::ReadStats(uint32_t CurrentFrame) {
+    // The frame fence of this slot was already waited on, so the copy recorded last time has landed
+    if (!m_bStatsPending[CurrentFrame]) {
+        return;
+    }
+
+    const BufferInfo &readback = m_StatsReadback[CurrentFrame];
+    vmaInvalidateAllocation(m_Allocator, readback.m_Allocation, 0, VK_WHOLE_SIZE);
+
+    std::array<uint32_t, IndirectDrawBuffer::CountSlotCount> counts{};
+    std::memcpy(counts.data(), readback.m_MappedData, sizeof(counts));
+
+    m_Stats.alphaTested = counts[IndirectDrawBuffer::EarlyAlphaTested] + counts[IndirectDrawBuffer::LateAlphaTested];
+    m_Stats.drawn = counts[IndirectDrawBuffer::EarlyDraws] + counts[IndirectDrawBuffer::LateDraws] +
+                    m_Stats.alphaTested;
+    m_Stats.inFrustum = counts[IndirectDrawBuffer::InFrustum];
+    m_Stats.culled = m_Draws->GetDrawCount() - counts[IndirectDrawBuffer::InFrustum];
+    m_Stats.occluded = counts[IndirectDrawBuffer::Occluded];
+    m_bStatsPending[CurrentFrame] = false;
+}
+
+void CullPass::CreatePipeline() {
+    vk::PushConstantRange pushConstantRange{};
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    vk::DescriptorSetLayout setLayout = **m_DescriptorSetLayout;
+
+    vk::PipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.setSetLayouts(setLayout);
+    layoutInfo.setPushConstantRanges(pushConstantRange);
+    m_PipelineLayout = std::make_unique<vk::raii::PipelineLayout>(m_Device, layoutInfo);
+
+    vk::raii::ShaderModule cullModule = ShaderFactory::Build_ComputeModule(m_Device, "shaders/cullcomp.spv");
+
+    vk::DebugUtilsObjectNameInfoEXT nameInfo{};
+    nameInfo.pObjectName = "CULL";
+    nameInfo.objectType = vk::ObjectType::eShaderModule;
+    nameInfo.objectHandle = uint64_t(static_cast<VkShaderModule>(*cullModule));
+    m_Device.setDebugUtilsObjectNameEXT(nameInfo);
+
+    vk::PipelineShaderStageCreateInfo computeStage{};
+    computeStage.setStage(vk::ShaderStageFlagBits::eCompute);
+    computeStage.setModule(cullModule);
+    computeStage.setPName("main");
+
+    m_Pipeline = std::make_unique<vk::raii::Pipeline>(m_PipelineFactory
+        ->SetLayout(**m_PipelineLayout)
+        .BuildCompute(computeStage));
+}
+
+void CullPass::Destroy() {
+    for (const BufferInfo &uniforms: m_Uniforms) {
+        Buffer::Destroy(m_Allocator, uniforms.m_Buffer, uniforms.m_Allocation, m_AllocationTracker);
+    }
+    m_Uniforms.clear();
+
+    for (const BufferInfo &readback: m_StatsReadback) {
+        Buffer::Destroy(m_Allocator, readback.m_Buffer, readback.m_Allocation, m_AllocationTracker);
+    }
+    m_StatsReadback.clear();
+    m_bStatsPending.clear();
+}
@@ -0,0 +1,107 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef CULLPASS_H
+#define CULLPASS_H
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.h>
+#include <glm/glm.hpp>
+
+#include "Buffer.h"
+#include "Factories/PipelineFactory.h"
+
+class IndirectDrawBuffer;
+class ResourceTracker;
+
+// Frustum and occlusion culls every draw of the IndirectDrawBuffer on the GPU in two phases. The early phase keeps
+// what passed the occlusion test last frame, those draws lay down depth and the HiZPass builds its pyramid from it.
+// The late phase tests every draw in the frustum against that pyramid and appends the newly revealed ones.
+// Both compacted lists are consumed with drawIndexedIndirectCount.
+class CullPass {
+public:
+    struct Stats {
+        uint32_t drawn{};
+        uint32_t culled{};
+        uint32_t occluded{};
+        uint32_t inFrustum{};
+        uint32_t alphaTested{}; // part of drawn
+    };
+
+    CullPass(const vk::raii::Device &Device, const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer);
+    virtual ~CullPass() = default;
+
+    CullPass(const CullPass&) = delete;
+    CullPass(CullPass&&) noexcept = delete;
+    CullPass& operator=(const CullPass&) = delete;
+    CullPass& operator=(CullPass&&) noexcept = delete;
+
+    void CreateResources(const IndirectDrawBuffer &Draws, VmaAllocator Allocator, ResourceTracker *AllocationTracker,
+                         uint32_t FramesInFlight);
+
+    // Has to be set before the first frame and again whenever the pyramid is recreated
+    void SetDepthPyramid(vk::ImageView PyramidView, vk::Sampler ReductionSampler, vk::Extent2D PyramidExtent);
+
+    // Early phase. Clip is the full proj * view * model of the camera, culling happens in object space
+    void DoPass(uint32_t CurrentFrame, const glm::mat4 &Clip);
+
+    // Late phase, after the HiZPass built the pyramid from the early draws
+    void DoLatePass(uint32_t CurrentFrame);
+
+    // Counts of the last frame that finished on the GPU
+    [[nodiscard]] const Stats &GetStats() const { return m_Stats; }
+
+    void Destroy();
+
+private:
+    // std140, matches CullUniforms in cull.comp
+    struct CullUniforms {
+        glm::mat4 clip;
+        glm::vec4 planes[6];
+        glm::vec2 pyramidSize;
+        uint32_t drawCount;
+        uint32_t padding;
+    };
+
+    struct PushConstants {
+        uint32_t phase;
+    };
+
+    void Dispatch(const vk::raii::CommandBuffer &cmd, uint32_t CurrentFrame, uint32_t Phase);
+
+    void CreatePipeline();
+
+    void ReadStats(uint32_t CurrentFrame);
+
+    const vk::raii::Device &m_Device;
+    const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &m_CommandBuffer;
+
+    const IndirectDrawBuffer *m_Draws{};
+
+    std::unique_ptr<PipelineFactory> m_PipelineFactory{};
+    std::unique_ptr<vk::raii::DescriptorSetLayout> m_DescriptorSetLayout{};
+    std::unique_ptr<vk::raii::DescriptorPool> m_DescriptorPool{};
+    std::unique_ptr<vk::raii::PipelineLayout> m_PipelineLayout{};
+    std::unique_ptr<vk::raii::Pipeline> m_Pipeline{};
+    std::vector<vk::DescriptorSet> m_DescriptorSets{};
+
+    VmaAllocator m_Allocator{};
+    ResourceTracker *m_AllocationTracker{};
+    std::unique_ptr<Buffer> m_Buffer{};
+
+    std::vector<BufferInfo> m_Uniforms{};
+    vk::Extent2D m_PyramidExtent{};
+
+    // Host visible copies of the counts, read back once the frame slot comes around again
+    std::vector<BufferInfo> m_StatsReadback{};
+    std::vector<bool> m_bStatsPending{};
+    Stats m_Stats{};
+};
+
+
+
+#endif //CULLPASS_H
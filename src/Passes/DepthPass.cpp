@@ -4,6 +4,9 @@
 
 #include "DepthPass.h"
 
+#include "DescriptorSets/DescriptorSets.h"
+#include "GeometryPool.h"
+#include "IndirectDrawBuffer.h"
 #include "Factories/ImageFactory.h"
 #include "Factories/ShaderFactory.h"
 
@@ -43,7 +46,7 @@ void DepthPass::ShiftLayout(const vk::raii::CommandBuffer &command_buffer) {
 );
 }
 
-void DepthPass::DoPass(uint32_t CurrentFrame, uint32_t width, uint32_t height) {
+void DepthPass::DoPass(uint32_t CurrentFrame, uint32_t width, uint32_t height, bool bLateDraws) {
 
 
     vk::Viewport viewport{0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f};
@@ -60,7 +63,7 @@ void DepthPass::DoPass(uint32_t CurrentFrame, uint32_t width, uint32_t height) {
     vk::RenderingAttachmentInfo depthOnlyAttachment{};
     depthOnlyAttachment.setImageView(m_DepthImageView);
     depthOnlyAttachment.setImageLayout(vk::ImageLayout::eDepthAttachmentOptimal);
-    depthOnlyAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
+    depthOnlyAttachment.setLoadOp(bLateDraws ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear);
     depthOnlyAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
     depthOnlyAttachment.setClearValue(vk::ClearValue().setDepthStencil({1.0f, 0}));
 
@@ -72,16 +75,24 @@ void DepthPass::DoPass(uint32_t CurrentFrame, uint32_t width, uint32_t height) {
 
 
     m_CommandBuffer[CurrentFrame]->beginRendering(renderInfo);
-    m_CommandBuffer[CurrentFrame]->bindPipeline(vk::PipelineBindPoint::eGraphics, **m_DepthPrepassPipeline);
-    m_CommandBuffer[CurrentFrame]->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_PipelineLayout, 0, m_DescriptorSets, {});
+    m_CommandBuffer[CurrentFrame]->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_PipelineLayout, 0, m_DescriptorSets->GetDescriptorSets(CurrentFrame), *m_DynamicOffsets);
     m_CommandBuffer[CurrentFrame]->setViewport(0, viewport);
     m_CommandBuffer[CurrentFrame]->setScissor(0, scissor);
 
-    for (const auto& mesh : m_Meshes) {
-         m_CommandBuffer[CurrentFrame]->bindVertexBuffers(0, {mesh.m_VertexBufferInfo.m_Buffer}, mesh.m_VertexOffset);
-         m_CommandBuffer[CurrentFrame]->bindIndexBuffer(mesh.m_IndexBufferInfo.m_Buffer, 0, vk::IndexType::eUint32);
-         m_CommandBuffer[CurrentFrame]->pushConstants(m_PipelineLayout, vk::ShaderStageFlagBits::eFragment, 0, vk::ArrayProxy<const Material>{mesh.m_Material});
-         m_CommandBuffer[CurrentFrame]->drawIndexed(mesh.m_IndexCount, 1, 0, 0, 0);
+    m_GeometryPool->Bind(**m_CommandBuffer[CurrentFrame], TexCoordStream + 1);
+
+    // Opaque first, they fill most of the depth before the alpha tested draws lose early-Z
+    const std::array<std::pair<vk::Pipeline, IndirectDrawBuffer::DrawBucket>, IndirectDrawBuffer::DrawBucketCount> buckets{{
+        {**m_OpaqueDepthPipeline, IndirectDrawBuffer::Opaque},
+        {**m_DepthPrepassPipeline, IndirectDrawBuffer::AlphaTested}
+    }};
+    for (const auto &[pipeline, bucket] : buckets) {
+        m_CommandBuffer[CurrentFrame]->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+        if (bLateDraws) {
+            m_DrawBuffer->DrawVisibleLate(**m_CommandBuffer[CurrentFrame], CurrentFrame, bucket);
+        } else {
+            m_DrawBuffer->DrawVisible(**m_CommandBuffer[CurrentFrame], CurrentFrame, bucket);
+        }
     }
 
     m_CommandBuffer[CurrentFrame]->endRendering();
@@ -115,12 +126,6 @@ void DepthPass::CreatePipeline(uint32_t ImageResourceSize, const std::pair<vk::F
 	specializationInfo.dataSize = sizeof(textureCount);
 	specializationInfo.pData = &textureCount;
 
-    vk::PipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.colorWriteMask =
-		vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-		vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-
     // Multisampling
     vk::PipelineMultisampleStateCreateInfo multisampling{};
     multisampling.sampleShadingEnable = VK_FALSE;
@@ -141,12 +146,13 @@ void DepthPass::CreatePipeline(uint32_t ImageResourceSize, const std::pair<vk::F
     inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    vk::VertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    // Positions plus the texture coordinates for the alpha test
+    auto bindingDescriptions = PackedVertex::getBindingDescriptions(TexCoordStream + 1);
+    auto attributeDescriptions = PackedVertex::getAttributeDescriptions(TexCoordStream + 1);
 
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
@@ -169,26 +175,46 @@ void DepthPass::CreatePipeline(uint32_t ImageResourceSize, const std::pair<vk::F
     viewportState.scissorCount = 1;
     viewportState.pScissors = nullptr;
 
-    vk::Format ColorFormat = std::get<0>(ColorAndDepthFormat);
     vk::Format DepthFormat = std::get<1>(ColorAndDepthFormat);
 
 	m_Format = ColorAndDepthFormat;
 
+    // Depth only rendering, both pipelines are built without color attachments to match it
     m_DepthPrepassPipeline = std::make_unique<vk::raii::Pipeline>(m_DepthPipelineFactory
         ->SetShaderStages(shaderStages)
         .SetVertexInput(vertexInputInfo)
         .SetInputAssembly(inputAssembly)
         .SetRasterizer(rasterizer)
         .SetMultisampling(multisampling)
-        .SetColorBlendAttachments({colorBlendAttachment})
+        .SetColorBlendAttachments({})
         .SetViewportState(viewportState)
         .SetDynamicStates({ vk::DynamicState::eScissor, vk::DynamicState::eViewport })
         .SetDepthStencil(depthStencil)
         .SetLayout(m_PipelineLayout)
-        .SetColorFormats({ColorFormat})
+        .SetColorFormats({})
         .SetDepthFormat(DepthFormat)
         .Build());
 
+	// Opaque bucket: positions only and no fragment stage, nothing can discard so early-Z always holds
+	auto opaqueBindingDescriptions = PackedVertex::getBindingDescriptions(PositionStream + 1);
+	auto opaqueAttributeDescriptions = PackedVertex::getAttributeDescriptions(PositionStream + 1);
+
+	vk::PipelineVertexInputStateCreateInfo opaqueVertexInputInfo{};
+	opaqueVertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(opaqueBindingDescriptions.size());
+	opaqueVertexInputInfo.pVertexBindingDescriptions = opaqueBindingDescriptions.data();
+	opaqueVertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(opaqueAttributeDescriptions.size());
+	opaqueVertexInputInfo.pVertexAttributeDescriptions = opaqueAttributeDescriptions.data();
+
+	vk::PipelineShaderStageCreateInfo opaqueVertexStageInfo{};
+	opaqueVertexStageInfo.setStage(vk::ShaderStageFlagBits::eVertex);
+	opaqueVertexStageInfo.setModule(**m_OpaqueVertexModule);
+	opaqueVertexStageInfo.setPName("main");
+
+    m_OpaqueDepthPipeline = std::make_unique<vk::raii::Pipeline>(m_DepthPipelineFactory
+        ->SetShaderStages({opaqueVertexStageInfo})
+        .SetVertexInput(opaqueVertexInputInfo)
+        .Build());
+
 }
 
 void DepthPass::CreateImage(VmaAllocator Allocator, ResourceTracker* AllocationTracker,const vk::Format& DepthFormat, uint32_t width, uint32_t height) {
@@ -255,4 +281,14 @@ void DepthPass::CreateModules() {
 
         m_DepthShaderModules.emplace_back(std::move(shader));
     }
+
+    m_OpaqueVertexModule = std::make_unique<vk::raii::ShaderModule>(
+        ShaderFactory::Build_VertexModule(m_Device, "shaders/depthopaquevert.spv"));
+
+    vk::DebugUtilsObjectNameInfoEXT nameInfo{};
+    nameInfo.pObjectName = "depth opaque";
+    nameInfo.objectType = vk::ObjectType::eShaderModule;
+    nameInfo.objectHandle = uint64_t(static_cast<VkShaderModule>(**m_OpaqueVertexModule));
+
+    m_Device.setDebugUtilsObjectNameEXT(nameInfo);
 }
@@ -12,6 +12,10 @@
 #include "Factories/MeshFactory.h"
 #include "Factories/PipelineFactory.h"
 
+class GeometryPool;
+class IndirectDrawBuffer;
+class DescriptorSets;
+
 class DepthPass {
 public:
     DepthPass(const vk::raii::Device& Device, std::vector<std::unique_ptr<vk::raii::CommandBuffer>>& CommandBuffer);
@@ -28,9 +32,12 @@ public:
     DepthPass& operator=(const DepthPass&) = delete;
     DepthPass& operator=(DepthPass&&) noexcept = delete;
 
-    void DoPass(uint32_t CurrentFrame, uint32_t width, uint32_t height);
+    // The late draws load the depth of the early ones and only add what the Hi-Z test revealed.
+    // Opaque draws go through a pipeline without fragment shader, only the alpha tested ones sample and discard
+    void DoPass(uint32_t CurrentFrame, uint32_t width, uint32_t height, bool bLateDraws = false);
 
-    void SetMeshes(const std::vector<Mesh>& Meshes) { m_Meshes = Meshes; };
+    void SetDrawBuffer(const IndirectDrawBuffer *Draws) { m_DrawBuffer = Draws; };
+    void SetGeometryPool(const GeometryPool *Pool) { m_GeometryPool = Pool; };
 
     void CreatePipeline(uint32_t ImageResourceSize, const std::pair<vk::Format, vk::Format> &ColorAndDepthFormat);
 
@@ -41,7 +48,10 @@ public:
 	                   height);
 
 	void DestroyImages(VmaAllocator Allocator);
-	std::vector<vk::DescriptorSet> m_DescriptorSets;
+	// Owned by DescriptorSets, the sets of the frame being recorded are bound
+	const DescriptorSets *m_DescriptorSets{};
+	// Owned by DescriptorSets, read at record time
+	const std::vector<uint32_t> *m_DynamicOffsets{};
 	vk::PipelineLayout m_PipelineLayout;
 
 	ImageResource& GetImage() { return m_DepthImage; };
@@ -59,8 +69,11 @@ private:
 	std::vector<vk::raii::ShaderModule> m_DepthShaderModules{};
 
 	std::unique_ptr<vk::raii::Pipeline> m_DepthPrepassPipeline{};
+	std::unique_ptr<vk::raii::ShaderModule> m_OpaqueVertexModule{};
+	std::unique_ptr<vk::raii::Pipeline> m_OpaqueDepthPipeline{};
 
-	std::vector<Mesh> m_Meshes;
+	const IndirectDrawBuffer *m_DrawBuffer{};
+	const GeometryPool *m_GeometryPool{};
 
 	ImageResource m_DepthImage;
 	vk::ImageView m_DepthImageView;
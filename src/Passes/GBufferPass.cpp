@@ -7,6 +7,9 @@
 #include <deque>
 #include <functional>
 
+#include "DescriptorSets/DescriptorSets.h"
+#include "GeometryPool.h"
+#include "IndirectDrawBuffer.h"
 #include "Factories/ImageFactory.h"
 #include "Factories/PipelineFactory.h"
 #include "Factories/ShaderFactory.h"
@@ -26,7 +29,8 @@ void GBufferPass::PrepareImagesForRead(uint32_t CurrentFrame) {
                                    vk::AccessFlagBits::eColorAttachmentWrite,
                                    vk::AccessFlagBits::eShaderRead,
                                    vk::PipelineStageFlagBits::eColorAttachmentOutput,
-                                   vk::PipelineStageFlagBits::eFragmentShader);
+                                   vk::PipelineStageFlagBits::eFragmentShader |
+                                   vk::PipelineStageFlagBits::eComputeShader);
 
     ImageFactory::ShiftImageLayout(*m_CommandBuffer[CurrentFrame],
                                    m_GBufferNormals,
@@ -34,16 +38,9 @@ void GBufferPass::PrepareImagesForRead(uint32_t CurrentFrame) {
                                    vk::AccessFlagBits::eColorAttachmentWrite,
                                    vk::AccessFlagBits::eShaderRead,
                                    vk::PipelineStageFlagBits::eColorAttachmentOutput,
-                                   vk::PipelineStageFlagBits::eFragmentShader);
+                                   vk::PipelineStageFlagBits::eFragmentShader |
+                                   vk::PipelineStageFlagBits::eComputeShader);
 
-
-    ImageFactory::ShiftImageLayout(*m_CommandBuffer[CurrentFrame],
-                                   m_GBufferMaterial,
-                                   vk::ImageLayout::eShaderReadOnlyOptimal,
-                                   vk::AccessFlagBits::eColorAttachmentWrite,
-                                   vk::AccessFlagBits::eShaderRead,
-                                   vk::PipelineStageFlagBits::eColorAttachmentOutput,
-                                   vk::PipelineStageFlagBits::eFragmentShader);
 }
 
 
@@ -70,16 +67,6 @@ void GBufferPass::WindowResizeShiftLayout(const vk::raii::CommandBuffer &command
         PS::eTopOfPipe,
         PS::eColorAttachmentOutput
     );
-
-    ImageFactory::ShiftImageLayout(
-        *command_buffer,
-        m_GBufferMaterial,
-        vk::ImageLayout::eColorAttachmentOptimal,
-        AF::eNone,
-        AF::eColorAttachmentWrite,
-        PS::eTopOfPipe,
-        PS::eColorAttachmentOutput
-    );
 }
 
 
@@ -113,16 +100,6 @@ void GBufferPass::ShiftLayout(const vk::raii::CommandBuffer &command_buffer) {
         vk::PipelineStageFlagBits::eTopOfPipe,
         vk::PipelineStageFlagBits::eColorAttachmentOutput
     );
-
-    ImageFactory::ShiftImageLayout(
-        command_buffer,
-        m_GBufferMaterial,
-        vk::ImageLayout::eColorAttachmentOptimal,
-        vk::AccessFlagBits::eNone,
-        vk::AccessFlagBits::eColorAttachmentWrite,
-        vk::PipelineStageFlagBits::eTopOfPipe,
-        vk::PipelineStageFlagBits::eColorAttachmentOutput
-    );
 }
 
 
@@ -134,14 +111,14 @@ void GBufferPass::CreateGBuffer(VmaAllocator Allocator,
         1
     };
 
-    // Diffuse
+    // Albedo, metallic in alpha
     {
         vk::ImageCreateInfo imageInfo{};
         imageInfo.imageType = vk::ImageType::e2D;
         imageInfo.extent = extent;
         imageInfo.mipLevels = 1;
         imageInfo.arrayLayers = 1;
-        imageInfo.format = vk::Format::eR8G8B8A8Srgb;
+        imageInfo.format = DiffuseFormat;
         imageInfo.tiling = vk::ImageTiling::eOptimal;
         imageInfo.initialLayout = vk::ImageLayout::eUndefined;
         imageInfo.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
@@ -153,14 +130,14 @@ void GBufferPass::CreateGBuffer(VmaAllocator Allocator,
 
     }
 
-    // Normals
+    // Octahedral normal at 12 bits per axis in RGB, roughness in alpha
     {
         vk::ImageCreateInfo imageInfo{};
         imageInfo.imageType = vk::ImageType::e2D;
         imageInfo.extent = extent;
         imageInfo.mipLevels = 1;
         imageInfo.arrayLayers = 1;
-        imageInfo.format = vk::Format::eR8G8B8A8Unorm;
+        imageInfo.format = NormalsFormat;
         imageInfo.tiling = vk::ImageTiling::eOptimal;
         imageInfo.initialLayout = vk::ImageLayout::eUndefined;
         imageInfo.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
@@ -171,68 +148,42 @@ void GBufferPass::CreateGBuffer(VmaAllocator Allocator,
 
     }
 
-    // Material (Roughness + Metalness)
-    {
-        vk::ImageCreateInfo imageInfo{};
-        imageInfo.imageType = vk::ImageType::e2D;
-        imageInfo.extent = extent;
-        imageInfo.mipLevels = 1;
-        imageInfo.arrayLayers = 1;
-        imageInfo.format = vk::Format::eR8G8B8A8Unorm;
-        imageInfo.tiling = vk::ImageTiling::eOptimal;
-        imageInfo.initialLayout = vk::ImageLayout::eUndefined;
-        imageInfo.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled;
-        imageInfo.samples = vk::SampleCountFlagBits::e1;
-        imageInfo.sharingMode = vk::SharingMode::eExclusive;
-
-        ImageFactory::CreateImage(m_Device,Allocator, m_GBufferMaterial, imageInfo,"GBuffer.Material");
-
-    }
-
-    m_GBufferDiffuseView = ImageFactory::CreateImageView(m_Device, m_GBufferDiffuse.image, vk::Format::eR8G8B8A8Srgb,
+    m_GBufferDiffuseView = ImageFactory::CreateImageView(m_Device, m_GBufferDiffuse.image, DiffuseFormat,
                                                          vk::ImageAspectFlagBits::eColor, AllocationTracker,
                                                          "GBufferDiffuseView");
-    m_GBufferNormalsView = ImageFactory::CreateImageView(m_Device, m_GBufferNormals.image, vk::Format::eR8G8B8A8Unorm,
+    m_GBufferNormalsView = ImageFactory::CreateImageView(m_Device, m_GBufferNormals.image, NormalsFormat,
                                                          vk::ImageAspectFlagBits::eColor, AllocationTracker,
                                                          "GBufferNormalsView");
-    m_GBufferMaterialView = ImageFactory::CreateImageView(m_Device, m_GBufferMaterial.image, vk::Format::eR8G8B8A8Unorm,
-                                                          vk::ImageAspectFlagBits::eColor, AllocationTracker,
-                                                          "GBufferMaterialView");
 
     m_AllocationTracker = AllocationTracker;
 
 }
 
 void GBufferPass::DoPass(const vk::ImageView DepthImageView, uint32_t CurrentFrame, uint32_t width, uint32_t height) {
+    // The previous frame in flight may still be sampling the G-buffer, in its color pass or in the compute lighting
     ImageFactory::ShiftImageLayout(*m_CommandBuffer[CurrentFrame], m_GBufferDiffuse,
                                    vk::ImageLayout::eColorAttachmentOptimal,
                                    vk::AccessFlagBits::eNone, vk::AccessFlagBits::eColorAttachmentWrite,
-                                   vk::PipelineStageFlagBits::eNone, vk::PipelineStageFlagBits::eColorAttachmentOutput);
+                                   vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+                                   vk::PipelineStageFlagBits::eColorAttachmentOutput);
 
     ImageFactory::ShiftImageLayout(*m_CommandBuffer[CurrentFrame], m_GBufferNormals,
                                    vk::ImageLayout::eColorAttachmentOptimal,
                                    vk::AccessFlagBits::eNone, vk::AccessFlagBits::eColorAttachmentWrite,
-                                   vk::PipelineStageFlagBits::eNone, vk::PipelineStageFlagBits::eColorAttachmentOutput);
-
-    ImageFactory::ShiftImageLayout(*m_CommandBuffer[CurrentFrame], m_GBufferMaterial,
-                                   vk::ImageLayout::eColorAttachmentOptimal,
-                                   vk::AccessFlagBits::eNone, vk::AccessFlagBits::eColorAttachmentWrite,
-                                   vk::PipelineStageFlagBits::eNone, vk::PipelineStageFlagBits::eColorAttachmentOutput);
+                                   vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
+                                   vk::PipelineStageFlagBits::eColorAttachmentOutput);
 
 
     vk::Viewport viewport{0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f};
     vk::Rect2D scissor{{0, 0}, {width, height}};
 
-    std::array<vk::RenderingAttachmentInfo, 3> gbufferAttachments{
+    std::array<vk::RenderingAttachmentInfo, 2> gbufferAttachments{
         vk::RenderingAttachmentInfo().setImageView(m_GBufferDiffuseView).
         setImageLayout(vk::ImageLayout::eColorAttachmentOptimal).setLoadOp(vk::AttachmentLoadOp::eClear).
         setStoreOp(vk::AttachmentStoreOp::eStore).setClearValue(vk::ClearValue({0, 0, 0, 1})),
         vk::RenderingAttachmentInfo().setImageView(m_GBufferNormalsView).
         setImageLayout(vk::ImageLayout::eColorAttachmentOptimal).setLoadOp(vk::AttachmentLoadOp::eClear).
-        setStoreOp(vk::AttachmentStoreOp::eStore).setClearValue(vk::ClearValue({0, 0, 1, 0})),
-        vk::RenderingAttachmentInfo().setImageView(m_GBufferMaterialView).
-        setImageLayout(vk::ImageLayout::eColorAttachmentOptimal).setLoadOp(vk::AttachmentLoadOp::eClear).
-        setStoreOp(vk::AttachmentStoreOp::eStore).setClearValue(vk::ClearValue({0, 0, 0, 0}))
+        setStoreOp(vk::AttachmentStoreOp::eStore).setClearValue(vk::ClearValue({0, 0, 1, 0}))
     };
 
     vk::RenderingAttachmentInfo depthAttachment{};
@@ -250,16 +201,17 @@ void GBufferPass::DoPass(const vk::ImageView DepthImageView, uint32_t CurrentFra
     m_CommandBuffer[CurrentFrame]->beginRendering(renderInfo);
     m_CommandBuffer[CurrentFrame]->bindPipeline(vk::PipelineBindPoint::eGraphics, **m_GBufferPipeline);
     m_CommandBuffer[CurrentFrame]->bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_PipelineLayout, 0,
-                                                      m_DescriptorSets, {});
+                                                      m_DescriptorSets->GetDescriptorSets(CurrentFrame), *m_DynamicOffsets);
     m_CommandBuffer[CurrentFrame]->setViewport(0, viewport);
     m_CommandBuffer[CurrentFrame]->setScissor(0, scissor);
 
-    for (const auto &mesh: m_Meshes) {
-        m_CommandBuffer[CurrentFrame]->bindVertexBuffers(0, {mesh.m_VertexBufferInfo.m_Buffer}, mesh.m_VertexOffset);
-        m_CommandBuffer[CurrentFrame]->bindIndexBuffer(mesh.m_IndexBufferInfo.m_Buffer, 0, vk::IndexType::eUint32);
-        m_CommandBuffer[CurrentFrame]->pushConstants(m_PipelineLayout, vk::ShaderStageFlagBits::eFragment, 0,
-                                                     vk::ArrayProxy<const Material>{mesh.m_Material});
-        m_CommandBuffer[CurrentFrame]->drawIndexed(mesh.m_IndexCount, 1, 0, 0, 0);
+    m_GeometryPool->Bind(**m_CommandBuffer[CurrentFrame]);
+
+    // The equal depth test against the prepass already rejects cut out texels, both buckets share the pipeline
+    for (uint32_t bucket = 0; bucket < IndirectDrawBuffer::DrawBucketCount; ++bucket) {
+        const auto drawBucket = static_cast<IndirectDrawBuffer::DrawBucket>(bucket);
+        m_DrawBuffer->DrawVisible(**m_CommandBuffer[CurrentFrame], CurrentFrame, drawBucket);
+        m_DrawBuffer->DrawVisibleLate(**m_CommandBuffer[CurrentFrame], CurrentFrame, drawBucket);
     }
     m_CommandBuffer[CurrentFrame]->endRendering();
 }
@@ -272,7 +224,7 @@ void GBufferPass::CreatePipeline(uint32_t ImageResourceSize, const vk::Format &D
     depthStencil.depthBoundsTestEnable = VK_FALSE;
     depthStencil.stencilTestEnable = VK_FALSE;
 
-    std::vector<vk::PipelineColorBlendAttachmentState> blendAttachments(3);
+    std::vector<vk::PipelineColorBlendAttachmentState> blendAttachments(2);
     for (auto &blend: blendAttachments) {
         blend.colorWriteMask =
                 vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
@@ -297,12 +249,12 @@ void GBufferPass::CreatePipeline(uint32_t ImageResourceSize, const vk::Format &D
     inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    vk::VertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    auto bindingDescriptions = PackedVertex::getBindingDescriptions();
+    auto attributeDescriptions = PackedVertex::getAttributeDescriptions();
 
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
@@ -334,9 +286,8 @@ void GBufferPass::CreatePipeline(uint32_t ImageResourceSize, const vk::Format &D
     viewportState.pScissors = nullptr;
 
     std::vector<vk::Format> gbufferFormats = {
-        vk::Format::eR8G8B8A8Srgb, // Diffuse
-        vk::Format::eR8G8B8A8Unorm, // Normals
-        vk::Format::eR8G8B8A8Unorm // Material
+        DiffuseFormat,
+        NormalsFormat
     };
 
 
@@ -364,10 +315,8 @@ void GBufferPass::RecreateGBuffer(VmaAllocator Allocator,
 
     m_GBufferDiffuseView = VK_NULL_HANDLE;
     m_GBufferNormalsView = VK_NULL_HANDLE;
-    m_GBufferMaterialView = VK_NULL_HANDLE;
     m_GBufferDiffuse = {};
     m_GBufferNormals = {};
-    m_GBufferMaterial = {};
 
 
     vk::Extent3D extent = {width, height, 1};
@@ -375,26 +324,22 @@ void GBufferPass::RecreateGBuffer(VmaAllocator Allocator,
     CreateGBuffer(Allocator,AllocationTracker,width, height);
 }
 
-std::tuple<VkImageView, VkImageView, VkImageView> GBufferPass::GetImageViews() {
-    return {m_GBufferDiffuseView, m_GBufferNormalsView, m_GBufferMaterialView};
+std::pair<VkImageView, VkImageView> GBufferPass::GetImageViews() {
+    return {m_GBufferDiffuseView, m_GBufferNormalsView};
 }
 
 void GBufferPass::DestroyImages(VmaAllocator Alloc) {
     m_AllocationTracker->UntrackImageView(m_GBufferDiffuseView);
     m_AllocationTracker->UntrackImageView(m_GBufferNormalsView);
-    m_AllocationTracker->UntrackImageView(m_GBufferMaterialView);
 
     vkDestroyImageView(*m_Device, m_GBufferDiffuseView, nullptr);
     vkDestroyImageView(*m_Device, m_GBufferNormalsView, nullptr);
-    vkDestroyImageView(*m_Device, m_GBufferMaterialView, nullptr);
 
     m_AllocationTracker->UntrackAllocation(m_GBufferDiffuse.allocation);
     m_AllocationTracker->UntrackAllocation(m_GBufferNormals.allocation);
-    m_AllocationTracker->UntrackAllocation(m_GBufferMaterial.allocation);
 
     vmaDestroyImage(Alloc, m_GBufferDiffuse.image, m_GBufferDiffuse.allocation);
     vmaDestroyImage(Alloc, m_GBufferNormals.image, m_GBufferNormals.allocation);
-    vmaDestroyImage(Alloc, m_GBufferMaterial.image, m_GBufferMaterial.allocation);
 }
 
 void GBufferPass::CreateModules() {
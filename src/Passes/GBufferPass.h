@@ -15,9 +15,18 @@
 #include "Factories/MeshFactory.h"
 
 class PipelineFactory;
+class GeometryPool;
+class IndirectDrawBuffer;
+class DescriptorSets;
 
+// Fills two RGBA8 targets: albedo with metallic in alpha, and the octahedral encoded world normal with roughness
+// in alpha. 8 bytes per pixel, the earlier layout with a separate material target took 12.
 class GBufferPass {
 public:
+    static constexpr vk::Format DiffuseFormat = vk::Format::eR8G8B8A8Srgb;
+    static constexpr vk::Format NormalsFormat = vk::Format::eR8G8B8A8Unorm;
+    static constexpr uint32_t BytesPerPixel = 8;
+
     GBufferPass(const vk::raii::Device &Device,
                 const std::vector<std::unique_ptr<vk::raii::CommandBuffer> > &CommandBuffer);
 
@@ -42,17 +51,21 @@ public:
 
     void ShiftLayout(const vk::raii::CommandBuffer &command_buffer);
 
-    void SetMeshes(const std::vector<Mesh> &Meshes) { m_Meshes = Meshes; };
+    void SetDrawBuffer(const IndirectDrawBuffer *Draws) { m_DrawBuffer = Draws; };
+    void SetGeometryPool(const GeometryPool *Pool) { m_GeometryPool = Pool; };
 
     void CreatePipeline(uint32_t ImageResourceSize, const vk::Format &DepthFormat);
 
     void RecreateGBuffer(VmaAllocator Allocator,
                          ResourceTracker *AllocationTracker, uint32_t width, uint32_t height);
 
-    // returns diffuse normal material
-    std::tuple<VkImageView, VkImageView, VkImageView> GetImageViews();
+    // returns diffuse normal
+    std::pair<VkImageView, VkImageView> GetImageViews();
 
-    std::vector<vk::DescriptorSet> m_DescriptorSets;
+    // Owned by DescriptorSets, the sets of the frame being recorded are bound
+    const DescriptorSets *m_DescriptorSets{};
+    // Owned by DescriptorSets, read at record time
+    const std::vector<uint32_t> *m_DynamicOffsets{};
     vk::PipelineLayout m_PipelineLayout;
 
     void DestroyImages(VmaAllocator Alloc);
@@ -68,16 +81,15 @@ private:
     std::vector<vk::raii::ShaderModule> m_GBufferShaderModules{};
 
 
-    std::vector<Mesh> m_Meshes;
+    const IndirectDrawBuffer *m_DrawBuffer{};
+    const GeometryPool *m_GeometryPool{};
 
     // G-buffer images
     ImageResource m_GBufferDiffuse;
     ImageResource m_GBufferNormals;
-    ImageResource m_GBufferMaterial;
 
     VkImageView m_GBufferDiffuseView{};
     VkImageView m_GBufferNormalsView{};
-    VkImageView m_GBufferMaterialView{};
 
 
     ResourceTracker *m_AllocationTracker;
@@ -0,0 +1,262 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "HiZPass.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#include "ResourceTracker.h"
+#include "Factories/ShaderFactory.h"
+
+namespace {
+    constexpr uint32_t HiZGroupSize = 8;
+    constexpr uint32_t MaxHiZMips = 16;
+}
+
+HiZPass::HiZPass(const vk::raii::Device &Device,
+                 const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer)
+    : m_Device(Device)
+      , m_CommandBuffer(CommandBuffer)
+      , m_PipelineFactory(std::make_unique<PipelineFactory>(Device)) {
+}
+
+void HiZPass::CreateResources(VmaAllocator Allocator, ResourceTracker *AllocationTracker,
+                              vk::ImageView DepthImageView, uint32_t width, uint32_t height) {
+    m_Allocator = Allocator;
+    m_AllocationTracker = AllocationTracker;
+
+    vk::SamplerReductionModeCreateInfo reductionInfo{};
+    reductionInfo.reductionMode = vk::SamplerReductionMode::eMax;
+
+    vk::SamplerCreateInfo samplerInfo{};
+    samplerInfo.pNext = &reductionInfo;
+    samplerInfo.magFilter = vk::Filter::eLinear;
+    samplerInfo.minFilter = vk::Filter::eLinear;
+    samplerInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+    samplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+    samplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+    samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+    m_Sampler = std::make_unique<vk::raii::Sampler>(m_Device, samplerInfo);
+
+    std::array<vk::DescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = vk::DescriptorType::eStorageImage;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    vk::DescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.setBindings(bindings);
+    m_DescriptorSetLayout = std::make_unique<vk::raii::DescriptorSetLayout>(m_Device, layoutInfo);
+
+    std::array<vk::DescriptorPoolSize, 2> poolSizes{
+        vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, MaxHiZMips},
+        vk::DescriptorPoolSize{vk::DescriptorType::eStorageImage, MaxHiZMips}
+    };
+
+    vk::DescriptorPoolCreateInfo poolInfo{};
+    poolInfo.maxSets = MaxHiZMips;
+    poolInfo.setPoolSizes(poolSizes);
+    m_DescriptorPool = std::make_unique<vk::raii::DescriptorPool>(m_Device, poolInfo);
+
+    CreatePipeline();
+    CreateImages(width, height);
+    WriteDescriptorSets(DepthImageView);
+}
+
+void HiZPass::RecreateResources(vk::ImageView DepthImageView, uint32_t width, uint32_t height) {
+    DestroyImages();
+    m_DescriptorPool->reset();
+
+    CreateImages(width, height);
+    WriteDescriptorSets(DepthImageView);
+}
+
+void HiZPass::DoPass(uint32_t CurrentFrame, ImageResource &DepthImage) {
+    using AF = vk::AccessFlagBits;
+    using PS = vk::PipelineStageFlagBits;
+
+    const vk::raii::CommandBuffer &cmd = *m_CommandBuffer[CurrentFrame];
+
+    ImageFactory::ShiftImageLayout(*cmd,
+                                   DepthImage,
+                                   vk::ImageLayout::eDepthReadOnlyOptimal,
+                                   AF::eDepthStencilAttachmentWrite,
+                                   AF::eShaderRead,
+                                   PS::eEarlyFragmentTests | PS::eLateFragmentTests,
+                                   PS::eComputeShader);
+
+    // The pyramid lives in General, the late cull of the previous frame may still be sampling it
+    vk::ImageMemoryBarrier pyramidBarrier{};
+    pyramidBarrier.oldLayout = m_Pyramid.imageLayout;
+    pyramidBarrier.newLayout = vk::ImageLayout::eGeneral;
+    pyramidBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    pyramidBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    pyramidBarrier.image = m_Pyramid.image;
+    pyramidBarrier.subresourceRange = vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, m_MipCount, 0, 1};
+    pyramidBarrier.srcAccessMask = AF::eShaderRead;
+    pyramidBarrier.dstAccessMask = AF::eShaderWrite;
+    cmd.pipelineBarrier(PS::eComputeShader, PS::eComputeShader, {}, nullptr, nullptr, pyramidBarrier);
+    m_Pyramid.imageLayout = vk::ImageLayout::eGeneral;
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, **m_Pipeline);
+
+    for (uint32_t mip = 0; mip < m_MipCount; ++mip) {
+        const uint32_t mipWidth = std::max(m_Pyramid.extent.width >> mip, 1u);
+        const uint32_t mipHeight = std::max(m_Pyramid.extent.height >> mip, 1u);
+
+        PushConstants constants{};
+        constants.outputSize = glm::vec2(mipWidth, mipHeight);
+
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, **m_PipelineLayout, 0, m_DescriptorSets[mip], {});
+        cmd.pushConstants(**m_PipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+                          vk::ArrayProxy<const PushConstants>{constants});
+        cmd.dispatch((mipWidth + HiZGroupSize - 1) / HiZGroupSize, (mipHeight + HiZGroupSize - 1) / HiZGroupSize, 1);
+
+        // The next mip reads this one, the last barrier also covers the late cull
+        vk::MemoryBarrier mipBarrier{};
+        mipBarrier.srcAccessMask = AF::eShaderWrite;
+        mipBarrier.dstAccessMask = AF::eShaderRead;
+        cmd.pipelineBarrier(PS::eComputeShader, PS::eComputeShader, {}, mipBarrier, nullptr, nullptr);
+    }
+
+    ImageFactory::ShiftImageLayout(*cmd,
+                                   DepthImage,
+                                   vk::ImageLayout::eDepthAttachmentOptimal,
+                                   AF::eShaderRead,
+                                   AF::eDepthStencilAttachmentRead | AF::eDepthStencilAttachmentWrite,
+                                   PS::eComputeShader,
+                                   PS::eEarlyFragmentTests);
+}
+
+void HiZPass::CreatePipeline() {
+    vk::PushConstantRange pushConstantRange{};
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    vk::DescriptorSetLayout setLayout = **m_DescriptorSetLayout;
+
+    vk::PipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.setSetLayouts(setLayout);
+    layoutInfo.setPushConstantRanges(pushConstantRange);
+    m_PipelineLayout = std::make_unique<vk::raii::PipelineLayout>(m_Device, layoutInfo);
+
+    vk::raii::ShaderModule hizModule = ShaderFactory::Build_ComputeModule(m_Device, "shaders/hizcomp.spv");
+
+    vk::DebugUtilsObjectNameInfoEXT nameInfo{};
+    nameInfo.pObjectName = "HIZ";
+    nameInfo.objectType = vk::ObjectType::eShaderModule;
+    nameInfo.objectHandle = uint64_t(static_cast<VkShaderModule>(*hizModule));
+    m_Device.setDebugUtilsObjectNameEXT(nameInfo);
+
+    vk::PipelineShaderStageCreateInfo computeStage{};
+    computeStage.setStage(vk::ShaderStageFlagBits::eCompute);
+    computeStage.setModule(hizModule);
+    computeStage.setPName("main");
+
+    m_Pipeline = std::make_unique<vk::raii::Pipeline>(m_PipelineFactory
+        ->SetLayout(**m_PipelineLayout)
+        .BuildCompute(computeStage));
+}
+
+void HiZPass::CreateImages(uint32_t width, uint32_t height) {
+    // Power of two levels keep every texel an exact 2x2 footprint of the level above
+    const uint32_t pyramidWidth = std::bit_floor(std::max(width, 1u));
+    const uint32_t pyramidHeight = std::bit_floor(std::max(height, 1u));
+    m_MipCount = std::min(static_cast<uint32_t>(std::bit_width(std::max(pyramidWidth, pyramidHeight))), MaxHiZMips);
+
+    vk::ImageCreateInfo imageInfo{};
+    imageInfo.imageType = vk::ImageType::e2D;
+    imageInfo.extent = vk::Extent3D{pyramidWidth, pyramidHeight, 1};
+    imageInfo.mipLevels = m_MipCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = vk::Format::eR32Sfloat;
+    imageInfo.tiling = vk::ImageTiling::eOptimal;
+    imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+    imageInfo.usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage;
+    imageInfo.samples = vk::SampleCountFlagBits::e1;
+    imageInfo.sharingMode = vk::SharingMode::eExclusive;
+
+    ImageFactory::CreateImage(m_Device, m_Allocator, m_Pyramid, imageInfo, "HiZPyramid");
+    m_Pyramid.extent = vk::Extent2D{pyramidWidth, pyramidHeight};
+    m_Pyramid.imageAspectFlags = vk::ImageAspectFlagBits::eColor;
+    m_AllocationTracker->TrackAllocation(m_Pyramid.allocation, "HiZPyramid");
+
+    m_PyramidView = ImageFactory::CreateImageView(m_Device, m_Pyramid.image, vk::Format::eR32Sfloat,
+                                                  vk::ImageAspectFlagBits::eColor, m_AllocationTracker,
+                                                  "HiZPyramidView", 0, vk::ImageViewType::e2D, 0, m_MipCount);
+
+    for (uint32_t mip = 0; mip < m_MipCount; ++mip) {
+        m_MipViews.push_back(ImageFactory::CreateImageView(m_Device, m_Pyramid.image, vk::Format::eR32Sfloat,
+                                                           vk::ImageAspectFlagBits::eColor, m_AllocationTracker,
+                                                           "HiZMipView" + std::to_string(mip), 0,
+                                                           vk::ImageViewType::e2D, mip, 1));
+    }
+}
+
+void HiZPass::WriteDescriptorSets(vk::ImageView DepthImageView) {
+    std::vector<vk::DescriptorSetLayout> setLayouts(m_MipCount, **m_DescriptorSetLayout);
+
+    vk::DescriptorSetAllocateInfo allocInfo{};
+    allocInfo.descriptorPool = **m_DescriptorPool;
+    allocInfo.setSetLayouts(setLayouts);
+
+    auto dev = *m_Device;
+    m_DescriptorSets = dev.allocateDescriptorSets(allocInfo);
+
+    for (uint32_t mip = 0; mip < m_MipCount; ++mip) {
+        vk::DescriptorImageInfo inputInfo{};
+        inputInfo.sampler = **m_Sampler;
+        inputInfo.imageView = mip == 0 ? DepthImageView : m_MipViews[mip - 1];
+        inputInfo.imageLayout = mip == 0 ? vk::ImageLayout::eDepthReadOnlyOptimal : vk::ImageLayout::eGeneral;
+
+        vk::DescriptorImageInfo outputInfo{};
+        outputInfo.imageView = m_MipViews[mip];
+        outputInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+        std::array<vk::WriteDescriptorSet, 2> writes{};
+        writes[0].dstSet = m_DescriptorSets[mip];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        writes[0].pImageInfo = &inputInfo;
+        writes[1].dstSet = m_DescriptorSets[mip];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = vk::DescriptorType::eStorageImage;
+        writes[1].pImageInfo = &outputInfo;
+
+        m_Device.updateDescriptorSets(writes, {});
+    }
+}
+
+void HiZPass::DestroyImages() {
+    for (vk::ImageView view: m_MipViews) {
+        m_AllocationTracker->UntrackImageView(view);
+        vkDestroyImageView(*m_Device, view, nullptr);
+    }
+    m_MipViews.clear();
+
+    if (m_PyramidView) {
+        m_AllocationTracker->UntrackImageView(m_PyramidView);
+        vkDestroyImageView(*m_Device, m_PyramidView, nullptr);
+        m_PyramidView = nullptr;
+    }
+
+    if (m_Pyramid.image) {
+        m_AllocationTracker->UntrackAllocation(m_Pyramid.allocation);
+        vmaDestroyImage(m_Allocator, m_Pyramid.image, m_Pyramid.allocation);
+        m_Pyramid = {};
+    }
+
+    m_DescriptorSets.clear();
+}
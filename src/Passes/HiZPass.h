@@ -0,0 +1,83 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef HIZPASS_H
+#define HIZPASS_H
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.h>
+#include <glm/glm.hpp>
+
+#include "Factories/ImageFactory.h"
+#include "Factories/PipelineFactory.h"
+
+class ResourceTracker;
+
+// Depth pyramid of the depth prepass. Mip 0 is the depth buffer downsampled to the previous power of two,
+// every further mip keeps the farthest depth of the 2x2 texels below it. All reads go through a max reduction
+// sampler, so a single bilinear tap returns the farthest depth of its footprint; the CullPass uses the same
+// sampler to test projected bounds against it.
+class HiZPass {
+public:
+    HiZPass(const vk::raii::Device &Device, const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer);
+    virtual ~HiZPass() = default;
+
+    HiZPass(const HiZPass&) = delete;
+    HiZPass(HiZPass&&) noexcept = delete;
+    HiZPass& operator=(const HiZPass&) = delete;
+    HiZPass& operator=(HiZPass&&) noexcept = delete;
+
+    void CreateResources(VmaAllocator Allocator, ResourceTracker *AllocationTracker, vk::ImageView DepthImageView,
+                         uint32_t width, uint32_t height);
+
+    // The depth image was recreated, the pyramid follows its size
+    void RecreateResources(vk::ImageView DepthImageView, uint32_t width, uint32_t height);
+
+    // Samples the depth written so far and hands it back in DepthAttachmentOptimal for the late draws
+    void DoPass(uint32_t CurrentFrame, ImageResource &DepthImage);
+
+    [[nodiscard]] vk::ImageView GetImageView() const { return m_PyramidView; }
+    [[nodiscard]] vk::Sampler GetSampler() const { return **m_Sampler; }
+    [[nodiscard]] vk::Extent2D GetExtent() const { return m_Pyramid.extent; }
+
+    void DestroyImages();
+
+private:
+    struct PushConstants {
+        glm::vec2 outputSize;
+    };
+
+    void CreatePipeline();
+
+    void CreateImages(uint32_t width, uint32_t height);
+
+    void WriteDescriptorSets(vk::ImageView DepthImageView);
+
+    const vk::raii::Device &m_Device;
+    const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &m_CommandBuffer;
+
+    std::unique_ptr<PipelineFactory> m_PipelineFactory{};
+    std::unique_ptr<vk::raii::Sampler> m_Sampler{};
+    std::unique_ptr<vk::raii::DescriptorSetLayout> m_DescriptorSetLayout{};
+    std::unique_ptr<vk::raii::DescriptorPool> m_DescriptorPool{};
+    std::unique_ptr<vk::raii::PipelineLayout> m_PipelineLayout{};
+    std::unique_ptr<vk::raii::Pipeline> m_Pipeline{};
+
+    // One set per mip: the level above (or the depth buffer) as input, the mip itself as storage image
+    std::vector<vk::DescriptorSet> m_DescriptorSets{};
+
+    ImageResource m_Pyramid{};
+    uint32_t m_MipCount{};
+    vk::ImageView m_PyramidView{};
+    std::vector<vk::ImageView> m_MipViews{};
+
+    VmaAllocator m_Allocator{};
+    ResourceTracker *m_AllocationTracker{};
+};
+
+
+#endif //HIZPASS_H
@@ -0,0 +1,133 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "ShadowMaskPass.h"
+
+#include "DescriptorSets/DescriptorSets.h"
+#include "ResourceTracker.h"
+#include "Factories/ShaderFactory.h"
+
+namespace {
+    constexpr uint32_t ShadowMaskGroupSize = 8;
+}
+
+ShadowMaskPass::ShadowMaskPass(const vk::raii::Device &Device,
+                               const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer)
+    : m_Device(Device)
+      , m_CommandBuffer(CommandBuffer)
+      , m_PipelineFactory(std::make_unique<PipelineFactory>(Device)) {
+}
+
+void ShadowMaskPass::CreateImage(VmaAllocator Allocator, ResourceTracker *AllocationTracker, uint32_t width,
+                                 uint32_t height) {
+    m_Allocator = Allocator;
+    m_AllocationTracker = AllocationTracker;
+
+    const uint32_t maskWidth = (width + Downscale - 1) / Downscale;
+    const uint32_t maskHeight = (height + Downscale - 1) / Downscale;
+
+    vk::ImageCreateInfo imageInfo{};
+    imageInfo.imageType = vk::ImageType::e2D;
+    imageInfo.extent = vk::Extent3D{maskWidth, maskHeight, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = vk::Format::eR8G8B8A8Unorm;
+    imageInfo.tiling = vk::ImageTiling::eOptimal;
+    imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+    imageInfo.usage = vk::ImageUsageFlagBits::eStorage;
+    imageInfo.samples = vk::SampleCountFlagBits::e1;
+    imageInfo.sharingMode = vk::SharingMode::eExclusive;
+
+    ImageFactory::CreateImage(m_Device, m_Allocator, m_Mask, imageInfo, "ShadowMask");
+    m_Mask.extent = vk::Extent2D{maskWidth, maskHeight};
+    m_Mask.imageAspectFlags = vk::ImageAspectFlagBits::eColor;
+    m_AllocationTracker->TrackAllocation(m_Mask.allocation, "ShadowMask");
+
+    m_MaskView = ImageFactory::CreateImageView(m_Device, m_Mask.image, vk::Format::eR8G8B8A8Unorm,
+                                               vk::ImageAspectFlagBits::eColor, m_AllocationTracker,
+                                               "ShadowMaskView");
+}
+
+void ShadowMaskPass::RecreateImage(uint32_t width, uint32_t height) {
+    DestroyImage();
+    CreateImage(m_Allocator, m_AllocationTracker, width, height);
+}
+
+void ShadowMaskPass::DoPass(uint32_t CurrentFrame) {
+    using AF = vk::AccessFlagBits;
+    using PS = vk::PipelineStageFlagBits;
+
+    const vk::raii::CommandBuffer &cmd = *m_CommandBuffer[CurrentFrame];
+
+    // The mask lives in General, the lighting pass of the previous frame may still be reading it
+    ImageFactory::ShiftImageLayout(*cmd,
+                                   m_Mask,
+                                   vk::ImageLayout::eGeneral,
+                                   AF::eShaderRead,
+                                   AF::eShaderWrite,
+                                   PS::eFragmentShader,
+                                   PS::eComputeShader);
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, **m_Pipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_PipelineLayout, 0, m_DescriptorSets->GetDescriptorSets(CurrentFrame), *m_DynamicOffsets);
+
+    PushConstants constants{};
+    constants.shadowFilter = static_cast<uint32_t>(m_ShadowFilter);
+    cmd.pushConstants(m_PipelineLayout, vk::ShaderStageFlagBits::eCompute, PushConstantOffset,
+                      vk::ArrayProxy<const PushConstants>{constants});
+
+    cmd.dispatch((m_Mask.extent.width + ShadowMaskGroupSize - 1) / ShadowMaskGroupSize,
+                 (m_Mask.extent.height + ShadowMaskGroupSize - 1) / ShadowMaskGroupSize, 1);
+
+    ImageFactory::ShiftImageLayout(*cmd,
+                                   m_Mask,
+                                   vk::ImageLayout::eGeneral,
+                                   AF::eShaderWrite,
+                                   AF::eShaderRead,
+                                   PS::eComputeShader,
+                                   PS::eFragmentShader | PS::eComputeShader);
+}
+
+void ShadowMaskPass::CreatePipeline(uint32_t DirectionalLights) {
+    vk::raii::ShaderModule maskModule = ShaderFactory::Build_ComputeModule(m_Device, "shaders/shadowmaskcomp.spv");
+
+    vk::DebugUtilsObjectNameInfoEXT nameInfo{};
+    nameInfo.pObjectName = "SHADOW MASK";
+    nameInfo.objectType = vk::ObjectType::eShaderModule;
+    nameInfo.objectHandle = uint64_t(static_cast<VkShaderModule>(*maskModule));
+    m_Device.setDebugUtilsObjectNameEXT(nameInfo);
+
+    // Same constant id as the lighting shader sizes its arrays with
+    vk::SpecializationMapEntry entry{3, 0, sizeof(uint32_t)};
+
+    vk::SpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &entry;
+    specializationInfo.dataSize = sizeof(uint32_t);
+    specializationInfo.pData = &DirectionalLights;
+
+    vk::PipelineShaderStageCreateInfo computeStage{};
+    computeStage.setStage(vk::ShaderStageFlagBits::eCompute);
+    computeStage.setModule(maskModule);
+    computeStage.setPName("main");
+    computeStage.pSpecializationInfo = &specializationInfo;
+
+    m_Pipeline = std::make_unique<vk::raii::Pipeline>(m_PipelineFactory
+        ->SetLayout(m_PipelineLayout)
+        .BuildCompute(computeStage));
+}
+
+void ShadowMaskPass::DestroyImage() {
+    if (m_MaskView) {
+        m_AllocationTracker->UntrackImageView(m_MaskView);
+        vkDestroyImageView(*m_Device, m_MaskView, nullptr);
+        m_MaskView = nullptr;
+    }
+
+    if (m_Mask.image) {
+        m_AllocationTracker->UntrackAllocation(m_Mask.allocation);
+        vmaDestroyImage(m_Allocator, m_Mask.image, m_Mask.allocation);
+        m_Mask = {};
+    }
+}
@@ -0,0 +1,92 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef SHADOWMASKPASS_H
+#define SHADOWMASKPASS_H
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.h>
+
+#include "Factories/ImageFactory.h"
+#include "Factories/PipelineFactory.h"
+
+class ResourceTracker;
+class DescriptorSets;
+
+// Resolves the visibility of every directional light into an RGBA8 mask, one channel per light, at a fraction of the
+// screen resolution. The lighting shader reads it through a depth aware bilateral upsample instead of filtering the
+// shadow maps per pixel, lights past the fourth stay unshadowed. Runs with the frame and global sets of the shared
+// pipeline layout, the mask is binding 9.
+class ShadowMaskPass {
+public:
+    // How the shadow maps are filtered, matches SHADOW_FILTER_* in shadowmask.comp
+    enum class ShadowFilter : uint32_t {
+        PCFTent = 0, // wide tent filter, about 110 gathers per light
+        PCSS,        // blocker search then a Poisson disk sized by the penumbra, 24 gathers per light
+        Count
+    };
+
+    // Screen pixels per mask texel along each axis, matches SHADOW_MASK_SCALE in the shaders. 4 for quarter resolution
+    static constexpr uint32_t Downscale = 2;
+
+    ShadowMaskPass(const vk::raii::Device &Device,
+                   const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &CommandBuffer);
+    virtual ~ShadowMaskPass() = default;
+
+    ShadowMaskPass(const ShadowMaskPass&) = delete;
+    ShadowMaskPass(ShadowMaskPass&&) noexcept = delete;
+    ShadowMaskPass& operator=(const ShadowMaskPass&) = delete;
+    ShadowMaskPass& operator=(ShadowMaskPass&&) noexcept = delete;
+
+    // Width and height are the screen's, the mask rounds them up to whole blocks
+    void CreateImage(VmaAllocator Allocator, ResourceTracker *AllocationTracker, uint32_t width, uint32_t height);
+
+    void RecreateImage(uint32_t width, uint32_t height);
+
+    // Needs m_PipelineLayout, the light count specializes the shadow map array like in the lighting shader
+    void CreatePipeline(uint32_t DirectionalLights);
+
+    // The depth buffer has to be readable by compute already, the mask is readable by fragment shaders afterwards
+    void DoPass(uint32_t CurrentFrame);
+
+    void SetShadowFilter(ShadowFilter Filter) { m_ShadowFilter = Filter; }
+    [[nodiscard]] ShadowFilter GetShadowFilter() const { return m_ShadowFilter; }
+
+    [[nodiscard]] vk::ImageView GetImageView() const { return m_MaskView; }
+
+    void DestroyImage();
+
+    // Owned by DescriptorSets, the sets of the frame being recorded are bound
+    const DescriptorSets *m_DescriptorSets{};
+    // Owned by DescriptorSets, read at record time
+    const std::vector<uint32_t> *m_DynamicOffsets{};
+    vk::PipelineLayout m_PipelineLayout;
+
+private:
+    // Compute range of the shared layout, the vertex range before it belongs to the shadow pass
+    struct PushConstants {
+        uint32_t shadowFilter;
+    };
+    static constexpr uint32_t PushConstantOffset = sizeof(uint32_t);
+
+    const vk::raii::Device &m_Device;
+    const std::vector<std::unique_ptr<vk::raii::CommandBuffer>> &m_CommandBuffer;
+
+    std::unique_ptr<PipelineFactory> m_PipelineFactory{};
+    std::unique_ptr<vk::raii::Pipeline> m_Pipeline{};
+
+    ImageResource m_Mask{};
+    vk::ImageView m_MaskView{};
+
+    VmaAllocator m_Allocator{};
+    ResourceTracker *m_AllocationTracker{};
+
+    ShadowFilter m_ShadowFilter{ ShadowFilter::PCFTent };
+};
+
+
+#endif //SHADOWMASKPASS_H
@@ -6,8 +6,12 @@
 
 #include <ranges>
 
+#include "DescriptorSets/DescriptorSets.h"
+#include "GeometryPool.h"
+#include "IndirectDrawBuffer.h"
 #include "Factories/ImageFactory.h"
 #include "Factories/ShaderFactory.h"
+#include "Structs/UBOStructs.h"
 
 void ShadowPass::CreatePipeline(uint32_t shadowMapCount, vk::Format depthFormat) {
     // Depth test/write enabled, less or equal for shadow mapping
@@ -55,12 +59,12 @@ void ShadowPass::CreatePipeline(uint32_t shadowMapCount, vk::Format depthFormat)
     inputAssembly.topology = vk::PrimitiveTopology::eTriangleList;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-    // Vertex input (match Vertex struct)
-    vk::VertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    // Vertex input, the position stream only
+    auto bindingDescriptions = PackedVertex::getBindingDescriptions(PositionStream + 1);
+    auto attributeDescriptions = PackedVertex::getAttributeDescriptions(PositionStream + 1);
     vk::PipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
@@ -120,13 +124,41 @@ void ShadowPass::CreatePipeline(uint32_t shadowMapCount, vk::Format depthFormat)
 }
 
 
-void ShadowPass::DoPass(uint32_t LightsIdx, uint32_t CurrentFrame, uint32_t width, uint32_t height) {
+void ShadowPass::PrepareImageForWrite(uint32_t LightsIdx, uint32_t CurrentFrame) {
+    // The map is re-rendered while earlier frames may still sample it, their shadow mask reads have to finish first
+    ImageFactory::ShiftImageLayout(
+        *m_CommandBuffer[CurrentFrame],
+        m_ShadowImageResource[LightsIdx],
+        vk::ImageLayout::eDepthAttachmentOptimal,
+        vk::AccessFlagBits::eNone,
+        vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eEarlyFragmentTests,
+        ShadowCascadeCount
+    );
+}
+
+void ShadowPass::PrepareImageForRead(uint32_t LightsIdx, uint32_t CurrentFrame) {
+    //  transition shadow map image for sampling
+    ImageFactory::ShiftImageLayout(
+        *m_CommandBuffer[CurrentFrame],
+        m_ShadowImageResource[LightsIdx],
+        vk::ImageLayout::eDepthReadOnlyOptimal,
+        vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+        vk::AccessFlagBits::eShaderRead,
+        vk::PipelineStageFlagBits::eLateFragmentTests,
+        vk::PipelineStageFlagBits::eComputeShader,
+        ShadowCascadeCount
+    );
+}
+
+void ShadowPass::DoPass(uint32_t ShadowView, uint32_t CurrentFrame, uint32_t width, uint32_t height) {
     vk::Viewport viewport{0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f};
     vk::Rect2D scissor{{0, 0}, {width, height}};
 
     // Depth attachment for shadow map
     vk::RenderingAttachmentInfo depthAttachment{};
-    depthAttachment.setImageView(m_ShadowImageView[LightsIdx]);
+    depthAttachment.setImageView(m_CascadeImageViews[ShadowView]);
     depthAttachment.setImageLayout(vk::ImageLayout::eDepthAttachmentOptimal);
     depthAttachment.setLoadOp(vk::AttachmentLoadOp::eClear);
     depthAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
@@ -144,36 +176,21 @@ void ShadowPass::DoPass(uint32_t LightsIdx, uint32_t CurrentFrame, uint32_t widt
         vk::PipelineBindPoint::eGraphics,
         m_PipelineLayout,
         0,
-        m_DescriptorSets,
-        {}
+        m_DescriptorSets->GetDescriptorSets(CurrentFrame),
+        *m_DynamicOffsets
     );
+    PushConstants constants{};
+    constants.shadowView = ShadowView;
+    m_CommandBuffer[CurrentFrame]->pushConstants(m_PipelineLayout, vk::ShaderStageFlagBits::eVertex, 0,
+                                                 vk::ArrayProxy<const PushConstants>{constants});
     m_CommandBuffer[CurrentFrame]->setViewport(0, viewport);
     m_CommandBuffer[CurrentFrame]->setScissor(0, scissor);
 
-    for (const auto &mesh: m_Meshes) {
-        m_CommandBuffer[CurrentFrame]->bindVertexBuffers(0, {mesh.m_VertexBufferInfo.m_Buffer}, mesh.m_VertexOffset);
-        m_CommandBuffer[CurrentFrame]->bindIndexBuffer(mesh.m_IndexBufferInfo.m_Buffer, 0, vk::IndexType::eUint32);
-        m_CommandBuffer[CurrentFrame]->pushConstants(
-            m_PipelineLayout,
-            vk::ShaderStageFlagBits::eFragment,
-            0,
-            vk::ArrayProxy<const Material>{mesh.m_Material}
-        );
-        m_CommandBuffer[CurrentFrame]->drawIndexed(mesh.m_IndexCount, 1, 0, 0, 0);
-    }
+    m_GeometryPool->Bind(**m_CommandBuffer[CurrentFrame], PositionStream + 1);
 
-    m_CommandBuffer[CurrentFrame]->endRendering();
+    m_DrawBuffer->DrawShadowList(**m_CommandBuffer[CurrentFrame], CurrentFrame, ShadowView);
 
-    //  transition shadow map image for sampling
-    ImageFactory::ShiftImageLayout(
-        *m_CommandBuffer[CurrentFrame],
-        m_ShadowImageResource[LightsIdx],
-        vk::ImageLayout::eDepthAttachmentOptimal,
-        vk::AccessFlagBits::eDepthStencilAttachmentWrite,
-        vk::AccessFlagBits::eShaderRead,
-        vk::PipelineStageFlagBits::eEarlyFragmentTests,
-        vk::PipelineStageFlagBits::eFragmentShader
-    );
+    m_CommandBuffer[CurrentFrame]->endRendering();
 }
 
 
@@ -199,6 +216,11 @@ void ShadowPass::CreateShadowResources(uint32_t Lights,
 
     m_ShadowSampler = std::make_unique<vk::raii::Sampler>(m_Device, samplerInfo);
 
+    // Same addressing without the compare, returns the stored depths for the PCSS blocker search
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = vk::CompareOp::eAlways;
+    m_ShadowDepthSampler = std::make_unique<vk::raii::Sampler>(m_Device, samplerInfo);
+
 
     vk::ImageCreateInfo imageInfo{};
     imageInfo.imageType = vk::ImageType::e2D;
@@ -206,7 +228,7 @@ void ShadowPass::CreateShadowResources(uint32_t Lights,
     imageInfo.extent.height = height;
     imageInfo.extent.depth = 1;
     imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
+    imageInfo.arrayLayers = ShadowCascadeCount;
     imageInfo.format = vk::Format::eD32Sfloat;
     imageInfo.tiling = vk::ImageTiling::eOptimal;
     imageInfo.initialLayout = vk::ImageLayout::eUndefined;
@@ -240,9 +262,27 @@ void ShadowPass::CreateShadowResources(uint32_t Lights,
             vk::Format::eD32Sfloat,
             vk::ImageAspectFlagBits::eDepth,
             tracker,
-            "ShadowMap"
+            "ShadowMap",
+            0,
+            vk::ImageViewType::e2DArray,
+            0,
+            1,
+            ShadowCascadeCount
         ));
 
+        // One attachment view per cascade layer
+        for (uint32_t cascade{}; cascade < ShadowCascadeCount; ++cascade) {
+            m_CascadeImageViews.emplace_back(ImageFactory::CreateImageView(
+                m_Device,
+                m_ShadowImageResource[idx].image,
+                vk::Format::eD32Sfloat,
+                vk::ImageAspectFlagBits::eDepth,
+                tracker,
+                "ShadowCascade",
+                cascade
+            ));
+        }
+
 
         m_ShadowImageResource[idx].imageAspectFlags = vk::ImageAspectFlagBits::eDepth;
         m_ShadowImageResource[idx].imageLayout = vk::ImageLayout::eUndefined;
@@ -253,6 +293,12 @@ void ShadowPass::CreateShadowResources(uint32_t Lights,
             tracker->UntrackImageView(m_ShadowImageView[idx]);
             vkDestroyImageView(*m_Device, m_ShadowImageView[idx], nullptr);
 
+            for (uint32_t cascade{}; cascade < ShadowCascadeCount; ++cascade) {
+                const vk::ImageView cascadeView = m_CascadeImageViews[idx * ShadowCascadeCount + cascade];
+                tracker->UntrackImageView(cascadeView);
+                vkDestroyImageView(*m_Device, cascadeView, nullptr);
+            }
+
             tracker->UntrackAllocation(m_ShadowImageResource[idx].allocation);
             vmaDestroyImage(Alloc, m_ShadowImageResource[idx].image, m_ShadowImageResource[idx].allocation);
         });
@@ -13,6 +13,10 @@
 #include "Factories/MeshFactory.h"
 #include "Factories/PipelineFactory.h"
 
+class GeometryPool;
+class IndirectDrawBuffer;
+class DescriptorSets;
+
 class ShadowPass {
 public:
     ShadowPass(const vk::raii::Device& device, const std::vector<std::unique_ptr<vk::raii::CommandBuffer>>& CommandBuffer ) : m_Device(device), m_CommandBuffer(CommandBuffer) {
@@ -27,31 +31,53 @@ public:
 
     void CreatePipeline(uint32_t shadowMapCount, vk::Format format);
 
-    void DoPass(uint32_t LightsIdx, uint32_t CurrentFrame, uint32_t width, uint32_t height);
+    // Moves every cascade of the light's map into the attachment layout, DoPass only renders the stale ones
+    void PrepareImageForWrite(uint32_t LightsIdx, uint32_t CurrentFrame);
+    // Back to DepthReadOnlyOptimal for the shadow mask pass
+    void PrepareImageForRead(uint32_t LightsIdx, uint32_t CurrentFrame);
+
+    // Draws the shadow list of this frame into one layer, ShadowView is light * ShadowCascadeCount + cascade and
+    // picks the matrix out of the frame's shadow views
+    void DoPass(uint32_t ShadowView, uint32_t CurrentFrame, uint32_t width, uint32_t height);
     void CreateShadowResources(uint32_t Lights, VmaAllocator allocator, std::deque<std::function<void(VmaAllocator)>> &deletionQueue, ResourceTracker
                                *tracker, uint32_t
                                width, uint32_t height);
 
     vk::PipelineLayout m_PipelineLayout;
-    std::vector<vk::DescriptorSet> m_DescriptorSets;
+    // Owned by DescriptorSets, the sets of the frame being recorded are bound
+    const DescriptorSets *m_DescriptorSets{};
+    // Owned by DescriptorSets, read at record time
+    const std::vector<uint32_t> *m_DynamicOffsets{};
 
     std::vector<vk::ImageView> GetImageView() const { return m_ShadowImageView; };
 	std::vector<ImageResource> GetImage() const { return m_ShadowImageResource; };
     vk::Sampler GetSampler() const { return **m_ShadowSampler; };
+    vk::Sampler GetDepthSampler() const { return **m_ShadowDepthSampler; };
 
-    void SetMeshes(const std::vector<Mesh>& Meshes) { m_Meshes = Meshes; };
+    void SetDrawBuffer(const IndirectDrawBuffer *Draws) { m_DrawBuffer = Draws; };
+    void SetGeometryPool(const GeometryPool *Pool) { m_GeometryPool = Pool; };
 private:
 
+    struct PushConstants {
+        uint32_t shadowView;
+    };
+
     const vk::raii::Device& m_Device;
     const std::vector<std::unique_ptr<vk::raii::CommandBuffer>>& m_CommandBuffer;
 
 
     std::vector<ImageResource> m_ShadowImageResource;
+    // Array views over all cascades, sampled by the lighting pass
     std::vector<vk::ImageView> m_ShadowImageView;
+    // Single layer attachment views, light * ShadowCascadeCount + cascade
+    std::vector<vk::ImageView> m_CascadeImageViews;
+    // Depth compare sampler for the filter taps, and a plain one that reads the stored depths
     std::unique_ptr<vk::raii::Sampler> m_ShadowSampler;
+    std::unique_ptr<vk::raii::Sampler> m_ShadowDepthSampler;
 
 
-    std::vector<Mesh> m_Meshes;
+    const IndirectDrawBuffer *m_DrawBuffer{};
+    const GeometryPool *m_GeometryPool{};
     std::unique_ptr<vk::raii::Pipeline> m_Pipeline;
     std::unique_ptr<PipelineFactory> m_PipelineFactory;
 };
@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <ostream>
+#include <utility>
 
 vk::raii::PhysicalDevice PhysicalDevicePicker::ChoosePhysicalDevice(const vk::raii::Instance& instance) {
     const std::vector<vk::raii::PhysicalDevice> PhysicalDevices = instance.enumeratePhysicalDevices();
@@ -58,6 +59,31 @@ bool PhysicalDevicePicker::SupportsExtension(const vk::raii::PhysicalDevice& Phy
     return true;
 }
 
+bool PhysicalDevicePicker::SupportsFeatures(const vk::raii::PhysicalDevice& PhysicalDevice) {
+    const auto Features = PhysicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+    const vk::PhysicalDeviceFeatures &Core = Features.get<vk::PhysicalDeviceFeatures2>().features;
+    const vk::PhysicalDeviceVulkan12Features &Vulkan12 = Features.get<vk::PhysicalDeviceVulkan12Features>();
+
+    // Indirect draws for the GPU culled scene, min reduction for the Hi-Z pyramid, timeline for the upload batches
+    const std::pair<const char*, vk::Bool32> RequiredFeatures[] = {
+        {"multiDrawIndirect", Core.multiDrawIndirect},
+        {"drawIndirectFirstInstance", Core.drawIndirectFirstInstance},
+        {"drawIndirectCount", Vulkan12.drawIndirectCount},
+        {"samplerFilterMinmax", Vulkan12.samplerFilterMinmax},
+        {"timelineSemaphore", Vulkan12.timelineSemaphore},
+    };
+
+    bool Supported = true;
+    for (const auto& [Name, bEnabled] : RequiredFeatures) {
+        if (!bEnabled) {
+            std::cout << "Feature NOT supported: " << Name << " on " << PhysicalDevice.getProperties().deviceName << "\n";
+            Supported = false;
+        }
+    }
+
+    return Supported;
+}
+
 bool PhysicalDevicePicker::IsDeviceSuitable(const vk::raii::PhysicalDevice& device,
                                             const std::vector<const char*>& requiredExtensions) {
 
@@ -66,6 +92,10 @@ bool PhysicalDevicePicker::IsDeviceSuitable(const vk::raii::PhysicalDevice& devi
         return false;
     }
 
+    if (!SupportsFeatures(device)) {
+        return false;
+    }
+
 
     return true;
 }
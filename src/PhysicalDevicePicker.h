@@ -20,6 +20,8 @@ public:
 
     static vk::raii::PhysicalDevice ChoosePhysicalDevice(const vk::raii::Instance& instance);
     static bool SupportsExtension(const vk::raii::PhysicalDevice &PhysicalDevice, const std::vector<const char *> &RequestedExtensions);
+    // The renderer relies on these without a fallback, LogicalDeviceFactory enables them unconditionally
+    static bool SupportsFeatures(const vk::raii::PhysicalDevice &PhysicalDevice);
     static bool IsDeviceSuitable(const vk::raii::PhysicalDevice &device, const std::vector<const char *> &requiredExtensions);
 private:
 
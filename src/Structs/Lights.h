@@ -8,7 +8,7 @@
 #include "glm/glm.hpp"
 
 struct PointLight {
-    glm::vec4 Position;
+    glm::vec4 Position; // w is the range, the light has no influence past it
     glm::vec4 Color;
 };
 
@@ -5,6 +5,10 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 #include "Buffer.h"
 
@@ -18,44 +22,102 @@ struct Material {
 };
 
 
+struct MeshBounds {
+    glm::vec3 min{ std::numeric_limits<float>::infinity() };
+    glm::vec3 max{ -std::numeric_limits<float>::infinity() };
+    // Bounding sphere centered on the box, tighter than half its diagonal
+    float radius{};
+};
+
+// Full precision vertex as it comes out of the importer, only lives on the CPU until it is packed
 struct Vertex {
     glm::vec3 pos;
-    glm::vec3 color;
     glm::vec2 texCoord;
     glm::vec3 normal;
     glm::vec3 tangent;
     glm::vec3 bitangent;
+};
+
+// Vertex streams of the GeometryPool, in binding order. Depth only pipelines bind a prefix of them:
+// shadows only the positions, the alpha tested prepass the texture coordinates as well.
+enum VertexStream : uint32_t {
+    PositionStream = 0,
+    TexCoordStream,
+    TangentFrameStream,
+    VertexStreamCount
+};
+
+// 20 byte vertex the GPU reads, see VulkanMath::PackVertex. Every member goes into its own VertexStream.
+// Position is 16 bit unorm inside the sub-mesh bounds, DrawData carries the offset and scale to undo it.
+// The tangent frame is an octahedral normal and tangent in 16 bit snorm, the bitangent is rebuilt from their cross
+// product and the handedness in position.w. Texture coordinates are half floats.
+struct PackedVertex {
+    uint16_t position[4];
+    uint16_t texCoord[2];
+    int16_t tangentFrame[4];
 
-    static vk::VertexInputBindingDescription getBindingDescription() {
-        return { 0, sizeof(Vertex), vk::VertexInputRate::eVertex };
+    static constexpr std::array<uint32_t, VertexStreamCount> StreamStrides{
+        4 * sizeof(uint16_t), 2 * sizeof(uint16_t), 4 * sizeof(int16_t)
+    };
+
+    // One binding per stream, from the first up to StreamCount
+    static std::vector<vk::VertexInputBindingDescription> getBindingDescriptions(uint32_t StreamCount = VertexStreamCount) {
+        std::vector<vk::VertexInputBindingDescription> bindings{};
+        for (uint32_t stream = 0; stream < StreamCount; ++stream) {
+            bindings.emplace_back(stream, StreamStrides[stream], vk::VertexInputRate::eVertex);
+        }
+        return bindings;
     }
 
-    static std::array<vk::VertexInputAttributeDescription, 6> getAttributeDescriptions() {
-        return {
-            vk::VertexInputAttributeDescription{ 0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, pos) },
-            vk::VertexInputAttributeDescription{ 1, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, color) },
-            vk::VertexInputAttributeDescription{ 2, 0, vk::Format::eR32G32Sfloat,    offsetof(Vertex, texCoord) },
-            vk::VertexInputAttributeDescription{ 3, 0, vk::Format::eR32G32B32Sfloat,    offsetof(Vertex, normal) },
-            vk::VertexInputAttributeDescription{ 4, 0, vk::Format::eR32G32B32Sfloat,    offsetof(Vertex, tangent) },
-            vk::VertexInputAttributeDescription{ 5, 0, vk::Format::eR32G32B32Sfloat,    offsetof(Vertex, bitangent) }
+    static std::vector<vk::VertexInputAttributeDescription> getAttributeDescriptions(uint32_t StreamCount = VertexStreamCount) {
+        const std::array<vk::VertexInputAttributeDescription, VertexStreamCount> attributes{
+            vk::VertexInputAttributeDescription{ 0, PositionStream,     vk::Format::eR16G16B16A16Unorm, 0 },
+            vk::VertexInputAttributeDescription{ 2, TexCoordStream,     vk::Format::eR16G16Sfloat,      0 },
+            vk::VertexInputAttributeDescription{ 1, TangentFrameStream, vk::Format::eR16G16B16A16Snorm, 0 }
         };
+        return { attributes.begin(), attributes.begin() + StreamCount };
     }
 
 };
 
-struct Mesh
-{
-    BufferInfo m_VertexBufferInfo;
-    VkDeviceSize m_VertexOffset{};
+// CPU-side description of one sub-mesh inside a model's shared vertex/index blobs.
+// Indices are local to the sub-mesh, material slots index the model's texture table.
+struct MeshRecord {
+    uint32_t firstVertex{};
+    uint32_t vertexCount{};
+    uint32_t firstIndex{};
+    uint32_t indexCount{};
+    Material material{};
+    MeshBounds bounds{};
+    // Cutout material, its depth has to come from the alpha tested prepass pipeline
+    bool bAlphaTested{};
+};
+
+// One entry of the per-draw SSBO (std430), indexed with the firstInstance of the matching indirect command
+struct DrawData {
+    Material material{};
+    int32_t padding[2]{};
+    // Dequantizes PackedVertex::position, object space = offset + unorm * scale
+    glm::vec4 positionOffset{};
+    glm::vec4 positionScale{};
+};
 
+// Culling input for one draw (std430), the AABB is stored as center + half extents
+struct DrawBounds {
+    glm::vec4 sphere{}; // xyz center, w radius
+    glm::vec4 extents{}; // w is 1 for alpha tested draws, the cull pass compacts them into their own lists
+};
 
-    BufferInfo m_IndexBufferInfo;
-    VkDeviceSize m_IndexOffset;
-    uint32_t m_IndexCount;
+struct Mesh
+{
+    // Offsets into the GeometryPool buffers, in vertices / indices
+    int32_t m_VertexOffset{};
+    uint32_t m_FirstIndex{};
+    uint32_t m_IndexCount{};
 
     Material m_Material;
-
-    std::vector<glm::vec3> m_Positions;
+    MeshBounds m_Bounds;
+    bool m_bAlphaTested{};
 };
 
 
@@ -11,9 +11,26 @@ struct alignas(16)  MVP {
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 proj;
     alignas(16) glm::vec3 cameraPos;
+    // Packed behind cameraPos like std140 does, the light arrays are sized at runtime
+    uint32_t pointLightCount;
+    uint32_t directionalLightCount;
+    // For the compute lighting path, so it does not invert per pixel
+    alignas(16) glm::mat4 invView;
+    alignas(16) glm::mat4 invProj;
 };
 
 struct alignas(16)  ShadowMVP {
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 proj;
-};
\ No newline at end of file
+};
+
+// Every directional light renders this many cascades into the layers of its shadow map
+static constexpr uint32_t ShadowCascadeCount = 4;
+
+// Head of the shadow view SSBO (ShadowViews in shadow.vert and shader.frag). It is followed by one proj * view
+// per shadow map layer, indexed light * ShadowCascadeCount + cascade
+struct alignas(16) ShadowViewsHeader {
+    // View space distance at which every cascade ends
+    alignas(16) glm::vec4 splitDepths;
+};
+static_assert(ShadowCascadeCount <= 4, "splitDepths holds one cascade per component");
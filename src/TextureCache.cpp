@@ -0,0 +1,555 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+#include "BlockEncoder.h"
+#include "Hash.h"
+#include "JobSystem.h"
+#include "stb_image.h"
+#include "Factories/ImageFactory.h"
+
+namespace {
+    constexpr uint8_t Ktx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+    constexpr std::string_view SourceKeyName = "VRSourceKey";
+    constexpr std::string_view SourceStampName = "VRSourceStamp";
+    constexpr std::string_view WriterName = "VulkanRasterizer texture cooker";
+
+    constexpr uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    uint32_t GetBlockBytes(TextureUsage usage) {
+        return usage == TextureUsage::Occlusion ? 8 : 16;
+    }
+
+    uint64_t GetLevelBytes(uint32_t width, uint32_t height, TextureUsage usage) {
+        const uint64_t blocksX = (width + BlockEncoder::BlockDim - 1) / BlockEncoder::BlockDim;
+        const uint64_t blocksY = (height + BlockEncoder::BlockDim - 1) / BlockEncoder::BlockDim;
+        return blocksX * blocksY * GetBlockBytes(usage);
+    }
+
+    float SrgbToLinear(uint8_t value) {
+        static const std::array<float, 256> table = [] {
+            std::array<float, 256> result{};
+            for (uint32_t i = 0; i < 256; ++i) {
+                const float c = static_cast<float>(i) / 255.0f;
+                result[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return result;
+        }();
+        return table[value];
+    }
+
+    uint8_t LinearToSrgb(float value) {
+        const float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+        return static_cast<uint8_t>(std::clamp(std::lround(c * 255.0f), 0l, 255l));
+    }
+
+    // 2x2 box filter down to the next level. Color is averaged in linear space, normals are renormalized
+    std::vector<uint8_t> Downsample(const std::vector<uint8_t> &source, uint32_t width, uint32_t height,
+                                    TextureUsage usage) {
+        const uint32_t nextWidth = std::max(width / 2, 1u);
+        const uint32_t nextHeight = std::max(height / 2, 1u);
+        std::vector<uint8_t> result(static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+        for (uint32_t y = 0; y < nextHeight; ++y) {
+            for (uint32_t x = 0; x < nextWidth; ++x) {
+                const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+                const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+                const uint8_t *texels[4] = {
+                    &source[(static_cast<size_t>(y0) * width + x0) * 4], &source[(static_cast<size_t>(y0) * width + x1) * 4],
+                    &source[(static_cast<size_t>(y1) * width + x0) * 4], &source[(static_cast<size_t>(y1) * width + x1) * 4]
+                };
+                uint8_t *out = &result[(static_cast<size_t>(y) * nextWidth + x) * 4];
+
+                for (int c = 0; c < 4; ++c) {
+                    out[c] = static_cast<uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+                }
+
+                if (usage == TextureUsage::Color) {
+                    for (int c = 0; c < 3; ++c) {
+                        const float sum = SrgbToLinear(texels[0][c]) + SrgbToLinear(texels[1][c]) +
+                                          SrgbToLinear(texels[2][c]) + SrgbToLinear(texels[3][c]);
+                        out[c] = LinearToSrgb(sum * 0.25f);
+                    }
+                } else if (usage == TextureUsage::Normal) {
+                    float n[3]{};
+                    for (const uint8_t *texel: texels) {
+                        for (int c = 0; c < 3; ++c) {
+                            n[c] += static_cast<float>(texel[c]) / 127.5f - 1.0f;
+                        }
+                    }
+                    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    if (length > 1e-6f) {
+                        for (int c = 0; c < 3; ++c) {
+                            out[c] = static_cast<uint8_t>(std::clamp(std::lround((n[c] / length + 1.0f) * 127.5f), 0l, 255l));
+                        }
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+    // Every block row is one job
+    std::vector<uint8_t> EncodeLevel(const std::vector<uint8_t> &rgba, uint32_t width, uint32_t height,
+                                     TextureUsage usage, JobSystem &jobs) {
+        constexpr uint32_t dim = BlockEncoder::BlockDim;
+        const uint32_t blocksX = (width + dim - 1) / dim;
+        const uint32_t blocksY = (height + dim - 1) / dim;
+        const uint32_t blockBytes = GetBlockBytes(usage);
+        std::vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * blockBytes);
+
+        jobs.ParallelFor(blocksY, [&](uint32_t blockY) {
+            uint8_t texels[BlockEncoder::TexelCount * 4];
+            uint8_t first[BlockEncoder::TexelCount], second[BlockEncoder::TexelCount];
+
+            for (uint32_t blockX = 0; blockX < blocksX; ++blockX) {
+                // Blocks hanging over the edge repeat the last row and column
+                for (uint32_t ty = 0; ty < dim; ++ty) {
+                    for (uint32_t tx = 0; tx < dim; ++tx) {
+                        const uint32_t sx = std::min(blockX * dim + tx, width - 1);
+                        const uint32_t sy = std::min(blockY * dim + ty, height - 1);
+                        std::memcpy(&texels[(ty * dim + tx) * 4], &rgba[(static_cast<size_t>(sy) * width + sx) * 4], 4);
+                    }
+                }
+
+                uint8_t *block = &blocks[(static_cast<size_t>(blockY) * blocksX + blockX) * blockBytes];
+                switch (usage) {
+                    case TextureUsage::Color:
+                        BlockEncoder::EncodeBC7(texels, block);
+                        break;
+                    case TextureUsage::Normal:
+                    case TextureUsage::MetallicRoughness: {
+                        // Normals keep X and Y, metallic/roughness moves its G and B down into R and G
+                        const uint32_t channel = usage == TextureUsage::Normal ? 0 : 1;
+                        for (uint32_t t = 0; t < BlockEncoder::TexelCount; ++t) {
+                            first[t] = texels[t * 4 + channel];
+                            second[t] = texels[t * 4 + channel + 1];
+                        }
+                        BlockEncoder::EncodeBC5(first, second, block);
+                        break;
+                    }
+                    case TextureUsage::Occlusion:
+                        for (uint32_t t = 0; t < BlockEncoder::TexelCount; ++t) {
+                            first[t] = texels[t * 4];
+                        }
+                        BlockEncoder::EncodeBC4(first, block);
+                        break;
+                }
+            }
+        });
+        return blocks;
+    }
+
+    // Khronos basic data format descriptor for the block format, a KTX2 file is invalid without one
+    std::vector<uint32_t> BuildDataFormatDescriptor(TextureUsage usage) {
+        struct Sample {
+            uint32_t bitOffset;
+            uint32_t bitLength;
+            uint32_t channel;
+        };
+
+        constexpr uint32_t ModelBC4 = 131, ModelBC5 = 132, ModelBC7 = 134;
+        constexpr uint32_t PrimariesBT709 = 1;
+        constexpr uint32_t TransferLinear = 1, TransferSrgb = 2;
+
+        uint32_t model = ModelBC7;
+        uint32_t transfer = TransferLinear;
+        std::vector<Sample> samples{};
+        switch (usage) {
+            case TextureUsage::Color:
+                transfer = TransferSrgb;
+                samples = {{0, 128, 0}};
+                break;
+            case TextureUsage::Normal:
+            case TextureUsage::MetallicRoughness:
+                model = ModelBC5;
+                samples = {{0, 64, 0}, {64, 64, 1}};
+                break;
+            case TextureUsage::Occlusion:
+                model = ModelBC4;
+                samples = {{0, 64, 0}};
+                break;
+        }
+
+        const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+        std::vector<uint32_t> words{
+            4 + blockSize,                               // total size
+            0,                                           // Khronos vendor, basic descriptor type
+            2 | (blockSize << 16),                       // version 1.3
+            model | (PrimariesBT709 << 8) | (transfer << 16),
+            (BlockEncoder::BlockDim - 1) | ((BlockEncoder::BlockDim - 1) << 8),
+            GetBlockBytes(usage),                        // bytes of plane 0
+            0
+        };
+        for (const Sample &sample: samples) {
+            words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+            words.push_back(0);
+            words.push_back(0);
+            words.push_back(0xFFFFFFFFu);
+        }
+        return words;
+    }
+
+    void AppendKeyValue(std::vector<uint8_t> &data, std::string_view key, const void *value, size_t valueSize) {
+        const uint32_t length = static_cast<uint32_t>(key.size() + 1 + valueSize);
+        const size_t start = data.size();
+        data.resize(start + AlignUp(sizeof(uint32_t) + length, 4));
+        std::memcpy(&data[start], &length, sizeof(uint32_t));
+        std::memcpy(&data[start + sizeof(uint32_t)], key.data(), key.size());
+        std::memcpy(&data[start + sizeof(uint32_t) + key.size() + 1], value, valueSize);
+    }
+
+    // Value of the entry with that key, empty if there is none
+    std::span<const std::byte> FindKeyValue(const std::byte *data, uint64_t size, std::string_view key) {
+        uint64_t position = 0;
+        while (position + sizeof(uint32_t) <= size) {
+            uint32_t length{};
+            std::memcpy(&length, data + position, sizeof(uint32_t));
+            if (length > size - position - sizeof(uint32_t)) {
+                break;
+            }
+
+            const auto *entry = reinterpret_cast<const char *>(data + position + sizeof(uint32_t));
+            if (length > key.size() && std::string_view(entry, key.size()) == key && entry[key.size()] == '\0') {
+                const std::byte *value = data + position + sizeof(uint32_t) + key.size() + 1;
+                return {value, length - key.size() - 1};
+            }
+            position += AlignUp(sizeof(uint32_t) + length, 4);
+        }
+        return {};
+    }
+
+    std::optional<uint64_t> FindSourceKey(const std::byte *data, uint64_t size) {
+        const std::span<const std::byte> value = FindKeyValue(data, size, SourceKeyName);
+        if (value.size() != sizeof(uint64_t)) {
+            return std::nullopt;
+        }
+
+        uint64_t key{};
+        std::memcpy(&key, value.data(), sizeof(uint64_t));
+        return key;
+    }
+
+    // Size and modification time of the source when its key was computed. While they still match, the key is
+    // trusted without reading and hashing the whole source again
+    struct SourceStamp {
+        uint64_t size;
+        int64_t writeTime;
+        uint32_t version;
+        uint32_t usage;
+
+        bool operator==(const SourceStamp &) const = default;
+    };
+
+    std::optional<SourceStamp> GetSourceStamp(const std::filesystem::path &sourcePath, TextureUsage usage) {
+        std::error_code error{};
+        const uint64_t size = std::filesystem::file_size(sourcePath, error);
+        if (error) {
+            return std::nullopt;
+        }
+        const std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(sourcePath, error);
+        if (error) {
+            return std::nullopt;
+        }
+
+        return SourceStamp{
+            size, static_cast<int64_t>(writeTime.time_since_epoch().count()), TextureCache::Version,
+            static_cast<uint32_t>(usage)
+        };
+    }
+
+    std::optional<SourceStamp> FindSourceStamp(const std::byte *data, uint64_t size) {
+        const std::span<const std::byte> value = FindKeyValue(data, size, SourceStampName);
+        if (value.size() != sizeof(SourceStamp)) {
+            return std::nullopt;
+        }
+
+        SourceStamp stamp{};
+        std::memcpy(&stamp, value.data(), sizeof(SourceStamp));
+        return stamp;
+    }
+}
+
+std::filesystem::path TextureCache::GetCachePath(const std::filesystem::path &sourcePath) {
+    std::filesystem::path cachePath = sourcePath;
+    cachePath += ".ktx2";
+    return cachePath;
+}
+
+uint64_t TextureCache::ComputeSourceKey(const std::filesystem::path &sourcePath, TextureUsage usage) {
+    uint64_t hash = Hash::OffsetBasis;
+    if (!Hash::File(hash, sourcePath)) {
+        return 0;
+    }
+
+    hash = Hash::Value(hash, usage);
+    hash = Hash::Value(hash, Version);
+    return hash;
+}
+
+vk::Format TextureCache::GetCookedFormat(TextureUsage usage) {
+    switch (usage) {
+        case TextureUsage::Color:
+            return vk::Format::eBc7SrgbBlock;
+        case TextureUsage::Normal:
+        case TextureUsage::MetallicRoughness:
+            return vk::Format::eBc5UnormBlock;
+        case TextureUsage::Occlusion:
+            return vk::Format::eBc4UnormBlock;
+    }
+    return vk::Format::eUndefined;
+}
+
+vk::ComponentMapping TextureCache::GetComponentMapping(TextureUsage usage) {
+    using CS = vk::ComponentSwizzle;
+
+    switch (usage) {
+        case TextureUsage::MetallicRoughness:
+            // Roughness is read from G and metallic from B
+            return {CS::eZero, CS::eR, CS::eG, CS::eOne};
+        case TextureUsage::Occlusion:
+            return {CS::eR, CS::eR, CS::eR, CS::eOne};
+        default:
+            return {};
+    }
+}
+
+std::optional<CookedTexture> TextureCache::Load(const std::filesystem::path &sourcePath, TextureUsage usage) {
+    const std::filesystem::path cachePath = GetCachePath(sourcePath);
+    if (!std::filesystem::exists(cachePath)) {
+        return std::nullopt;
+    }
+
+    auto mapping = std::make_unique<MappedFile>(cachePath);
+    if (!mapping->IsValid() || mapping->GetSize() < sizeof(Header)) {
+        std::cout << "Texture cache unreadable, decoding the source: " << cachePath << std::endl;
+        return std::nullopt;
+    }
+
+    Header header{};
+    std::memcpy(&header, mapping->GetData(), sizeof(Header));
+
+    if (std::memcmp(header.identifier, Ktx2Identifier, sizeof(Ktx2Identifier)) != 0 ||
+        header.vkFormat != static_cast<uint32_t>(GetCookedFormat(usage)) || header.supercompressionScheme != 0 ||
+        header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount != 0 ||
+        header.faceCount != 1 || header.levelCount == 0 ||
+        header.levelCount > ImageFactory::GetMipLevelCount(header.pixelWidth, header.pixelHeight)) {
+        std::cout << "Texture cache format mismatch, decoding the source: " << cachePath << std::endl;
+        return std::nullopt;
+    }
+
+    const uint64_t size = mapping->GetSize();
+    auto inRange = [size](uint64_t offset, uint64_t bytes) {
+        return offset <= size && bytes <= size - offset;
+    };
+
+    const std::byte *data = mapping->GetData();
+
+    std::optional<uint64_t> sourceKey{};
+    std::optional<SourceStamp> cookedStamp{};
+    if (inRange(header.kvdByteOffset, header.kvdByteLength)) {
+        sourceKey = FindSourceKey(data + header.kvdByteOffset, header.kvdByteLength);
+        cookedStamp = FindSourceStamp(data + header.kvdByteOffset, header.kvdByteLength);
+    }
+
+    // Only a source whose size or modification time changed is read and hashed
+    const std::optional<SourceStamp> sourceStamp = GetSourceStamp(sourcePath, usage);
+    const bool bStampCurrent = cookedStamp && sourceStamp && *cookedStamp == *sourceStamp;
+    if (!sourceKey || (!bStampCurrent && *sourceKey != ComputeSourceKey(sourcePath, usage))) {
+        std::cout << "Texture cache is stale, decoding the source: " << cachePath << std::endl;
+        return std::nullopt;
+    }
+    if (!bStampCurrent) {
+        std::cout << "Texture source was touched but not changed, --cook-textures refreshes its stamp: " << cachePath
+                  << std::endl;
+    }
+
+    if (!inRange(sizeof(Header), static_cast<uint64_t>(header.levelCount) * sizeof(LevelIndex))) {
+        std::cout << "Texture cache is corrupt, decoding the source: " << cachePath << std::endl;
+        return std::nullopt;
+    }
+
+    std::vector<LevelIndex> levels(header.levelCount);
+    std::memcpy(levels.data(), data + sizeof(Header), levels.size() * sizeof(LevelIndex));
+
+    uint64_t begin = size, end = 0;
+    for (uint32_t level = 0; level < header.levelCount; ++level) {
+        const uint32_t width = std::max(header.pixelWidth >> level, 1u);
+        const uint32_t height = std::max(header.pixelHeight >> level, 1u);
+        if (levels[level].byteLength != GetLevelBytes(width, height, usage) ||
+            !inRange(levels[level].byteOffset, levels[level].byteLength) ||
+            levels[level].byteOffset % GetBlockBytes(usage) != 0) {
+            std::cout << "Texture cache is corrupt, decoding the source: " << cachePath << std::endl;
+            return std::nullopt;
+        }
+        begin = std::min(begin, levels[level].byteOffset);
+        end = std::max(end, levels[level].byteOffset + levels[level].byteLength);
+    }
+
+    CookedTexture texture{};
+    texture.format = GetCookedFormat(usage);
+    texture.bStampCurrent = bStampCurrent;
+    texture.extent = vk::Extent2D{header.pixelWidth, header.pixelHeight};
+    for (const LevelIndex &level: levels) {
+        texture.levelOffsets.push_back(level.byteOffset - begin);
+    }
+    texture.data = {data + begin, static_cast<size_t>(end - begin)};
+    texture.mapping = std::move(mapping);
+
+    return texture;
+}
+
+uint64_t TextureCache::Cook(const std::filesystem::path &sourcePath, TextureUsage usage, JobSystem &jobs) {
+    // Taken before hashing, a source written in between then fails the stamp check and gets rehashed
+    const std::optional<SourceStamp> sourceStamp = GetSourceStamp(sourcePath, usage);
+    const uint64_t sourceKey = ComputeSourceKey(sourcePath, usage);
+    if (!sourceStamp || sourceKey == 0) {
+        std::cerr << "Failed to open texture for cooking: " << std::filesystem::absolute(sourcePath) << std::endl;
+        return 0;
+    }
+
+    int texWidth, texHeight, texChannels;
+    stbi_uc *pixels = stbi_load(sourcePath.string().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+    if (!pixels || texWidth == 0 || texHeight == 0) {
+        stbi_image_free(pixels);
+        std::cerr << "Failed to decode texture for cooking: " << std::filesystem::absolute(sourcePath) << std::endl;
+        return 0;
+    }
+
+    const uint32_t width = static_cast<uint32_t>(texWidth);
+    const uint32_t height = static_cast<uint32_t>(texHeight);
+    const uint32_t levelCount = ImageFactory::GetMipLevelCount(width, height);
+
+    std::vector<uint8_t> texels(pixels, pixels + static_cast<size_t>(width) * height * 4);
+    stbi_image_free(pixels);
+
+    std::vector<std::vector<uint8_t>> encoded(levelCount);
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        const uint32_t levelWidth = std::max(width >> level, 1u);
+        const uint32_t levelHeight = std::max(height >> level, 1u);
+        if (level > 0) {
+            texels = Downsample(texels, std::max(width >> (level - 1), 1u), std::max(height >> (level - 1), 1u), usage);
+        }
+        encoded[level] = EncodeLevel(texels, levelWidth, levelHeight, usage, jobs);
+    }
+
+    const std::vector<uint32_t> dfd = BuildDataFormatDescriptor(usage);
+
+    // Sorted by key, as the spec wants it
+    std::vector<uint8_t> kvd{};
+    AppendKeyValue(kvd, "KTXwriter", std::string(WriterName).c_str(), WriterName.size() + 1);
+    AppendKeyValue(kvd, SourceKeyName, &sourceKey, sizeof(sourceKey));
+    AppendKeyValue(kvd, SourceStampName, &*sourceStamp, sizeof(SourceStamp));
+
+    Header header{};
+    std::memcpy(header.identifier, Ktx2Identifier, sizeof(Ktx2Identifier));
+    header.vkFormat = static_cast<uint32_t>(GetCookedFormat(usage));
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    header.dfdByteOffset = static_cast<uint32_t>(sizeof(Header) + levelCount * sizeof(LevelIndex));
+    header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+    // Level data goes smallest mip first, every level aligned to its block size
+    std::vector<LevelIndex> levels(levelCount);
+    uint64_t fileSize = header.kvdByteOffset + header.kvdByteLength;
+    for (uint32_t level = levelCount; level-- > 0;) {
+        fileSize = AlignUp(fileSize, GetBlockBytes(usage));
+        levels[level] = {fileSize, encoded[level].size(), encoded[level].size()};
+        fileSize += encoded[level].size();
+    }
+
+    // Write next to the final file and swap it in, same as the mesh cache
+    const std::filesystem::path cachePath = GetCachePath(sourcePath);
+    std::filesystem::path tempPath = cachePath;
+    tempPath += ".tmp";
+
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open texture cache for writing: " << std::filesystem::absolute(tempPath) << std::endl;
+            return 0;
+        }
+
+        auto writeAt = [&file](uint64_t offset, const void *data, size_t size) {
+            static constexpr char zeros[16]{};
+            while (static_cast<uint64_t>(file.tellp()) < offset) {
+                file.write(zeros, static_cast<std::streamsize>(
+                               std::min<uint64_t>(sizeof(zeros), offset - static_cast<uint64_t>(file.tellp()))));
+            }
+            file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        };
+
+        writeAt(0, &header, sizeof(Header));
+        writeAt(sizeof(Header), levels.data(), levels.size() * sizeof(LevelIndex));
+        writeAt(header.dfdByteOffset, dfd.data(), header.dfdByteLength);
+        writeAt(header.kvdByteOffset, kvd.data(), kvd.size());
+        for (uint32_t level = levelCount; level-- > 0;) {
+            writeAt(levels[level].byteOffset, encoded[level].data(), encoded[level].size());
+        }
+
+        if (!file) {
+            std::cerr << "Failed to write texture cache: " << std::filesystem::absolute(tempPath) << std::endl;
+            return 0;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::cerr << "Failed to replace texture cache: " << ec.message() << std::endl;
+        std::filesystem::remove(tempPath, ec);
+        return 0;
+    }
+
+    return fileSize;
+}
+
+bool TextureCache::RefreshSourceStamp(const std::filesystem::path &sourcePath, TextureUsage usage) {
+    const std::optional<SourceStamp> sourceStamp = GetSourceStamp(sourcePath, usage);
+    if (!sourceStamp) {
+        return false;
+    }
+
+    std::fstream file(GetCachePath(sourcePath), std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    Header header{};
+    std::vector<std::byte> kvd{};
+    if (file.read(reinterpret_cast<char *>(&header), sizeof(Header))) {
+        kvd.resize(header.kvdByteLength);
+        file.seekg(header.kvdByteOffset);
+        file.read(reinterpret_cast<char *>(kvd.data()), static_cast<std::streamsize>(kvd.size()));
+    }
+    if (!file) {
+        return false;
+    }
+
+    // Same size as before, only the value bytes are overwritten
+    const std::span<const std::byte> value = FindKeyValue(kvd.data(), kvd.size(), SourceStampName);
+    if (value.size() != sizeof(SourceStamp)) {
+        return false;
+    }
+
+    file.seekp(header.kvdByteOffset + (value.data() - kvd.data()));
+    file.write(reinterpret_cast<const char *>(&*sourceStamp), sizeof(SourceStamp));
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,89 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "MeshCache.h"
+
+// Every mip level of a cooked texture, straight out of the mapped KTX2 file
+struct CookedTexture {
+    vk::Format format{};
+    vk::Extent2D extent{};
+    // Offsets into data, one per level starting at mip 0. The levels are tightly packed blocks
+    std::vector<vk::DeviceSize> levelOffsets{};
+    std::span<const std::byte> data{};
+    std::unique_ptr<MappedFile> mapping{};
+    // False when the source had to be hashed because its size or modification time changed since cooking
+    bool bStampCurrent{ true };
+};
+
+// Block compressed copies of the material textures, stored as KTX2 next to the source image with the whole mip
+// chain baked in. Color maps become BC7, normals and metallic/roughness BC5, occlusion BC4.
+// Cooking is an offline step (--cook-textures), loading only accepts a file whose source key still matches.
+class TextureCache {
+public:
+    static constexpr uint32_t Version = 2;
+
+    static std::filesystem::path GetCachePath(const std::filesystem::path &sourcePath);
+
+    // Hash of the source image, its usage and the cooker version. Cooked files also store the source's size and
+    // modification time, Load only recomputes the key when those changed
+    static uint64_t ComputeSourceKey(const std::filesystem::path &sourcePath, TextureUsage usage);
+
+    static vk::Format GetCookedFormat(TextureUsage usage);
+
+    // Puts the cooked channels back where the shaders read them from the uncompressed source
+    static vk::ComponentMapping GetComponentMapping(TextureUsage usage);
+
+    static std::optional<CookedTexture> Load(const std::filesystem::path &sourcePath, TextureUsage usage);
+
+    // Decodes the source, filters the mip chain, encodes the blocks of every level on the job system and writes the
+    // file. Returns the size of the cooked file, 0 on failure
+    static uint64_t Cook(const std::filesystem::path &sourcePath, TextureUsage usage, class JobSystem &jobs);
+
+    // Rewrites the stored size and modification time of a cooked file whose source was touched but still hashes the
+    // same, so the next Load skips the hash again. The file must not be mapped
+    static bool RefreshSourceStamp(const std::filesystem::path &sourcePath, TextureUsage usage);
+
+private:
+    // KTX2 file header, followed by one LevelIndex per mip
+    struct Header {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct LevelIndex {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+};
+
+
+#endif //TEXTURECACHE_H
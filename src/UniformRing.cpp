@@ -0,0 +1,61 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "UniformRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "ResourceTracker.h"
+
+namespace {
+    constexpr vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+UniformRing::UniformRing(VmaAllocator allocator, ResourceTracker *tracker, const vk::PhysicalDeviceLimits &limits,
+                         uint32_t framesInFlight, vk::DeviceSize frameSize)
+    : m_Allocator(allocator)
+      , m_AllocationTracker(tracker)
+      , m_Buffer(std::make_unique<Buffer>()) {
+    // Lights are bound from the ring as storage buffers, so offsets have to satisfy both limits
+    m_Alignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+    m_FrameSize = AlignUp(frameSize, m_Alignment);
+
+    m_Ring = m_Buffer->CreateMapped(m_Allocator, m_FrameSize * framesInFlight,
+                                    vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer |
+                                    vk::BufferUsageFlagBits::eTransferSrc,
+                                    VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                    VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+                                    m_AllocationTracker, "UniformRing");
+}
+
+void UniformRing::BeginFrame(uint32_t frame) {
+    m_FrameBegin = m_FrameSize * frame;
+    m_Head = m_FrameBegin;
+}
+
+std::byte *UniformRing::Allocate(vk::DeviceSize size, uint32_t &Offset) {
+    const vk::DeviceSize offset = AlignUp(m_Head, m_Alignment);
+    if (offset + size > m_FrameBegin + m_FrameSize) {
+        throw std::runtime_error("Uniform ring frame slice is full!");
+    }
+
+    m_Head = offset + size;
+    Offset = static_cast<uint32_t>(offset);
+    return static_cast<std::byte *>(m_Ring.m_MappedData) + offset;
+}
+
+uint32_t UniformRing::Push(const void *data, vk::DeviceSize size) {
+    uint32_t offset{};
+    std::memcpy(Allocate(size, offset), data, size);
+    return offset;
+}
+
+void UniformRing::Destroy() {
+    Buffer::Destroy(m_Allocator, m_Ring.m_Buffer, m_Ring.m_Allocation, m_AllocationTracker);
+    m_Ring = {};
+}
@@ -0,0 +1,64 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef UNIFORMRING_H
+#define UNIFORMRING_H
+
+#include <cstddef>
+#include <memory>
+
+#include <vulkan/vulkan.hpp>
+#include <vk_mem_alloc.h>
+
+#include "Buffer.h"
+
+class ResourceTracker;
+
+// One persistently mapped buffer split into a slice per frame in flight. Per-frame constants (camera, shadow
+// matrices, lights) are pushed into the current slice and bound with dynamic offsets, so the CPU never writes
+// memory a frame still in flight reads. A slice is rewound in BeginFrame, after the fence of its frame was waited on.
+// The ring doubles as staging memory for small per-frame copies into device local buffers.
+class UniformRing {
+public:
+    static constexpr vk::DeviceSize DefaultFrameSize = 256 * 1024;
+
+    UniformRing(VmaAllocator allocator, ResourceTracker *tracker, const vk::PhysicalDeviceLimits &limits,
+                uint32_t framesInFlight, vk::DeviceSize frameSize = DefaultFrameSize);
+    virtual ~UniformRing() = default;
+
+    UniformRing(const UniformRing&) = delete;
+    UniformRing(UniformRing&&) noexcept = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+    UniformRing& operator=(UniformRing&&) noexcept = delete;
+
+    void BeginFrame(uint32_t frame);
+
+    // Reserves size bytes in the current slice for the caller to fill, Offset is the dynamic offset to bind it with
+    std::byte *Allocate(vk::DeviceSize size, uint32_t &Offset);
+
+    // Copies the data into the current slice, the result is the dynamic offset to bind it with
+    uint32_t Push(const void *data, vk::DeviceSize size);
+
+    template<typename T>
+    uint32_t Push(const T &value) { return Push(&value, sizeof(T)); }
+
+    [[nodiscard]] const BufferInfo &GetBuffer() const { return m_Ring; }
+
+    void Destroy();
+
+private:
+    VmaAllocator m_Allocator{};
+    ResourceTracker *m_AllocationTracker{};
+
+    std::unique_ptr<Buffer> m_Buffer{};
+    BufferInfo m_Ring{};
+
+    vk::DeviceSize m_Alignment{};
+    vk::DeviceSize m_FrameSize{};
+    vk::DeviceSize m_FrameBegin{};
+    vk::DeviceSize m_Head{};
+};
+
+
+#endif //UNIFORMRING_H
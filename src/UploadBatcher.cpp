@@ -0,0 +1,289 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#include "UploadBatcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "ResourceTracker.h"
+#include "Factories/ImageFactory.h"
+
+namespace {
+    constexpr vk::DeviceSize StagingAlignment = 16;
+
+    constexpr vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+UploadBatcher::UploadBatcher(const vk::raii::Device &device, VmaAllocator allocator, vk::Queue queue,
+                             uint32_t queueFamilyIndex, ResourceTracker *tracker, vk::DeviceSize stagingSize)
+    : m_Device(device)
+      , m_Allocator(allocator)
+      , m_Queue(queue)
+      , m_AllocationTracker(tracker)
+      , m_Buffer(std::make_unique<Buffer>()) {
+    m_Staging = m_Buffer->CreateMapped(m_Allocator, stagingSize,
+                                       vk::BufferUsageFlagBits::eTransferSrc,
+                                       VMA_MEMORY_USAGE_AUTO,
+                                       VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+                                       m_AllocationTracker, "UploadStagingRing");
+    m_Capacity = stagingSize;
+
+    vk::CommandPoolCreateInfo poolInfo{};
+    poolInfo.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer | vk::CommandPoolCreateFlagBits::eTransient);
+    poolInfo.setQueueFamilyIndex(queueFamilyIndex);
+    m_CommandPool = std::make_unique<vk::raii::CommandPool>(m_Device, poolInfo);
+
+    vk::SemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+    timelineInfo.initialValue = 0;
+
+    vk::SemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.pNext = &timelineInfo;
+    m_Timeline = std::make_unique<vk::raii::Semaphore>(m_Device, semaphoreInfo);
+
+    vk::DebugUtilsObjectNameInfoEXT nameInfo{};
+    nameInfo.pObjectName = "Upload timeline";
+    nameInfo.objectType = vk::ObjectType::eSemaphore;
+    nameInfo.objectHandle = uint64_t(static_cast<VkSemaphore>(**m_Timeline));
+    m_Device.setDebugUtilsObjectNameEXT(nameInfo);
+}
+
+void UploadBatcher::UploadBuffer(vk::Buffer dst, const void *data, vk::DeviceSize size, vk::DeviceSize dstOffset) {
+    const auto *src = static_cast<const std::byte *>(data);
+
+    // Anything bigger than the ring goes through in ring-sized pieces
+    while (size > 0) {
+        const vk::DeviceSize chunk = std::min(size, m_Capacity);
+
+        const StagingAllocation staging = Allocate(chunk, StagingAlignment);
+        std::memcpy(staging.mapped, src, chunk);
+
+        vk::BufferCopy region{};
+        region.srcOffset = staging.offset;
+        region.dstOffset = dstOffset;
+        region.size = chunk;
+        GetCommandBuffer().copyBuffer(staging.buffer, dst, region);
+
+        src += chunk;
+        dstOffset += chunk;
+        size -= chunk;
+    }
+}
+
+void UploadBatcher::UploadImage(ImageResource &image, const void *data, vk::DeviceSize size) {
+    const vk::DeviceSize baseLevel[] = {0};
+    UploadImage(image, data, size, baseLevel);
+}
+
+void UploadBatcher::UploadImage(ImageResource &image, const void *data, vk::DeviceSize size,
+                                std::span<const vk::DeviceSize> levelOffsets) {
+    StagingAllocation staging{};
+
+    if (size > m_Capacity) {
+        // Images can't be split the same way as buffers, give the oversized ones their own staging buffer
+        BufferInfo dedicated = m_Buffer->CreateMapped(m_Allocator, size,
+                                                      vk::BufferUsageFlagBits::eTransferSrc,
+                                                      VMA_MEMORY_USAGE_AUTO,
+                                                      VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
+                                                      m_AllocationTracker, "UploadDedicatedStaging");
+        std::memcpy(dedicated.m_MappedData, data, size);
+
+        GetCommandBuffer();
+        m_Current.dedicatedStaging.push_back(dedicated);
+        staging = {dedicated.m_Buffer, 0, static_cast<std::byte *>(dedicated.m_MappedData)};
+    } else {
+        staging = Allocate(size, StagingAlignment);
+        std::memcpy(staging.mapped, data, size);
+    }
+
+    vk::CommandBuffer cmd = GetCommandBuffer();
+
+    ImageFactory::ShiftImageLayout(
+        cmd, image,
+        vk::ImageLayout::eTransferDstOptimal,
+        vk::AccessFlags(),
+        vk::AccessFlagBits::eTransferWrite,
+        vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eTransfer);
+
+    std::vector<vk::BufferImageCopy> copyRegions(levelOffsets.size());
+    for (uint32_t level = 0; level < copyRegions.size(); ++level) {
+        vk::BufferImageCopy &copyRegion = copyRegions[level];
+        copyRegion.bufferOffset = staging.offset + levelOffsets[level];
+        copyRegion.bufferRowLength = 0;
+        copyRegion.bufferImageHeight = 0;
+        copyRegion.imageSubresource.aspectMask = image.imageAspectFlags;
+        copyRegion.imageSubresource.mipLevel = level;
+        copyRegion.imageSubresource.baseArrayLayer = 0;
+        copyRegion.imageSubresource.layerCount = 1;
+        copyRegion.imageExtent = vk::Extent3D{
+            std::max(image.extent.width >> level, 1u), std::max(image.extent.height >> level, 1u), 1
+        };
+    }
+
+    cmd.copyBufferToImage(staging.buffer, image.image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+
+    if (image.mipLevels > copyRegions.size()) {
+        ImageFactory::RecordMipChain(cmd, image);
+    } else {
+        ImageFactory::ShiftImageLayout(
+            cmd, image,
+            vk::ImageLayout::eShaderReadOnlyOptimal,
+            vk::AccessFlagBits::eTransferWrite,
+            vk::AccessFlagBits::eShaderRead,
+            vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eFragmentShader);
+    }
+}
+
+uint64_t UploadBatcher::Flush() {
+    if (!m_bRecording) {
+        return m_SubmittedValue;
+    }
+
+    m_Current.commandBuffer->end();
+
+    m_Current.signalValue = ++m_SubmittedValue;
+
+    vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.setSignalSemaphoreValues(m_Current.signalValue);
+
+    vk::CommandBuffer cmd = **m_Current.commandBuffer;
+    vk::Semaphore timeline = **m_Timeline;
+
+    vk::SubmitInfo submitInfo{};
+    submitInfo.setCommandBuffers(cmd);
+    submitInfo.setSignalSemaphores(timeline);
+    submitInfo.pNext = &timelineInfo;
+
+    m_Queue.submit(submitInfo);
+
+    m_InFlight.push_back(std::move(m_Current));
+    m_Current = {};
+    m_bRecording = false;
+
+    return m_SubmittedValue;
+}
+
+void UploadBatcher::WaitIdle() {
+    Flush();
+
+    while (!m_InFlight.empty()) {
+        RetireBatches(true);
+    }
+}
+
+void UploadBatcher::Destroy() {
+    WaitIdle();
+
+    m_FreeCommandBuffers.clear();
+
+    if (m_Staging.m_Buffer) {
+        Buffer::Destroy(m_Allocator, m_Staging.m_Buffer, m_Staging.m_Allocation, m_AllocationTracker);
+        m_Staging = {};
+    }
+}
+
+UploadBatcher::StagingAllocation UploadBatcher::Allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+    vk::DeviceSize offset{};
+
+    while (!TryAllocateFromRing(size, alignment, offset)) {
+        // Hand what we recorded so far to the GPU, then block on the oldest batch to get its ring space back
+        Flush();
+
+        if (m_InFlight.empty()) {
+            throw std::runtime_error("Upload does not fit into the staging ring!");
+        }
+        RetireBatches(true);
+    }
+
+    return {m_Staging.m_Buffer, offset, static_cast<std::byte *>(m_Staging.m_MappedData) + offset};
+}
+
+bool UploadBatcher::TryAllocateFromRing(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize &offset) {
+    if (m_Used == 0) {
+        m_Head = 0;
+    }
+
+    vk::DeviceSize aligned = AlignUp(m_Head, alignment);
+    vk::DeviceSize padding = aligned - m_Head;
+
+    // Not enough room before the end of the ring, skip the tail and start over at 0
+    if (aligned + size > m_Capacity) {
+        padding = m_Capacity - m_Head;
+        aligned = 0;
+    }
+
+    if (m_Used + padding + size > m_Capacity) {
+        return false;
+    }
+
+    offset = aligned;
+    m_Head = aligned + size;
+    m_Used += padding + size;
+    m_Current.ringBytes += padding + size;
+    return true;
+}
+
+vk::CommandBuffer UploadBatcher::GetCommandBuffer() {
+    if (!m_bRecording) {
+        RetireBatches(false);
+
+        if (m_FreeCommandBuffers.empty()) {
+            vk::CommandBufferAllocateInfo allocInfo{};
+            allocInfo.setCommandPool(**m_CommandPool);
+            allocInfo.setCommandBufferCount(1);
+            allocInfo.level = vk::CommandBufferLevel::ePrimary;
+
+            m_FreeCommandBuffers.emplace_back(
+                std::make_unique<vk::raii::CommandBuffer>(std::move(m_Device.allocateCommandBuffers(allocInfo).front())));
+        }
+
+        m_Current.commandBuffer = std::move(m_FreeCommandBuffers.back());
+        m_FreeCommandBuffers.pop_back();
+
+        m_Current.commandBuffer->begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        m_bRecording = true;
+    }
+
+    return **m_Current.commandBuffer;
+}
+
+void UploadBatcher::RetireBatches(bool waitForOldest) {
+    if (m_InFlight.empty()) {
+        return;
+    }
+
+    if (waitForOldest) {
+        vk::Semaphore timeline = **m_Timeline;
+        const uint64_t value = m_InFlight.front().signalValue;
+
+        vk::SemaphoreWaitInfo waitInfo{};
+        waitInfo.setSemaphores(timeline);
+        waitInfo.setValues(value);
+
+        if (m_Device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess) {
+            std::cerr << "Failed to wait for upload batch " << value << std::endl;
+        }
+    }
+
+    const uint64_t completed = m_Timeline->getCounterValue();
+
+    while (!m_InFlight.empty() && m_InFlight.front().signalValue <= completed) {
+        Batch &batch = m_InFlight.front();
+
+        m_Used -= batch.ringBytes;
+        for (const BufferInfo &staging: batch.dedicatedStaging) {
+            Buffer::Destroy(m_Allocator, staging.m_Buffer, staging.m_Allocation, m_AllocationTracker);
+        }
+
+        batch.commandBuffer->reset();
+        m_FreeCommandBuffers.push_back(std::move(batch.commandBuffer));
+        m_InFlight.pop_front();
+    }
+}
@@ -0,0 +1,102 @@
+//
+// Created by capma on 10/17/2026.
+//
+
+#ifndef UPLOADBATCHER_H
+#define UPLOADBATCHER_H
+
+#include <deque>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.h>
+
+#include "Buffer.h"
+
+struct ImageResource;
+class ResourceTracker;
+
+// Records buffer and image uploads from a persistent, mapped ring of staging memory into a few command buffers.
+// Each Flush() is one queue submission that signals a timeline semaphore, consumers wait on that value on the GPU
+// instead of the CPU waiting for every copy.
+class UploadBatcher {
+public:
+    static constexpr vk::DeviceSize DefaultStagingSize = 64ull * 1024 * 1024;
+
+    UploadBatcher(const vk::raii::Device &device, VmaAllocator allocator, vk::Queue queue, uint32_t queueFamilyIndex,
+                  ResourceTracker *tracker, vk::DeviceSize stagingSize = DefaultStagingSize);
+    virtual ~UploadBatcher() = default;
+
+    UploadBatcher(const UploadBatcher&) = delete;
+    UploadBatcher(UploadBatcher&&) noexcept = delete;
+    UploadBatcher& operator=(const UploadBatcher&) = delete;
+    UploadBatcher& operator=(UploadBatcher&&) noexcept = delete;
+
+    void UploadBuffer(vk::Buffer dst, const void *data, vk::DeviceSize size, vk::DeviceSize dstOffset = 0);
+
+    // Copies tightly packed texels into mip 0 and leaves the image in ShaderReadOnlyOptimal. Images with more than one
+    // mip get the rest of their chain blitted down from it in the same command buffer
+    void UploadImage(ImageResource &image, const void *data, vk::DeviceSize size);
+
+    // Same for a prebuilt chain, data holds every level at the given offsets starting with mip 0
+    void UploadImage(ImageResource &image, const void *data, vk::DeviceSize size,
+                     std::span<const vk::DeviceSize> levelOffsets);
+
+    // Submits everything recorded so far, returns the timeline value that is signaled once it completed
+    uint64_t Flush();
+
+    void WaitIdle();
+
+    // Waits for all uploads and releases the staging memory, call before the allocator is destroyed
+    void Destroy();
+
+    [[nodiscard]] vk::Semaphore GetSemaphore() const { return **m_Timeline; }
+    [[nodiscard]] uint64_t GetSubmittedValue() const { return m_SubmittedValue; }
+
+private:
+    struct StagingAllocation {
+        vk::Buffer buffer{};
+        vk::DeviceSize offset{};
+        std::byte *mapped{};
+    };
+
+    struct Batch {
+        std::unique_ptr<vk::raii::CommandBuffer> commandBuffer{};
+        uint64_t signalValue{};
+        vk::DeviceSize ringBytes{};
+        std::vector<BufferInfo> dedicatedStaging{};
+    };
+
+    StagingAllocation Allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+    bool TryAllocateFromRing(vk::DeviceSize size, vk::DeviceSize alignment, vk::DeviceSize &offset);
+
+    vk::CommandBuffer GetCommandBuffer();
+
+    void RetireBatches(bool waitForOldest);
+
+    const vk::raii::Device &m_Device;
+    VmaAllocator m_Allocator{};
+    vk::Queue m_Queue{};
+    ResourceTracker *m_AllocationTracker{};
+
+    std::unique_ptr<Buffer> m_Buffer{};
+    BufferInfo m_Staging{};
+    vk::DeviceSize m_Capacity{};
+    vk::DeviceSize m_Head{};
+    vk::DeviceSize m_Used{};
+
+    std::unique_ptr<vk::raii::CommandPool> m_CommandPool{};
+    std::unique_ptr<vk::raii::Semaphore> m_Timeline{};
+    uint64_t m_SubmittedValue{};
+
+    Batch m_Current{};
+    bool m_bRecording{ false };
+    std::deque<Batch> m_InFlight{};
+    std::vector<std::unique_ptr<vk::raii::CommandBuffer>> m_FreeCommandBuffers{};
+};
+
+
+#endif //UPLOADBATCHER_H
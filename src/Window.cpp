@@ -9,7 +9,13 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_FORCE_RADIANS
 #define GLM_ENABLE_EXPERIMENTAL
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
 #include <ranges>
+#include <string>
 
 #include "Buffer.h"
 #include "PhysicalDevicePicker.h"
@@ -29,6 +35,21 @@ static const glm::mat4 kClipBias = glm::mat4(
     0.0f, 0.0f, 0.5f, 1.0f
 );
 
+static const char *ShadowFilterName(ShadowMaskPass::ShadowFilter Filter) {
+    switch (Filter) {
+        case ShadowMaskPass::ShadowFilter::PCSS:
+            return "PCSS";
+        default:
+            return "PCF tent";
+    }
+}
+
+static std::string FormatMilliseconds(double Milliseconds) {
+    char text[16]{};
+    std::snprintf(text, sizeof(text), "%.2f", Milliseconds);
+    return text;
+}
+
 
 VulkanWindow::VulkanWindow(vk::raii::Context &context)
 // Factories
@@ -65,8 +86,84 @@ void VulkanWindow::MainLoop() {
         ProcessInput(m_Window, static_cast<float>(deltaTime));
         DrawFrame();
 
-        m_GraphicsQueue->waitIdle();
+        if (m_BenchmarkFrames > 0 && RecordBenchmarkFrame(currentTime)) {
+            glfwSetWindowShouldClose(m_Window, GLFW_TRUE);
+        }
+
+        if (currentTime - lastStatsTime > 0.5) {
+            lastStatsTime = currentTime;
+
+            const CullPass::Stats &stats = m_CullPass->GetStats();
+            const uint32_t occlusionRate = stats.inFrustum ? stats.occluded * 100 / stats.inFrustum : 0;
+            const std::string title = "Vulkan | drawn " + std::to_string(stats.drawn) + " (" +
+                                      std::to_string(stats.alphaTested) + " alpha tested) / culled " +
+                                      std::to_string(stats.culled) + " / occluded " +
+                                      std::to_string(stats.occluded) + " meshes (" +
+                                      std::to_string(occlusionRate) + "% of the frustum rejected by Hi-Z) | " +
+                                      std::to_string(m_ShadowMapsRedrawn) + " shadow cascades redrawn (" +
+                                      std::to_string(m_ShadowCastersDrawn) + " casters) | " +
+                                      std::to_string(m_LightManager->GetLightCount()) + " point lights, clusters " +
+                                      FormatMilliseconds(m_GpuTimer->GetMilliseconds(GpuTimer::LightCulling)) +
+                                      " ms | " + (m_bComputeLighting ? "compute" : "fragment") + " lighting (C) | " +
+                                      ShadowFilterName(m_ShadowMaskPass->GetShadowFilter()) + " (F) mask " +
+                                      FormatMilliseconds(m_GpuTimer->GetMilliseconds(GpuTimer::ShadowMask)) +
+                                      " ms, lighting " +
+                                      FormatMilliseconds(m_GpuTimer->GetMilliseconds(GpuTimer::Lighting)) +
+                                      " ms, shadows " +
+                                      FormatMilliseconds(m_GpuTimer->GetMilliseconds(GpuTimer::Shadows)) +
+                                      " ms, geometry " +
+                                      FormatMilliseconds(m_GpuTimer->GetMilliseconds(GpuTimer::Geometry)) +
+                                      " ms, gbuffer " +
+                                      FormatMilliseconds(m_GpuTimer->GetMilliseconds(GpuTimer::GBuffer)) + " ms (" +
+                                      std::to_string(GBufferPass::BytesPerPixel) + " B/px)";
+            m_ShadowMapsRedrawn = 0;
+            m_ShadowCastersDrawn = 0;
+            glfwSetWindowTitle(m_Window, title.c_str());
+        }
+    }
+
+    // Frames stay in flight while the loop runs, drain them before anything gets destroyed
+    m_Device->waitIdle();
+}
+
+bool VulkanWindow::RecordBenchmarkFrame(double FrameStart) {
+    // Skip the first frames, they still include pipeline warmup and the first upload batches
+    constexpr uint32_t WarmupFrames = 60;
+
+    ++m_BenchmarkFrameIndex;
+    if (m_BenchmarkFrameIndex <= WarmupFrames) {
+        return false;
+    }
+
+    const uint32_t measured = m_BenchmarkFrameIndex - WarmupFrames;
+    if (measured <= m_BenchmarkFrames) {
+        m_PipelinedFrameTimes.push_back((glfwGetTime() - FrameStart) * 1000.0);
+        return false;
     }
+
+    // Second half reproduces the old loop: the CPU waits for the GPU after every frame
+    m_GraphicsQueue->waitIdle();
+    m_SerializedFrameTimes.push_back((glfwGetTime() - FrameStart) * 1000.0);
+    if (measured < 2 * m_BenchmarkFrames) {
+        return false;
+    }
+
+    auto report = [](const char *label, std::vector<double> times) {
+        std::ranges::sort(times);
+        double total = 0.0;
+        for (double time: times) {
+            total += time;
+        }
+        const double average = total / static_cast<double>(times.size());
+        std::cout << label << ": avg " << average << " ms (" << 1000.0 / average << " fps), median "
+                << times[times.size() / 2] << " ms, p99 " << times[times.size() * 99 / 100] << " ms" << std::endl;
+    };
+
+    std::cout << "\n--- Frame benchmark: " << m_BenchmarkFrames << " frames each, " << m_FramesInFlight
+            << " frames in flight ---" << std::endl;
+    report("pipelined ", m_PipelinedFrameTimes);
+    report("serialized", m_SerializedFrameTimes);
+    return true;
 }
 
 void VulkanWindow::Cleanup() {
@@ -112,53 +209,91 @@ void VulkanWindow::UpdateUBO() {
     const float aspectRatio = m_CurrentScreenSize.x / m_CurrentScreenSize.y;
     ubo.proj = m_Camera->GetProjectionMatrix(aspectRatio);
     ubo.cameraPos = m_Camera->position;
+    ubo.pointLightCount = m_LightManager->GetSlotCount();
+    ubo.directionalLightCount = static_cast<uint32_t>(m_DirectionalLights.size());
+    ubo.invView = glm::inverse(ubo.view);
+    ubo.invProj = glm::inverse(ubo.proj);
 
-    Buffer::UploadData(m_UniformBufferInfo, &ubo, sizeof(ubo));
-}
+    m_DescriptorSets->SetDynamicOffset(DescriptorSets::MVPOffset, m_UniformRing->Push(ubo));
 
-void VulkanWindow::UpdateShadowUBO(uint32_t LightIdx) {
-    // use the first directional light in your array
-    glm::vec3 lightDir = glm::normalize(glm::vec3(m_DirectionalLights[LightIdx].Direction));
+    m_CameraClip = ubo.proj * ubo.view * ubo.model;
+}
 
-    glm::vec3 sceneMin, sceneMax;
-    std::tie(sceneMin, sceneMax) = VulkanMath::ComputeSceneAABB(m_Meshes);
-    glm::vec3 sceneCenter = 0.5f * (sceneMin + sceneMax);
+std::array<float, ShadowCascadeCount + 1> VulkanWindow::ComputeCascadeSplits() const {
+    // Practical split scheme, mostly logarithmic so the near cascades stay small
+    constexpr float lambda = 0.75f;
+    const float nearPlane = m_Camera->GetNearPlane();
+    const float farPlane = m_Camera->GetFarPlane();
+
+    std::array<float, ShadowCascadeCount + 1> splits{};
+    splits[0] = nearPlane;
+    for (uint32_t cascade = 1; cascade <= ShadowCascadeCount; ++cascade) {
+        const float p = static_cast<float>(cascade) / static_cast<float>(ShadowCascadeCount);
+        const float logSplit = nearPlane * std::pow(farPlane / nearPlane, p);
+        const float uniformSplit = nearPlane + (farPlane - nearPlane) * p;
+        splits[cascade] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+    }
+    return splits;
+}
 
-    auto corners = VulkanMath::GetAABBCorners(sceneMin, sceneMax);
+glm::vec4 VulkanWindow::ComputeSliceSphere(float SliceNear, float SliceFar) const {
+    // Corners of the camera slice in world space
+    const glm::mat4 invView = glm::inverse(m_Camera->GetViewMatrix());
+    const float aspectRatio = m_CurrentScreenSize.x / m_CurrentScreenSize.y;
+    const float tanHalfFov = std::tan(glm::radians(m_Camera->GetFov()) * 0.5f);
+
+    std::array<glm::vec3, 8> corners{};
+    glm::vec3 center(0.0f);
+    for (uint32_t idx = 0; idx < 8; ++idx) {
+        const float depth = (idx & 4) ? SliceFar : SliceNear;
+        const float x = ((idx & 1) ? 1.0f : -1.0f) * depth * tanHalfFov * aspectRatio;
+        const float y = ((idx & 2) ? 1.0f : -1.0f) * depth * tanHalfFov;
+        corners[idx] = glm::vec3(invView * glm::vec4(x, y, -depth, 1.0f));
+        center += corners[idx] / 8.0f;
+    }
 
-    float minProj = std::numeric_limits<float>::infinity();
-    float maxProj = -std::numeric_limits<float>::infinity();
+    // A sphere keeps the cascade size constant while the camera turns, rounding hides float noise in the radius
+    float radius = 0.0f;
     for (auto &c: corners) {
-        float p = glm::dot(c, lightDir);
-        minProj = std::min(minProj, p);
-        maxProj = std::max(maxProj, p);
+        radius = std::max(radius, glm::length(c - center));
     }
+    radius = std::ceil(radius * 16.0f) / 16.0f;
 
-    float distanceToCenter = maxProj - glm::dot(sceneCenter, lightDir);
-    glm::vec3 lightPos = sceneCenter - lightDir * distanceToCenter;
+    return {center, radius};
+}
+
+ShadowMVP VulkanWindow::ComputeShadowMVP(uint32_t LightIdx, const glm::vec4 &SliceSphere) const {
+    glm::vec3 lightDir = glm::normalize(glm::vec3(m_DirectionalLights[LightIdx].Direction));
 
     glm::vec3 worldUp(0.0f, 1.0f, 0.0f);
     glm::vec3 up = (std::abs(glm::dot(lightDir, worldUp)) > 0.99f)
                        ? glm::vec3(0.0f, 0.0f, 1.0f)
                        : worldUp;
 
-    glm::mat4 lightView = glm::lookAt(lightPos, sceneCenter, up);
+    // Rotation only, the cascade moves through light space instead so the view never changes with the camera
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDir, up);
 
-    glm::vec3 minLS(std::numeric_limits<float>::infinity());
-    glm::vec3 maxLS(-std::numeric_limits<float>::infinity());
-    for (auto &c: corners) {
-        glm::vec3 ls = glm::vec3(lightView * glm::vec4(c, 1.0f));
-        minLS = glm::min(minLS, ls);
-        maxLS = glm::max(maxLS, ls);
-    }
+    const float radius = SliceSphere.w;
+
+    // Snap the center to whole texels, the cascade then slides in texel steps and its edges don't shimmer
+    const float texelSize = 2.0f * radius / m_ShadowResolution.x;
+    glm::vec3 centerLS = glm::vec3(lightView * glm::vec4(glm::vec3(SliceSphere), 1.0f));
+    centerLS.x = std::floor(centerLS.x / texelSize) * texelSize;
+    centerLS.y = std::floor(centerLS.y / texelSize) * texelSize;
 
-    float nearPlane = -maxLS.z;
-    float farPlane = -minLS.z;
+    // Depth spans the whole scene, casters outside the slice still have to land in the map
+    float minZ = std::numeric_limits<float>::infinity();
+    float maxZ = -std::numeric_limits<float>::infinity();
+    for (auto &c: VulkanMath::GetAABBCorners(m_SceneBounds.min, m_SceneBounds.max)) {
+        const float z = (lightView * glm::vec4(c, 1.0f)).z;
+        minZ = std::min(minZ, z);
+        maxZ = std::max(maxZ, z);
+    }
 
     glm::mat4 lightProj = kClipBias * glm::ortho(
-                              minLS.x, maxLS.x,
-                              minLS.y, maxLS.y,
-                              nearPlane, farPlane
+                              centerLS.x - radius, centerLS.x + radius,
+                              centerLS.y - radius, centerLS.y + radius,
+                              -maxZ, -minZ
                           );
 
 
@@ -167,7 +302,157 @@ void VulkanWindow::UpdateShadowUBO(uint32_t LightIdx) {
     smvp.view = lightView;
     smvp.proj = lightProj;
 
-    Buffer::UploadData(m_ShadowUBOBufferInfo, &smvp, sizeof(smvp));
+    return smvp;
+}
+
+void VulkanWindow::UpdateShadowMaps() {
+    const auto splits = ComputeCascadeSplits();
+
+    // Cascades follow the camera, thanks to the snapping their matrices only change once it moved a texel
+    for (const auto &[idx, light]: std::ranges::views::enumerate(m_DirectionalLights)) {
+        ShadowMapState &state = m_ShadowMaps[idx];
+
+        const glm::vec3 direction = glm::normalize(glm::vec3(light.Direction));
+        const bool bTurned = glm::dot(direction, state.direction) < 0.99999f;
+        state.direction = direction;
+
+        for (uint32_t cascade = 0; cascade < ShadowCascadeCount; ++cascade) {
+            ShadowCascadeState &cascadeState = state.cascades[cascade];
+            const glm::vec4 slice = ComputeSliceSphere(splits[cascade], splits[cascade + 1]);
+            const ShadowMVP matrices = ComputeShadowMVP(static_cast<uint32_t>(idx), slice);
+            const bool bLeftReceivers = glm::length(glm::vec3(slice) - glm::vec3(cascadeState.receivers)) + slice.w >
+                                        cascadeState.receivers.w;
+            if (bTurned || bLeftReceivers || matrices.view != cascadeState.matrices.view ||
+                matrices.proj != cascadeState.matrices.proj) {
+                cascadeState.bDirty = true;
+            }
+            if (cascadeState.bDirty) {
+                cascadeState.matrices = matrices;
+                cascadeState.planes = VulkanMath::ExtractFrustumPlanes(matrices.proj * matrices.view);
+                // Some slack so small camera moves inside the snapped texel don't reject the list right away
+                cascadeState.receivers = glm::vec4(glm::vec3(slice), slice.w * ShadowReceiverSlack);
+            }
+        }
+    }
+
+    // Every layer's matrix goes into the frame's shadow views once, rendering and lighting both index into it
+    const uint32_t viewCount = static_cast<uint32_t>(m_ShadowMaps.size()) * ShadowCascadeCount;
+    uint32_t viewsOffset{};
+    std::byte *views = m_UniformRing->Allocate(sizeof(ShadowViewsHeader) + sizeof(glm::mat4) * viewCount,
+                                               viewsOffset);
+
+    ShadowViewsHeader header{};
+    for (uint32_t cascade = 0; cascade < ShadowCascadeCount; ++cascade) {
+        header.splitDepths[cascade] = splits[cascade + 1];
+    }
+    std::memcpy(views, &header, sizeof(header));
+
+    auto *viewProj = reinterpret_cast<glm::mat4 *>(views + sizeof(ShadowViewsHeader));
+    for (const auto &[idx, state]: std::ranges::views::enumerate(m_ShadowMaps)) {
+        for (uint32_t cascade = 0; cascade < ShadowCascadeCount; ++cascade) {
+            const ShadowMVP &matrices = state.cascades[cascade].matrices;
+            viewProj[idx * ShadowCascadeCount + cascade] = matrices.proj * matrices.view;
+        }
+    }
+    m_DescriptorSets->SetDynamicOffset(DescriptorSets::ShadowViewOffset, viewsOffset);
+
+    for (const auto &[idx, state]: std::ranges::views::enumerate(m_ShadowMaps)) {
+        const bool bAnyDirty = std::ranges::any_of(state.cascades, [](const ShadowCascadeState &cascade) {
+            return cascade.bDirty;
+        });
+        if (!bAnyDirty) {
+            continue;
+        }
+
+        m_ShadowPass->PrepareImageForWrite(static_cast<uint32_t>(idx), m_CurrentFrame);
+        for (uint32_t cascade = 0; cascade < ShadowCascadeCount; ++cascade) {
+            ShadowCascadeState &cascadeState = state.cascades[cascade];
+            if (!cascadeState.bDirty) {
+                continue;
+            }
+            cascadeState.bDirty = false;
+
+            const uint32_t view = static_cast<uint32_t>(idx) * ShadowCascadeCount + cascade;
+            m_ShadowCastersDrawn += m_DrawBuffer->BuildShadowList(m_CurrentFrame, view, cascadeState.planes,
+                                                                  cascadeState.matrices.view,
+                                                                  cascadeState.receivers);
+            m_ShadowPass->DoPass(view, m_CurrentFrame, static_cast<uint32_t>(m_ShadowResolution.x),
+                                 static_cast<uint32_t>(m_ShadowResolution.y));
+            ++m_ShadowMapsRedrawn;
+        }
+        m_ShadowPass->PrepareImageForRead(static_cast<uint32_t>(idx), m_CurrentFrame);
+    }
+}
+
+void VulkanWindow::MarkGeometryMoved(const MeshBounds &WorldBounds) {
+    // Every cascade spans the scene depth, geometry growing the bounds invalidates all of them
+    MeshBounds grown = m_SceneBounds;
+    VulkanMath::ExpandBounds(grown, WorldBounds);
+    const bool bSceneGrew = grown.min != m_SceneBounds.min || grown.max != m_SceneBounds.max;
+    m_SceneBounds = grown;
+
+    for (auto &state: m_ShadowMaps) {
+        for (auto &cascade: state.cascades) {
+            if (bSceneGrew || VulkanMath::IsAABBInFrustum(cascade.planes, WorldBounds.min, WorldBounds.max)) {
+                cascade.bDirty = true;
+            }
+        }
+    }
+}
+
+void VulkanWindow::MoveDemoMesh() {
+    if (m_PendingMeshMove == glm::vec3(0.f) || m_Meshes.empty()) {
+        return;
+    }
+
+    const uint32_t draw = static_cast<uint32_t>(m_Meshes.size() - 1);
+    MeshBounds &bounds = m_Meshes[draw].m_Bounds;
+    const MeshBounds left = bounds;
+    bounds.min += m_PendingMeshMove;
+    bounds.max += m_PendingMeshMove;
+
+    m_DrawBuffer->MoveDraw(**m_CommandBuffers[m_CurrentFrame], draw, m_PendingMeshMove);
+    m_PendingMeshMove = glm::vec3(0.f);
+
+    MarkGeometryMoved(left);
+    MarkGeometryMoved(bounds);
+}
+
+void VulkanWindow::UpdateLights() {
+    m_DescriptorSets->SetDynamicOffset(DescriptorSets::DirectionalLightOffset,
+                                       m_UniformRing->Push(m_DirectionalLights.data(),
+                                                           sizeof(DirectionalLight) * m_DirectionalLights.size()));
+}
+
+void VulkanWindow::CreatePointLights() {
+    m_LightManager = std::make_unique<LightManager>(m_CommandBuffers, m_VmaAllocator, m_AllocationTracker.get(),
+                                                    static_cast<uint32_t>(m_FramesInFlight),
+                                                    static_cast<uint32_t>(m_PointLights.size()) + m_StressLightCount);
+    m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
+        m_LightManager->Destroy();
+    });
+
+    for (const PointLight &light: m_PointLights) {
+        SpawnPointLight(glm::vec3(light.Position), glm::vec3(light.Color), light.Color.w);
+    }
+
+    // Fixed seed, every run of the stress scene lights the same way
+    std::mt19937 rng{1337};
+    std::uniform_real_distribution<float> unit{0.f, 1.f};
+
+    const glm::vec3 extent = m_SceneBounds.max - m_SceneBounds.min;
+    for (uint32_t i = 0; i < m_StressLightCount; ++i) {
+        const glm::vec3 position = m_SceneBounds.min + extent * glm::vec3(unit(rng), unit(rng), unit(rng));
+        const glm::vec3 color = glm::vec3(unit(rng), unit(rng), unit(rng));
+        SpawnPointLight(position, color, 1.f + unit(rng));
+    }
+}
+
+LightManager::Handle VulkanWindow::SpawnPointLight(const glm::vec3 &Position, const glm::vec3 &Color,
+                                                   float Intensity) {
+    // Inverse square falloff drops below the cutoff at sqrt(intensity / cutoff)
+    const float range = std::sqrt(Intensity / PointLightCutoff);
+    return m_LightManager->Add({glm::vec4(Position, range), glm::vec4(Color, Intensity)});
 }
 
 
@@ -255,12 +540,75 @@ void VulkanWindow::ProcessInput(GLFWwindow *window, float deltaTime) {
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
         m_Camera->position -= up * velocity;
     }
+
+    // Swings the first directional light around the vertical axis, its shadow map follows next frame
+    float lightAngle = 0.f;
+    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
+        lightAngle += lightRotationSpeed * deltaTime;
+    }
+    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
+        lightAngle -= lightRotationSpeed * deltaTime;
+    }
+
+    // Up and down lift and lower the demo mesh, the shadow maps it touches are redrawn
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+        m_PendingMeshMove.y += meshMoveSpeed * deltaTime;
+    }
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+        m_PendingMeshMove.y -= meshMoveSpeed * deltaTime;
+    }
+    // Cycles the shadow filter of the mask pass on the key press, not while it is held
+    const bool bShadowFilterKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (bShadowFilterKey && !m_bShadowFilterKeyHeld) {
+        const uint32_t next = (static_cast<uint32_t>(m_ShadowMaskPass->GetShadowFilter()) + 1) %
+                              static_cast<uint32_t>(ShadowMaskPass::ShadowFilter::Count);
+        m_ShadowMaskPass->SetShadowFilter(static_cast<ShadowMaskPass::ShadowFilter>(next));
+    }
+    m_bShadowFilterKeyHeld = bShadowFilterKey;
+
+    // Switches between the fragment and the compute lighting path on the key press
+    const bool bLightingPathKey = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (bLightingPathKey && !m_bLightingPathKeyHeld) {
+        m_bComputeLighting = !m_bComputeLighting;
+    }
+    m_bLightingPathKeyHeld = bLightingPathKey;
+
+    // L spawns a point light at the camera, K removes the newest one again. The newest follows the camera while
+    // M is held
+    const bool bSpawnLightKey = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+    if (bSpawnLightKey && !m_bSpawnLightKeyHeld) {
+        const float hue = static_cast<float>(m_SpawnedLights.size()) * 0.618f;
+        const glm::vec3 color = glm::clamp(glm::abs(glm::fract(glm::vec3(hue) + glm::vec3(0.f, 2.f, 1.f) / 3.f) *
+                                                    6.f - 3.f) - 1.f, 0.f, 1.f);
+        m_SpawnedLights.push_back(SpawnPointLight(m_Camera->position, color, 5.f));
+    }
+    m_bSpawnLightKeyHeld = bSpawnLightKey;
+
+    const bool bRemoveLightKey = glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS;
+    if (bRemoveLightKey && !m_bRemoveLightKeyHeld && !m_SpawnedLights.empty()) {
+        m_LightManager->Remove(m_SpawnedLights.back());
+        m_SpawnedLights.pop_back();
+    }
+    m_bRemoveLightKeyHeld = bRemoveLightKey;
+
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS && !m_SpawnedLights.empty()) {
+        m_LightManager->SetPosition(m_SpawnedLights.back(), m_Camera->position);
+    }
+
+    if (lightAngle != 0.f && !m_DirectionalLights.empty()) {
+        glm::vec4 &direction = m_DirectionalLights[0].Direction;
+        const float c = std::cos(lightAngle);
+        const float s = std::sin(lightAngle);
+        direction = glm::vec4(c * direction.x + s * direction.z, direction.y, c * direction.z - s * direction.x,
+                              direction.w);
+    }
 }
 
 void VulkanWindow::RenderToCubemap(const std::vector<vk::ShaderModule> &Shader, ImageResource &inImage,
                                    const vk::ImageView &inImageView, vk::Sampler sampler,
                                    ImageResource &outImage, std::array<vk::ImageView, 6> &outImageViews,
-                                   const vk::Extent2D &renderArea, int inLayerCount = 1) {
+                                   const vk::Extent2D &renderArea, int inLayerCount = 1,
+                                   uint64_t inUploadValue = 0) {
     m_DescriptorSetFactory->ResetFactory();
 
     vk::raii::DescriptorSetLayout dsLayout = m_DescriptorSetFactory->AddBinding(
@@ -503,9 +851,22 @@ void VulkanWindow::RenderToCubemap(const std::vector<vk::ShaderModule> &Shader,
     m_DescriptorSetFactory->ResetFactory();
 
 
+    // The source image may still be in flight in its upload batch, only that batch is waited on. Uploads recorded
+    // after it stay unsubmitted, so the fence below does not cover them either
+    vk::Semaphore uploadSemaphore = m_UploadBatcher->GetSemaphore();
+    vk::PipelineStageFlags uploadWaitStage = vk::PipelineStageFlagBits::eAllCommands;
+
+    vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.setWaitSemaphoreValues(inUploadValue);
+
     vk::SubmitInfo submitInfo{};
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &*cmd;
+    if (inUploadValue != 0) {
+        submitInfo.setWaitSemaphores(uploadSemaphore);
+        submitInfo.setWaitDstStageMask(uploadWaitStage);
+        submitInfo.pNext = &timelineInfo;
+    }
 
     vk::FenceCreateInfo fenceInfo{};
 
@@ -571,62 +932,33 @@ void VulkanWindow::InitVulkan() {
     m_FrameDescriptorSetLayout = std::make_unique<vk::raii::DescriptorSetLayout>(
         std::move(
             m_DescriptorSetFactory
-            ->AddBinding(0, vk::DescriptorType::eUniformBuffer,
-                         vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
-            .AddBinding(1, vk::DescriptorType::eSampledImage, vk::ShaderStageFlagBits::eFragment)
-            .AddBinding(2, vk::DescriptorType::eSampledImage, vk::ShaderStageFlagBits::eFragment)
-            .AddBinding(3, vk::DescriptorType::eSampledImage, vk::ShaderStageFlagBits::eFragment)
-            .AddBinding(4, vk::DescriptorType::eSampledImage, vk::ShaderStageFlagBits::eFragment)
-            .AddBinding(5, vk::DescriptorType::eUniformBuffer,
-                        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
-            .AddBinding(6, vk::DescriptorType::eSampledImage, vk::ShaderStageFlagBits::eFragment,
+            ->AddBinding(0, vk::DescriptorType::eUniformBufferDynamic,
+                         vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment |
+                         vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(1, vk::DescriptorType::eSampledImage,
+                        vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(2, vk::DescriptorType::eSampledImage,
+                        vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(4, vk::DescriptorType::eSampledImage,
+                        vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(5, vk::DescriptorType::eStorageBufferDynamic,
+                        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(6, vk::DescriptorType::eSampledImage, vk::ShaderStageFlagBits::eCompute,
                         static_cast<uint32_t>(m_DirectionalLights.size()))
-            .AddBinding(7, vk::DescriptorType::eSampledImage, vk::ShaderStageFlagBits::eFragment)
-            .AddBinding(8, vk::DescriptorType::eSampledImage, vk::ShaderStageFlagBits::eFragment)
+            .AddBinding(7, vk::DescriptorType::eSampledImage,
+                        vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(8, vk::DescriptorType::eSampledImage,
+                        vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(9, vk::DescriptorType::eStorageImage,
+                        vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(10, vk::DescriptorType::eStorageImage,
+                        vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
             .Build()
         )
     );
 
     m_DescriptorSetFactory->ResetFactory();
 
-    m_UniformBufferInfo = m_Buffer->CreateMapped(m_VmaAllocator, sizeof(MVP),
-                                                 vk::BufferUsageFlagBits::eUniformBuffer,
-                                                 VMA_MEMORY_USAGE_CPU_TO_GPU,
-                                                 VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-                                                 m_AllocationTracker.get(), "MVP");
-
-    m_ShadowUBOBufferInfo = m_Buffer->CreateMapped(m_VmaAllocator, sizeof(ShadowMVP),
-                                                   vk::BufferUsageFlagBits::eUniformBuffer,
-                                                   VMA_MEMORY_USAGE_CPU_TO_GPU,
-                                                   VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-                                                   m_AllocationTracker.get(), "ShadowMVP");
-
-    m_PointLightBufferInfo = m_Buffer->CreateMapped(
-        m_VmaAllocator,
-        sizeof(PointLight) * m_PointLights.size(),
-        vk::BufferUsageFlagBits::eStorageBuffer,
-        VMA_MEMORY_USAGE_CPU_TO_GPU,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-        m_AllocationTracker.get(),
-        "PointLights"
-    );
-
-    m_DirectionalLightBufferInfo = m_Buffer->CreateMapped(
-        m_VmaAllocator,
-        sizeof(DirectionalLight) * m_DirectionalLights.size(),
-        vk::BufferUsageFlagBits::eStorageBuffer,
-        VMA_MEMORY_USAGE_CPU_TO_GPU,
-        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT,
-        m_AllocationTracker.get(),
-        "DirectionalLights"
-    );
-
-
-    Buffer::UploadData(m_PointLightBufferInfo, m_PointLights.data(), sizeof(PointLight) * m_PointLights.size());
-    Buffer::UploadData(m_DirectionalLightBufferInfo, m_DirectionalLights.data(),
-                       sizeof(DirectionalLight) * m_DirectionalLights.size());
-
-
     vk::SamplerCreateInfo samplerInfo = {
         {},
         vk::Filter::eLinear,
@@ -641,7 +973,7 @@ void VulkanWindow::InitVulkan() {
         VK_FALSE,
         vk::CompareOp::eNever,
         0.0f,
-        0.0f,
+        VK_LOD_CLAMP_NONE,
         vk::BorderColor::eIntOpaqueBlack,
         VK_FALSE
     };
@@ -671,6 +1003,27 @@ void VulkanWindow::InitVulkan() {
 
     m_CmdPool = std::make_unique<vk::raii::CommandPool>(m_Renderer->CreateCommandPool(*m_Device, QueueIdx));
 
+    m_UploadBatcher = std::make_unique<UploadBatcher>(*m_Device, m_VmaAllocator, **m_GraphicsQueue, QueueIdx,
+                                                      m_AllocationTracker.get());
+    m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
+        m_UploadBatcher->Destroy();
+    });
+
+    m_GeometryPool = std::make_unique<GeometryPool>(m_VmaAllocator, m_AllocationTracker.get());
+    m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
+        m_GeometryPool->Destroy();
+    });
+
+    // Changed point lights are staged through the ring as well
+    m_UniformRing = std::make_unique<UniformRing>(m_VmaAllocator, m_AllocationTracker.get(),
+                                                  m_PhysicalDevice->getProperties().limits,
+                                                  static_cast<uint32_t>(m_FramesInFlight),
+                                                  UniformRing::DefaultFrameSize +
+                                                  sizeof(PointLight) * LightManager::MaxUploadsPerFrame);
+    m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
+        m_UniformRing->Destroy();
+    });
+
     auto swapImg = m_SwapChain->getImages();
     m_SwapChainImages.resize(swapImg.size());
 
@@ -679,6 +1032,8 @@ void VulkanWindow::InitVulkan() {
         m_SwapChainImages[i].imageAspectFlags = vk::ImageAspectFlagBits::eColor;
     }
 
+    CreatePresentSemaphores();
+
     m_DepthPass = std::make_unique<DepthPass>(*m_Device, m_CommandBuffers);
 
     m_DepthPass->CreateImage(m_VmaAllocator, m_AllocationTracker.get(), m_DepthImageFactory->GetFormat(),
@@ -693,18 +1048,82 @@ void VulkanWindow::InitVulkan() {
                                         m_VmaAllocatorsDeletionQueue,
                                         m_AllocationTracker.get(), static_cast<uint32_t>(m_ShadowResolution.x),
                                         static_cast<uint32_t>(m_ShadowResolution.y));
+    m_ShadowMaps.resize(m_DirectionalLights.size());
+
+    m_ShadowMaskPass = std::make_unique<ShadowMaskPass>(*m_Device, m_CommandBuffers);
+    m_ShadowMaskPass->CreateImage(m_VmaAllocator, m_AllocationTracker.get(), m_SwapChainFactory->Extent.width,
+                                  m_SwapChainFactory->Extent.height);
+    m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
+        m_ShadowMaskPass->DestroyImage();
+    });
+
+    m_ComputeLightingPass = std::make_unique<ComputeLightingPass>(*m_Device, m_CommandBuffers);
+    m_ComputeLightingPass->CreateImage(m_VmaAllocator, m_AllocationTracker.get(), m_SwapChainFactory->Extent.width,
+                                       m_SwapChainFactory->Extent.height);
+    m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
+        m_ComputeLightingPass->DestroyImage();
+    });
+
+    // The environment maps are baked during init and read nothing else, the HDR source goes out in a batch of its
+    // own so baking them does not wait for the scene uploads recorded after it
+    ImageResource hdrImage = ImageFactory::LoadHDRTexture(*m_UploadBatcher,
+                                                          "circus_arena_4k.hdr",
+                                                          m_VmaAllocator,
+                                                          vk::Format::eR32G32B32A32Sfloat,
+                                                          vk::ImageAspectFlagBits::eColor
+    );
+    m_AllocationTracker->TrackAllocation(hdrImage.allocation, "hdr image");
+    const uint64_t hdrUploadValue = m_UploadBatcher->Flush();
 
     LoadMesh();
+    CreatePointLights();
+
+    m_ClusterPass = std::make_unique<ClusterPass>(*m_Device, m_CommandBuffers);
+    m_ClusterPass->CreateBuffer(m_VmaAllocator, m_AllocationTracker.get());
+    m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
+        m_ClusterPass->Destroy();
+    });
+
+    m_DrawBuffer = std::make_unique<IndirectDrawBuffer>(m_VmaAllocator, m_AllocationTracker.get(),
+                                                        static_cast<uint32_t>(m_FramesInFlight));
+    m_DrawBuffer->Build(m_Meshes, *m_UploadBatcher,
+                        static_cast<uint32_t>(m_DirectionalLights.size()) * ShadowCascadeCount);
+    m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
+        m_DrawBuffer->Destroy();
+    });
+
+    m_CullPass = std::make_unique<CullPass>(*m_Device, m_CommandBuffers);
+    m_CullPass->CreateResources(*m_DrawBuffer, m_VmaAllocator, m_AllocationTracker.get(),
+                                static_cast<uint32_t>(m_FramesInFlight));
+    m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
+        m_CullPass->Destroy();
+    });
+
+    m_HiZPass = std::make_unique<HiZPass>(*m_Device, m_CommandBuffers);
+    m_HiZPass->CreateResources(m_VmaAllocator, m_AllocationTracker.get(), m_DepthPass->GetImageView(),
+                               m_SwapChainFactory->Extent.width, m_SwapChainFactory->Extent.height);
+    m_CullPass->SetDepthPyramid(m_HiZPass->GetImageView(), m_HiZPass->GetSampler(), m_HiZPass->GetExtent());
+    m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
+        m_HiZPass->DestroyImages();
+    });
 
     m_GlobalDescriptorSetLayout = std::make_unique<vk::raii::DescriptorSetLayout>(
         std::move(
             m_DescriptorSetFactory
-            ->AddBinding(0, vk::DescriptorType::eSampler, vk::ShaderStageFlagBits::eFragment)
+            ->AddBinding(0, vk::DescriptorType::eSampler,
+                         vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
             .AddBinding(1, vk::DescriptorType::eSampledImage, vk::ShaderStageFlagBits::eFragment,
                         static_cast<uint32_t>(m_ImageResource.size()))
-            .AddBinding(2, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eFragment)
-            .AddBinding(3, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eFragment)
-            .AddBinding(4, vk::DescriptorType::eSampler, vk::ShaderStageFlagBits::eFragment)
+            .AddBinding(2, vk::DescriptorType::eStorageBuffer,
+                        vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(3, vk::DescriptorType::eStorageBufferDynamic,
+                        vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(4, vk::DescriptorType::eSampler, vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(5, vk::DescriptorType::eStorageBuffer,
+                        vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
+            .AddBinding(6, vk::DescriptorType::eStorageBuffer,
+                        vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute)
+            .AddBinding(7, vk::DescriptorType::eSampler, vk::ShaderStageFlagBits::eCompute)
 
             .Build()
         )
@@ -716,6 +1135,9 @@ void VulkanWindow::InitVulkan() {
 
     CreateCommandBuffers();
 
+    m_GpuTimer = std::make_unique<GpuTimer>(*m_Device, m_CommandBuffers, m_PhysicalDevice->getProperties().limits,
+                                            static_cast<uint32_t>(m_FramesInFlight));
+
 
     std::vector<vk::ShaderModule> CubemapSources;
     auto ShaderModules = ShaderFactory::Build_ShaderModules(*m_Device, "shaders/cubemapvert.spv",
@@ -732,20 +1154,6 @@ void VulkanWindow::InitVulkan() {
         CubemapSources.emplace_back(std::move(shader));
     }
 
-    std::unique_ptr<Buffer> imgBuffer = std::make_unique<Buffer>();
-
-    ImageResource hdrImage = ImageFactory::LoadHDRTexture(imgBuffer.get(),
-                                                          "circus_arena_4k.hdr",
-                                                          *m_Device,
-                                                          m_VmaAllocator,
-                                                          *m_CmdPool,
-                                                          *m_GraphicsQueue,
-                                                          vk::Format::eR32G32B32A32Sfloat,
-                                                          vk::ImageAspectFlagBits::eColor,
-                                                          m_AllocationTracker.get()
-    );
-    m_AllocationTracker->TrackAllocation(hdrImage.allocation, "hdr image");
-
     vk::ImageView hdrImageView = ImageFactory::CreateImageView(*m_Device, hdrImage.image, hdrImage.format,
                                                                hdrImage.imageAspectFlags, m_AllocationTracker.get(),
                                                                "hdr img view");
@@ -781,7 +1189,7 @@ void VulkanWindow::InitVulkan() {
 
 
     RenderToCubemap(CubemapSources, hdrImage, hdrImageView, *m_Sampler, m_CubemapImage, imageviews,
-                    {imageInfo.extent.width, imageInfo.extent.height});
+                    {imageInfo.extent.width, imageInfo.extent.height}, 1, hdrUploadValue);
     m_CubemapImage.extent = vk::Extent2D{imageInfo.extent.width, imageInfo.extent.height};
 
 
@@ -866,29 +1274,41 @@ void VulkanWindow::InitVulkan() {
 
 
     m_DescriptorSets->CreateGlobalDescriptorSet(
-        **m_GlobalDescriptorSetLayout, *m_Sampler,
-        std::make_pair(m_PointLightBufferInfo, static_cast<uint32_t>(m_PointLights.size())),
-        std::make_pair(m_DirectionalLightBufferInfo, static_cast<uint32_t>(m_DirectionalLights.size())),
+        **m_GlobalDescriptorSetLayout, *m_Sampler, m_UniformRing->GetBuffer(),
+        m_LightManager->GetBuffer(), static_cast<uint32_t>(m_DirectionalLights.size()),
+        std::make_pair(m_DrawBuffer->GetDrawData(), m_DrawBuffer->GetDrawCount()),
         m_ImageResource,
-        m_SwapChainImageViews, m_ShadowPass->GetSampler()
+        m_SwapChainImageViews, m_ShadowPass->GetSampler(), m_ShadowPass->GetDepthSampler(),
+        m_ClusterPass->GetBuffer()
     );
 
     m_DescriptorSets->CreateFrameDescriptorSet(**m_FrameDescriptorSetLayout, m_GBufferPass->GetImageViews(),
-                                               m_DepthPass->GetImageView(), m_UniformBufferInfo, m_ShadowUBOBufferInfo,
-                                               m_ShadowPass->GetImageView(), m_CubemapImageView, m_IrradianceImageView);
+                                               m_DepthPass->GetImageView(), m_UniformRing->GetBuffer(),
+                                               static_cast<uint32_t>(m_DirectionalLights.size()) * ShadowCascadeCount,
+                                               m_ShadowPass->GetImageView(), m_CubemapImageView, m_IrradianceImageView,
+                                               m_ShadowMaskPass->GetImageView(),
+                                               m_ComputeLightingPass->GetImageView());
+
+    m_GBufferPass->m_DescriptorSets = m_DescriptorSets.get();
+    m_DepthPass->m_DescriptorSets = m_DescriptorSets.get();
+    m_ShadowPass->m_DescriptorSets = m_DescriptorSets.get();
 
-    m_GBufferPass->m_DescriptorSets = m_DescriptorSets->GetDescriptorSets(m_CurrentFrame);
-    m_DepthPass->m_DescriptorSets = m_DescriptorSets->GetDescriptorSets(m_CurrentFrame);
-    m_ShadowPass->m_DescriptorSets = m_DescriptorSets->GetDescriptorSets(m_CurrentFrame);
+    m_GBufferPass->m_DynamicOffsets = &m_DescriptorSets->GetDynamicOffsets();
+    m_DepthPass->m_DynamicOffsets = &m_DescriptorSets->GetDynamicOffsets();
+    m_ShadowPass->m_DynamicOffsets = &m_DescriptorSets->GetDynamicOffsets();
 
     CreatePipelineLayout();
     m_GBufferPass->m_PipelineLayout = **m_PipelineLayout;
     m_DepthPass->m_PipelineLayout = **m_PipelineLayout;
     m_ShadowPass->m_PipelineLayout = **m_PipelineLayout;
 
-    m_GBufferPass->SetMeshes(m_Meshes);
-    m_DepthPass->SetMeshes(m_Meshes);
-    m_ShadowPass->SetMeshes(m_Meshes);
+    m_GBufferPass->SetDrawBuffer(m_DrawBuffer.get());
+    m_DepthPass->SetDrawBuffer(m_DrawBuffer.get());
+    m_ShadowPass->SetDrawBuffer(m_DrawBuffer.get());
+
+    m_GBufferPass->SetGeometryPool(m_GeometryPool.get());
+    m_DepthPass->SetGeometryPool(m_GeometryPool.get());
+    m_ShadowPass->SetGeometryPool(m_GeometryPool.get());
 
     std::pair Format = {m_SwapChainFactory->Format.format, m_DepthImageFactory->GetFormat()};
 
@@ -897,51 +1317,41 @@ void VulkanWindow::InitVulkan() {
     m_ShadowPass->CreatePipeline(static_cast<uint32_t>(m_ImageResource.size()), m_DepthImageFactory->GetFormat());
 
     // create color pass
-    std::pair lights = {m_DirectionalLights, m_PointLights};
-    m_ColorPass = std::make_unique<ColorPass>(*m_Device, **m_PipelineLayout, m_CommandBuffers, lights, Format);
-    m_ColorPass->m_DescriptorSets = m_DescriptorSets->GetDescriptorSets(m_CurrentFrame);
-    m_ShadowPass->m_DescriptorSets = m_DescriptorSets->GetDescriptorSets(m_CurrentFrame);
+    m_ColorPass = std::make_unique<ColorPass>(*m_Device, **m_PipelineLayout, m_CommandBuffers, Format);
+    m_ColorPass->m_DescriptorSets = m_DescriptorSets.get();
+    m_ColorPass->m_DynamicOffsets = &m_DescriptorSets->GetDynamicOffsets();
 
+    m_ShadowMaskPass->m_PipelineLayout = **m_PipelineLayout;
+    m_ShadowMaskPass->CreatePipeline(static_cast<uint32_t>(m_DirectionalLights.size()));
+    m_ShadowMaskPass->m_DescriptorSets = m_DescriptorSets.get();
+    m_ShadowMaskPass->m_DynamicOffsets = &m_DescriptorSets->GetDynamicOffsets();
 
-    BeginCommandBuffer();
-    PrepareFrame();
+    m_ClusterPass->m_PipelineLayout = **m_PipelineLayout;
+    m_ClusterPass->CreatePipeline();
+    m_ClusterPass->m_DescriptorSets = m_DescriptorSets.get();
+    m_ClusterPass->m_DynamicOffsets = &m_DescriptorSets->GetDynamicOffsets();
 
-    for (const auto &[idx, light]: std::ranges::views::enumerate(m_DirectionalLights)) {
-        UpdateShadowUBO(static_cast<uint32_t>(idx));
+    m_ComputeLightingPass->m_PipelineLayout = **m_PipelineLayout;
+    m_ComputeLightingPass->CreatePipeline();
+    m_ComputeLightingPass->m_DescriptorSets = m_DescriptorSets.get();
+    m_ComputeLightingPass->m_DynamicOffsets = &m_DescriptorSets->GetDynamicOffsets();
 
+    m_TonemapPass = std::make_unique<ColorPass>(*m_Device, **m_PipelineLayout, m_CommandBuffers, Format,
+                                                "shaders/tonemapfrag.spv");
+    m_TonemapPass->m_DescriptorSets = m_DescriptorSets.get();
+    m_TonemapPass->m_DynamicOffsets = &m_DescriptorSets->GetDynamicOffsets();
 
-        m_ShadowPass->DoPass(static_cast<uint32_t>(idx), m_CurrentFrame, static_cast<uint32_t>(m_ShadowResolution.x),
-                             static_cast<uint32_t>(m_ShadowResolution.y));
 
+    // Everything the first frames read has been recorded, kick the uploads off without waiting for them
+    m_UploadBatcher->Flush();
 
-        ImageFactory::ShiftImageLayout(
-            *m_CommandBuffers[m_CurrentFrame],
-            m_ShadowPass->GetImage()[idx],
-            vk::ImageLayout::eDepthReadOnlyOptimal,
-            vk::AccessFlagBits::eDepthStencilAttachmentWrite,
-            vk::AccessFlagBits::eShaderRead,
-            vk::PipelineStageFlagBits::eLateFragmentTests,
-            vk::PipelineStageFlagBits::eFragmentShader
-        );
-    }
-    EndCommandBuffer();
-    SubmitOffscreen();
+    // Shadow maps are rendered by the first DrawFrame, every map starts out dirty
 
 
     m_AllocationTracker->UntrackAllocation(hdrImage.allocation);
     vmaDestroyImage(m_VmaAllocator, hdrImage.image, hdrImage.allocation);
 
     m_VmaAllocatorsDeletionQueue.emplace_back([&](VmaAllocator) {
-        Buffer::Destroy(m_VmaAllocator, m_UniformBufferInfo.m_Buffer, m_UniformBufferInfo.m_Allocation,
-                        m_AllocationTracker.get());
-        Buffer::Destroy(m_VmaAllocator, m_PointLightBufferInfo.m_Buffer, m_PointLightBufferInfo.m_Allocation,
-                        m_AllocationTracker.get());
-        Buffer::Destroy(m_VmaAllocator, m_DirectionalLightBufferInfo.m_Buffer,
-                        m_DirectionalLightBufferInfo.m_Allocation, m_AllocationTracker.get());
-        Buffer::Destroy(m_VmaAllocator, m_ShadowUBOBufferInfo.m_Buffer, m_ShadowUBOBufferInfo.m_Allocation,
-                        m_AllocationTracker.get());
-
-
         m_AllocationTracker->UntrackImageView(m_CubemapImageView);
         vkDestroyImageView(**m_Device, m_CubemapImageView, nullptr);
 
@@ -959,7 +1369,6 @@ void VulkanWindow::InitVulkan() {
 }
 
 void VulkanWindow::DrawFrame() {
-    UpdateUBO();
     int width, height;
     glfwGetFramebufferSize(m_Window, &width, &height);
     m_CurrentScreenSize = glm::vec2(width, height);
@@ -967,59 +1376,119 @@ void VulkanWindow::DrawFrame() {
     HandleFramebufferResize(width, height);
 
     PrepareFrame();
+
+    // The fence of this slot was waited on, nothing in flight reads its part of the ring anymore
+    m_UniformRing->BeginFrame(m_CurrentFrame);
+    UpdateUBO();
+    UpdateLights();
+
     uint32_t imageIndex = AcquireSwapchainImage();
 
     BeginCommandBuffer();
 
+    m_GpuTimer->BeginFrame(m_CurrentFrame);
+
+    // Only when more lights were added than the buffer holds. The passes bind the global set of the frame they
+    // record, so only this frame's is repointed now, the others follow when their fence came around. The replaced
+    // buffer is retired until every frame in flight moved past it, so nothing has to drain
+    if (m_LightManager->NeedsGrowth()) {
+        m_LightManager->Grow(m_CurrentFrame);
+        m_DescriptorSets->WritePointLights(m_CurrentFrame, m_LightManager->GetBuffer());
+    }
+    m_DescriptorSets->RefreshPointLights(m_CurrentFrame);
+    m_LightManager->Update(m_CurrentFrame, *m_UniformRing);
+
+    // Before the shadow lists and the cull pass read the bounds
+    MoveDemoMesh();
+
     TransitionInitialLayouts(imageIndex);
 
+    m_GpuTimer->Begin(m_CurrentFrame, GpuTimer::Shadows);
+    UpdateShadowMaps();
+    m_GpuTimer->End(m_CurrentFrame, GpuTimer::Shadows);
+
+    // The attachments are shared between frames, the previous one may still be sampling the depth in its color pass
+    // or in the compute passes behind it, the Hi-Z build, the shadow mask and the compute lighting
     ImageFactory::ShiftImageLayout(
         *m_CommandBuffers[m_CurrentFrame],
         m_DepthPass->GetImage(),
         vk::ImageLayout::eDepthStencilAttachmentOptimal,
         vk::AccessFlagBits::eNone,
         vk::AccessFlagBits::eDepthStencilAttachmentWrite,
-        vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader,
         vk::PipelineStageFlagBits::eEarlyFragmentTests
     );
 
+    m_GpuTimer->Begin(m_CurrentFrame, GpuTimer::Geometry);
+    m_CullPass->DoPass(m_CurrentFrame, m_CameraClip);
+
     m_DepthPass->DoPass(m_CurrentFrame, width, height);
 
+    m_HiZPass->DoPass(m_CurrentFrame, m_DepthPass->GetImage());
+    m_CullPass->DoLatePass(m_CurrentFrame);
+
+    m_DepthPass->DoPass(m_CurrentFrame, width, height, true);
+
+    m_GpuTimer->Begin(m_CurrentFrame, GpuTimer::GBuffer);
     m_GBufferPass->DoPass(m_DepthPass->GetImageView(), m_CurrentFrame, width, height);
+    m_GpuTimer->End(m_CurrentFrame, GpuTimer::GBuffer);
     m_GBufferPass->PrepareImagesForRead(m_CurrentFrame);
+    m_GpuTimer->End(m_CurrentFrame, GpuTimer::Geometry);
 
+    // The shadow mask and the lighting pass both read the depth
     ImageFactory::ShiftImageLayout(*m_CommandBuffers[m_CurrentFrame],
                                    m_DepthPass->GetImage(),
                                    vk::ImageLayout::eReadOnlyOptimal,
-                                   vk::AccessFlagBits::eNone,
-                                   vk::AccessFlagBits::eColorAttachmentRead,
-                                   vk::PipelineStageFlagBits::eTopOfPipe,
-                                   vk::PipelineStageFlagBits::eColorAttachmentOutput);
+                                   vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                                   vk::AccessFlagBits::eShaderRead,
+                                   vk::PipelineStageFlagBits::eLateFragmentTests,
+                                   vk::PipelineStageFlagBits::eComputeShader |
+                                   vk::PipelineStageFlagBits::eFragmentShader);
+
+    m_GpuTimer->Begin(m_CurrentFrame, GpuTimer::ShadowMask);
+    m_ShadowMaskPass->DoPass(m_CurrentFrame);
+    m_GpuTimer->End(m_CurrentFrame, GpuTimer::ShadowMask);
+
+    // The compute path culls per tile itself, the scope is still written so its query resolves
+    m_GpuTimer->Begin(m_CurrentFrame, GpuTimer::LightCulling);
+    if (!m_bComputeLighting) {
+        m_ClusterPass->DoPass(m_CurrentFrame);
+    }
+    m_GpuTimer->End(m_CurrentFrame, GpuTimer::LightCulling);
 
 
     ImageFactory::ShiftImageLayout(*m_CommandBuffers[m_CurrentFrame],
                                    m_CubemapImage,
                                    vk::ImageLayout::eReadOnlyOptimal,
                                    vk::AccessFlagBits::eNone,
-                                   vk::AccessFlagBits::eColorAttachmentRead,
+                                   vk::AccessFlagBits::eShaderRead,
                                    vk::PipelineStageFlagBits::eTopOfPipe,
-                                   vk::PipelineStageFlagBits::eColorAttachmentOutput, 6);
+                                   vk::PipelineStageFlagBits::eFragmentShader |
+                                   vk::PipelineStageFlagBits::eComputeShader, 6);
 
     ImageFactory::ShiftImageLayout(*m_CommandBuffers[m_CurrentFrame],
                                    m_IrradianceImage,
                                    vk::ImageLayout::eReadOnlyOptimal,
                                    vk::AccessFlagBits::eNone,
-                                   vk::AccessFlagBits::eColorAttachmentRead,
+                                   vk::AccessFlagBits::eShaderRead,
                                    vk::PipelineStageFlagBits::eTopOfPipe,
-                                   vk::PipelineStageFlagBits::eColorAttachmentOutput, 6);
-
-    m_ColorPass->DoPass(m_SwapChainFactory->m_ImageViews, m_CurrentFrame, imageIndex, width, height);
+                                   vk::PipelineStageFlagBits::eFragmentShader |
+                                   vk::PipelineStageFlagBits::eComputeShader, 6);
+
+    m_GpuTimer->Begin(m_CurrentFrame, GpuTimer::Lighting);
+    if (m_bComputeLighting) {
+        m_ComputeLightingPass->DoPass(m_CurrentFrame);
+        m_TonemapPass->DoPass(m_SwapChainFactory->m_ImageViews, m_CurrentFrame, imageIndex, width, height);
+    } else {
+        m_ColorPass->DoPass(m_SwapChainFactory->m_ImageViews, m_CurrentFrame, imageIndex, width, height);
+    }
+    m_GpuTimer->End(m_CurrentFrame, GpuTimer::Lighting);
 
     TransitionForPresentation(imageIndex);
 
     EndCommandBuffer();
 
-    SubmitFrame();
+    SubmitFrame(imageIndex);
 
     PresentFrame(imageIndex);
 
@@ -1046,10 +1515,16 @@ void VulkanWindow::HandleFramebufferResize(int width, int height) {
         m_SwapChainImages[i].imageAspectFlags = vk::ImageAspectFlagBits::eColor;
     }
 
+    CreatePresentSemaphores();
+
     m_DepthPass->RecreateImage(m_VmaAllocator, m_AllocationTracker.get(), std::get<1>(m_DepthPass->GetFormat()),
                                width, height);
+    m_HiZPass->RecreateResources(m_DepthPass->GetImageView(), width, height);
+    m_CullPass->SetDepthPyramid(m_HiZPass->GetImageView(), m_HiZPass->GetSampler(), m_HiZPass->GetExtent());
     m_GBufferPass->RecreateGBuffer(m_VmaAllocator, m_AllocationTracker.get(), m_SwapChainFactory->Extent.width,
                                    m_SwapChainFactory->Extent.height);
+    m_ShadowMaskPass->RecreateImage(m_SwapChainFactory->Extent.width, m_SwapChainFactory->Extent.height);
+    m_ComputeLightingPass->RecreateImage(m_SwapChainFactory->Extent.width, m_SwapChainFactory->Extent.height);
 
     auto transitionCmd = m_Renderer->CreateCommandBuffer(*m_Device, *m_CmdPool);
     transitionCmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
@@ -1066,7 +1541,7 @@ void VulkanWindow::HandleFramebufferResize(int width, int height) {
     m_GraphicsQueue->waitIdle();
 
 
-    auto [diffuse, normal, material] = m_GBufferPass->GetImageViews();
+    auto [diffuse, normal] = m_GBufferPass->GetImageViews();
 
     vk::DescriptorImageInfo DiffuseImageInfo{};
     DiffuseImageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
@@ -1078,84 +1553,97 @@ void VulkanWindow::HandleFramebufferResize(int width, int height) {
     NormalImageInfo.imageView = normal;
     NormalImageInfo.sampler = nullptr;
 
-    vk::DescriptorImageInfo MaterialImageInfo{};
-    MaterialImageInfo.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-    MaterialImageInfo.imageView = material;
-    MaterialImageInfo.sampler = nullptr;
-
     vk::DescriptorImageInfo DepthImageInfo{};
     DepthImageInfo.imageLayout = vk::ImageLayout::eDepthReadOnlyOptimal;
     DepthImageInfo.imageView = m_DepthPass->GetImageView();
     DepthImageInfo.sampler = nullptr;
 
+    vk::DescriptorImageInfo ShadowMaskImageInfo{};
+    ShadowMaskImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+    ShadowMaskImageInfo.imageView = m_ShadowMaskPass->GetImageView();
+    ShadowMaskImageInfo.sampler = nullptr;
 
-    auto ds = m_DescriptorSets->GetFrameDescriptorSet(m_CurrentFrame).second;
+    vk::DescriptorImageInfo HDRImageInfo{};
+    HDRImageInfo.imageLayout = vk::ImageLayout::eGeneral;
+    HDRImageInfo.imageView = m_ComputeLightingPass->GetImageView();
+    HDRImageInfo.sampler = nullptr;
 
+
+    // Every frame in flight binds its own frame set, all of them still point at the old images
     std::vector<vk::WriteDescriptorSet> writes;
-    // Diffuse texture
-    vk::WriteDescriptorSet writeDiffuse{};
-    writeDiffuse.dstSet = ds;
-    writeDiffuse.dstBinding = 1;
-    writeDiffuse.dstArrayElement = 0;
-    writeDiffuse.descriptorCount = 1;
-    writeDiffuse.descriptorType = vk::DescriptorType::eSampledImage;
-    writeDiffuse.pImageInfo = &DiffuseImageInfo;
-    writes.push_back(writeDiffuse);
-
-    // Normal texture
-    vk::WriteDescriptorSet writeNormal{};
-    writeNormal.dstSet = ds;
-    writeNormal.dstBinding = 2;
-    writeNormal.dstArrayElement = 0;
-    writeNormal.descriptorCount = 1;
-    writeNormal.descriptorType = vk::DescriptorType::eSampledImage;
-    writeNormal.pImageInfo = &NormalImageInfo;
-    writes.push_back(writeNormal);
-
-    // Material texture
-    vk::WriteDescriptorSet writeMaterial{};
-    writeMaterial.dstSet = ds;
-    writeMaterial.dstBinding = 3;
-    writeMaterial.dstArrayElement = 0;
-    writeMaterial.descriptorCount = 1;
-    writeMaterial.descriptorType = vk::DescriptorType::eSampledImage;
-    writeMaterial.pImageInfo = &MaterialImageInfo;
-    writes.push_back(writeMaterial);
-
-    // Depth texture
-    vk::WriteDescriptorSet writeDepth{};
-    writeDepth.dstSet = ds;
-    writeDepth.dstBinding = 4;
-    writeDepth.dstArrayElement = 0;
-    writeDepth.descriptorCount = 1;
-    writeDepth.descriptorType = vk::DescriptorType::eSampledImage;
-    writeDepth.pImageInfo = &DepthImageInfo;
-    writes.push_back(writeDepth);
+    for (uint32_t frame = 0; frame < m_FramesInFlight; ++frame) {
+        auto ds = m_DescriptorSets->GetFrameDescriptorSet(frame).second;
+
+        // Diffuse texture
+        vk::WriteDescriptorSet writeDiffuse{};
+        writeDiffuse.dstSet = ds;
+        writeDiffuse.dstBinding = 1;
+        writeDiffuse.dstArrayElement = 0;
+        writeDiffuse.descriptorCount = 1;
+        writeDiffuse.descriptorType = vk::DescriptorType::eSampledImage;
+        writeDiffuse.pImageInfo = &DiffuseImageInfo;
+        writes.push_back(writeDiffuse);
+
+        // Normal texture
+        vk::WriteDescriptorSet writeNormal{};
+        writeNormal.dstSet = ds;
+        writeNormal.dstBinding = 2;
+        writeNormal.dstArrayElement = 0;
+        writeNormal.descriptorCount = 1;
+        writeNormal.descriptorType = vk::DescriptorType::eSampledImage;
+        writeNormal.pImageInfo = &NormalImageInfo;
+        writes.push_back(writeNormal);
+
+        // Depth texture
+        vk::WriteDescriptorSet writeDepth{};
+        writeDepth.dstSet = ds;
+        writeDepth.dstBinding = 4;
+        writeDepth.dstArrayElement = 0;
+        writeDepth.descriptorCount = 1;
+        writeDepth.descriptorType = vk::DescriptorType::eSampledImage;
+        writeDepth.pImageInfo = &DepthImageInfo;
+        writes.push_back(writeDepth);
+
+        // Shadow mask
+        vk::WriteDescriptorSet writeShadowMask{};
+        writeShadowMask.dstSet = ds;
+        writeShadowMask.dstBinding = 9;
+        writeShadowMask.dstArrayElement = 0;
+        writeShadowMask.descriptorCount = 1;
+        writeShadowMask.descriptorType = vk::DescriptorType::eStorageImage;
+        writeShadowMask.pImageInfo = &ShadowMaskImageInfo;
+        writes.push_back(writeShadowMask);
+
+        vk::WriteDescriptorSet writeHDR{};
+        writeHDR.dstSet = ds;
+        writeHDR.dstBinding = 10;
+        writeHDR.dstArrayElement = 0;
+        writeHDR.descriptorCount = 1;
+        writeHDR.descriptorType = vk::DescriptorType::eStorageImage;
+        writeHDR.pImageInfo = &HDRImageInfo;
+        writes.push_back(writeHDR);
+    }
 
     m_Device->updateDescriptorSets(writes, {});
 
-
-    m_GBufferPass->m_DescriptorSets = m_DescriptorSets->GetDescriptorSets(m_CurrentFrame);
-    m_DepthPass->m_DescriptorSets = m_DescriptorSets->GetDescriptorSets(m_CurrentFrame);
-    m_ColorPass->m_DescriptorSets = m_DescriptorSets->GetDescriptorSets(m_CurrentFrame);
-
     m_bFrameBufferResized = false;
 }
 
 void VulkanWindow::PrepareFrame() {
-    auto result = m_Device->waitForFences({*m_RenderFinishedFence}, VK_TRUE, UINT64_MAX);
+    // Only waits for the submission that used this frame slot last, the other frames keep running on the GPU
+    auto result = m_Device->waitForFences({*m_InFlightFences[m_CurrentFrame]}, VK_TRUE, UINT64_MAX);
     if (result != vk::Result::eSuccess) {
         std::cerr << "Failed to wait fences" << std::endl;
     }
 
-    m_Device->resetFences({*m_RenderFinishedFence});
+    m_Device->resetFences({*m_InFlightFences[m_CurrentFrame]});
 }
 
 uint32_t VulkanWindow::AcquireSwapchainImage() const {
     vk::AcquireNextImageInfoKHR acquireInfo{};
     acquireInfo.swapchain = **m_SwapChain;
     acquireInfo.timeout = 1'000'000'000ULL;
-    acquireInfo.semaphore = *m_ImageAvailableSemaphore;
+    acquireInfo.semaphore = *m_ImageAvailableSemaphores[m_CurrentFrame];
     acquireInfo.deviceMask = 1;
 
     auto result = m_Device->acquireNextImage2KHR(acquireInfo);
@@ -1193,40 +1681,33 @@ void VulkanWindow::EndCommandBuffer() const {
     m_CommandBuffers[m_CurrentFrame]->end();
 }
 
-void VulkanWindow::SubmitFrame() const {
+void VulkanWindow::SubmitFrame(uint32_t imageIndex) const {
     vk::SubmitInfo submitInfo{};
-    vk::Semaphore waitSemaphores[] = {*m_ImageAvailableSemaphore};
-    vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-    vk::Semaphore signalSemaphores[] = {*m_RenderFinishedSemaphore};
+    vk::Semaphore waitSemaphores[] = {*m_ImageAvailableSemaphores[m_CurrentFrame], m_UploadBatcher->GetSemaphore()};
+    vk::PipelineStageFlags waitStages[] = {
+        vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eAllCommands
+    };
+    // Binary semaphores ignore their value, the timeline one holds the frame until the latest upload batch landed
+    uint64_t waitValues[] = {0, m_UploadBatcher->GetSubmittedValue()};
+    vk::Semaphore signalSemaphores[] = {*m_RenderFinishedSemaphores[imageIndex]};
+
+    vk::TimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.setWaitSemaphoreValues(waitValues);
 
     vk::CommandBuffer cmd = *m_CommandBuffers[m_CurrentFrame];
     submitInfo.setWaitSemaphores(waitSemaphores);
     submitInfo.setWaitDstStageMask(waitStages);
     submitInfo.setCommandBuffers(cmd);
     submitInfo.setSignalSemaphores(signalSemaphores);
+    submitInfo.pNext = &timelineInfo;
 
-    m_GraphicsQueue->submit(submitInfo, **m_RenderFinishedFence);
+    m_GraphicsQueue->submit(submitInfo, **m_InFlightFences[m_CurrentFrame]);
 }
 
 
-void VulkanWindow::SubmitOffscreen() const {
-    vk::SubmitInfo submitInfo{};
-    vk::Semaphore waitSemaphores[] = {*m_ImageAvailableSemaphore};
-    vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-    vk::Semaphore signalSemaphores[] = {*m_RenderFinishedSemaphore};
-
-    vk::CommandBuffer cmd = *m_CommandBuffers[m_CurrentFrame];
-    submitInfo.setWaitDstStageMask(waitStages);
-    submitInfo.setCommandBuffers(cmd);
-    submitInfo.setSignalSemaphoreCount(0);
-    submitInfo.setWaitSemaphoreCount(0);
-
-    m_GraphicsQueue->submit(submitInfo, **m_RenderFinishedFence);
-}
-
 void VulkanWindow::PresentFrame(uint32_t imageIndex) const {
     vk::PresentInfoKHR presentInfo{};
-    presentInfo.setWaitSemaphores(**m_RenderFinishedSemaphore);
+    presentInfo.setWaitSemaphores(**m_RenderFinishedSemaphores[imageIndex]);
     presentInfo.setSwapchains(**m_SwapChain);
     presentInfo.setImageIndices(imageIndex);
     auto result = m_GraphicsQueue->presentKHR(presentInfo);
@@ -1236,22 +1717,35 @@ void VulkanWindow::PresentFrame(uint32_t imageIndex) const {
 }
 
 void VulkanWindow::CreateSemaphoreAndFences() {
-    m_ImageAvailableSemaphore = std::make_unique<vk::raii::Semaphore>(*m_Device, vk::SemaphoreCreateInfo());
-    m_RenderFinishedSemaphore = std::make_unique<vk::raii::Semaphore>(*m_Device, vk::SemaphoreCreateInfo());
-    m_RenderFinishedFence = std::make_unique<vk::raii::Fence>(
-        *m_Device, vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled));
+    for (size_t frames{}; frames < m_FramesInFlight; ++frames) {
+        m_ImageAvailableSemaphores.emplace_back(
+            std::make_unique<vk::raii::Semaphore>(*m_Device, vk::SemaphoreCreateInfo()));
+        m_InFlightFences.emplace_back(std::make_unique<vk::raii::Fence>(
+            *m_Device, vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled)));
+    }
+}
+
+void VulkanWindow::CreatePresentSemaphores() {
+    m_RenderFinishedSemaphores.clear();
+    for (size_t image{}; image < m_SwapChainImages.size(); ++image) {
+        m_RenderFinishedSemaphores.emplace_back(
+            std::make_unique<vk::raii::Semaphore>(*m_Device, vk::SemaphoreCreateInfo()));
+    }
 }
 
 void VulkanWindow::LoadMesh() {
     m_MeshFactory = std::make_unique<MeshFactory>();
-    m_MeshCmdBuffer = std::make_unique<vk::raii::CommandBuffer>(
-        std::move(m_Renderer->CreateCommandBuffer(*m_Device, *m_CmdPool)));
+    m_MeshFactory->EnableTextureMips(m_bTextureMips);
+    m_MeshFactory->EnableCookedTextures(m_PhysicalDevice->getFeatures().textureCompressionBC);
 
     m_Meshes = m_MeshFactory->LoadModelFromGLTF("models/sponza/Sponza.gltf",
                                                 m_VmaAllocator, m_VmaAllocatorsDeletionQueue,
-                                                **m_MeshCmdBuffer, *m_GraphicsQueue, *m_Device,
-                                                *m_CmdPool, m_ImageResource,
+                                                *m_UploadBatcher, *m_GeometryPool, *m_Device, m_ImageResource,
                                                 m_SwapChainImageViews, m_AllocationTracker.get());
+
+    for (const Mesh &mesh: m_Meshes) {
+        VulkanMath::ExpandBounds(m_SceneBounds, mesh.m_Bounds);
+    }
 }
 
 void VulkanWindow::CreatePipelineLayout() {
@@ -1259,16 +1753,21 @@ void VulkanWindow::CreatePipelineLayout() {
         *m_FrameDescriptorSetLayout, *m_GlobalDescriptorSetLayout
     };
 
-    vk::PushConstantRange pushConstantRange{};
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(Material);
-    pushConstantRange.stageFlags = vk::ShaderStageFlagBits::eFragment;
+    // Materials come from the per-draw SSBO. The vertex range is the shadow view a shadow pass renders,
+    // the compute range the shadow filter of the shadow mask pass
+    std::array<vk::PushConstantRange, 2> pushConstantRanges{};
+    pushConstantRanges[0].offset = 0;
+    pushConstantRanges[0].size = sizeof(uint32_t);
+    pushConstantRanges[0].stageFlags = vk::ShaderStageFlagBits::eVertex;
+    pushConstantRanges[1].offset = sizeof(uint32_t);
+    pushConstantRanges[1].size = sizeof(uint32_t);
+    pushConstantRanges[1].stageFlags = vk::ShaderStageFlagBits::eCompute;
 
     vk::PipelineLayoutCreateInfo layoutInfo{};
     layoutInfo.setLayoutCount = static_cast<uint32_t>(DescriptorSetLayouts.size());
     layoutInfo.pSetLayouts = DescriptorSetLayouts.data();
-    layoutInfo.pushConstantRangeCount = 1;
-    layoutInfo.pPushConstantRanges = &pushConstantRange;
+    layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    layoutInfo.pPushConstantRanges = pushConstantRanges.data();
 
     m_PipelineLayout = std::make_unique<vk::raii::PipelineLayout>(*m_Device, layoutInfo);
 }
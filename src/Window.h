@@ -4,6 +4,7 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #define GLFW_EXPOSE_NATIVE_WIN32
+#include <array>
 #include <deque>
 #include <functional>
 
@@ -15,8 +16,14 @@
 #include <memory>
 
 #include "Buffer.h"
+#include "GeometryPool.h"
+#include "GpuTimer.h"
+#include "IndirectDrawBuffer.h"
+#include "LightManager.h"
 #include "ResourceTracker.h"
 #include "Renderer.h"
+#include "UniformRing.h"
+#include "UploadBatcher.h"
 #include "Factories/DebugMessengerFactory.h"
 #include "Factories/DepthImageFactory.h"
 #include "Factories/DescriptorSetFactory.h"
@@ -30,20 +37,32 @@
 #include "Camera.h"
 #include "DescriptorSets/DescriptorSets.h"
 #include "Passes/ColorPass.h"
+#include "Passes/ClusterPass.h"
+#include "Passes/ComputeLightingPass.h"
+#include "Passes/CullPass.h"
+#include "Passes/HiZPass.h"
 #include "Passes/DepthPass.h"
 #include "Passes/GBufferPass.h"
 #include "Passes/ShadowPass.h"
+#include "Passes/ShadowMaskPass.h"
 
 
 #include "Structs/Lights.h"
+#include "Structs/UBOStructs.h"
 
 static constexpr uint32_t WIDTH = 800;
 static constexpr uint32_t HEIGHT = 600;
 
-static constexpr uint32_t ShadowResolutionMultiplier = 5;
+// Per cascade layer, every directional light owns ShadowCascadeCount of them
+static constexpr uint32_t ShadowResolutionMultiplier = 2;
 static constexpr glm::vec2 m_ShadowResolution{
 	1024 * ShadowResolutionMultiplier,1024 * ShadowResolutionMultiplier
 };
+// Irradiance below which a point light is considered out of range, sets every light's Position.w
+static constexpr float PointLightCutoff = 0.05f;
+
+// Growth of a cascade's receiver sphere over its camera slice, casters are culled against the grown sphere
+static constexpr float ShadowReceiverSlack = 1.25f;
 
 class VulkanWindow
 {
@@ -57,6 +76,22 @@ public:
 
 	void Run();
 
+	// Renders FrameCount pipelined frames, then FrameCount frames serialized with a queue idle wait, prints both and exits
+	void EnableFrameBenchmark(uint32_t FrameCount) { m_BenchmarkFrames = FrameCount; }
+
+	// Marks the shadow maps whose light frustum overlaps the bounds stale. Moving geometry calls it with both the
+	// bounds it left and the bounds it moved into, see MoveDemoMesh
+	void MarkGeometryMoved(const MeshBounds &WorldBounds);
+
+	// Scatters LightCount extra point lights through the scene, has to be called before Run
+	void EnableLightStress(uint32_t LightCount) { m_StressLightCount = LightCount; }
+
+	// Starts with the compute lighting path instead of the full screen fragment shader, C toggles at runtime
+	void EnableComputeLighting(bool bEnable) { m_bComputeLighting = bEnable; }
+
+	// Imported textures get a full mip chain unless this is turned off before Run, for comparing the GBuffer timer
+	void EnableTextureMips(bool bEnable) { m_bTextureMips = bEnable; }
+
 	static inline const std::vector<const char*> instanceExtensions = {
 		VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
 		VK_KHR_SURFACE_EXTENSION_NAME,
@@ -77,8 +112,6 @@ private:
 
 	[[nodiscard]] uint32_t AcquireSwapchainImage() const;
 
-	void SubmitOffscreen() const;
-
 	void BeginCommandBuffer() const;
 
 	void TransitionInitialLayouts(uint32_t imageIndex);
@@ -87,12 +120,14 @@ private:
 
 	void EndCommandBuffer() const;
 
-	void SubmitFrame() const;
+	void SubmitFrame(uint32_t imageIndex) const;
 
 	void PresentFrame(uint32_t imageIndex) const;
 
 	void CreateSemaphoreAndFences();
 
+	void CreatePresentSemaphores();
+
 	void LoadMesh();
 
 	void CreatePipelineLayout();
@@ -105,11 +140,35 @@ private:
 
 	void MainLoop();
 
+	// Returns true once both halves of the frame benchmark are done and reported
+	bool RecordBenchmarkFrame(double FrameStart);
+
 	void Cleanup();
 
 	void UpdateUBO();
 
-	void UpdateShadowUBO(uint32_t LightIdx);
+	// View space distances splitting the camera frustum into cascades, near plane first
+	[[nodiscard]] std::array<float, ShadowCascadeCount + 1> ComputeCascadeSplits() const;
+
+	// World space bounding sphere (xyz center, w radius) of the camera slice between both distances
+	[[nodiscard]] glm::vec4 ComputeSliceSphere(float SliceNear, float SliceFar) const;
+
+	// Fits a texel snapped orthographic frustum around the slice sphere
+	[[nodiscard]] ShadowMVP ComputeShadowMVP(uint32_t LightIdx, const glm::vec4 &SliceSphere) const;
+
+	// Redraws the shadow maps whose light turned or whose geometry moved since they were last rendered
+	void UpdateShadowMaps();
+
+	// Slides the last mesh of the scene by what the up and down keys accumulated, standing in for animated geometry
+	void MoveDemoMesh();
+
+	void UpdateLights();
+
+	// The scene's point lights plus seeded random ones inside the scene bounds, all handed to the light manager
+	void CreatePointLights();
+
+	// Hands a point light to the light manager, its range follows from the intensity
+	LightManager::Handle SpawnPointLight(const glm::vec3 &Position, const glm::vec3 &Color, float Intensity);
 
 	void CreateSurface();
 
@@ -123,7 +182,7 @@ private:
 
 	void RenderToCubemap(const std::vector<vk::ShaderModule> &Shader, ImageResource &inImage, const vk::ImageView &inImageView, vk::Sampler
 	                     sampler, ImageResource &outImage, std::array<vk::ImageView, 6> &outImageViews, const vk::Extent2D &renderArea, int
-	                     inLayerCount);
+	                     inLayerCount, uint64_t inUploadValue);
 
 	GLFWwindow* m_Window{};
 
@@ -143,9 +202,11 @@ private:
 	std::unique_ptr<vk::raii::SwapchainKHR> m_SwapChain{};
 	std::unique_ptr<vk::raii::Queue> m_GraphicsQueue{};
 
-	std::unique_ptr<vk::raii::Semaphore> m_ImageAvailableSemaphore{};
-	std::unique_ptr<vk::raii::Semaphore> m_RenderFinishedSemaphore{};
-	std::unique_ptr<vk::raii::Fence> m_RenderFinishedFence{};
+	// Acquire semaphores and fences are per frame in flight, the present semaphores per swapchain image because
+	// the presentation engine may still hold one after the frame that signaled it was recycled
+	std::vector<std::unique_ptr<vk::raii::Semaphore>> m_ImageAvailableSemaphores{};
+	std::vector<std::unique_ptr<vk::raii::Semaphore>> m_RenderFinishedSemaphores{};
+	std::vector<std::unique_ptr<vk::raii::Fence>> m_InFlightFences{};
 
 	vk::SurfaceKHR m_Surface{};
 	std::vector<ImageResource> m_SwapChainImages{};
@@ -158,7 +219,8 @@ private:
 	std::unique_ptr<vk::raii::Sampler> m_Sampler{};
 
 	std::unique_ptr<vk::raii::CommandPool> m_CmdPool{};
-	std::unique_ptr<vk::raii::CommandBuffer> m_MeshCmdBuffer{};
+	std::unique_ptr<UploadBatcher> m_UploadBatcher{};
+	std::unique_ptr<GeometryPool> m_GeometryPool{};
 
 	std::unique_ptr<vk::raii::DescriptorSetLayout> m_FrameDescriptorSetLayout{};
 	std::unique_ptr<vk::raii::DescriptorSetLayout> m_GlobalDescriptorSetLayout{};
@@ -174,14 +236,16 @@ private:
 	std::unique_ptr<MeshFactory> m_MeshFactory{};
 	std::vector<ImageResource> m_ImageResource{};
 
-	BufferInfo m_UniformBufferInfo{};
-	BufferInfo m_PointLightBufferInfo{};
-	BufferInfo m_DirectionalLightBufferInfo{};
-	BufferInfo m_ShadowUBOBufferInfo{};
+	// MVP, shadow matrix and directional lights of every frame in flight, bound with dynamic offsets
+	std::unique_ptr<UniformRing> m_UniformRing{};
+	std::unique_ptr<LightManager> m_LightManager{};
 
 	std::vector<std::unique_ptr<vk::raii::CommandBuffer>> m_CommandBuffers{};
 
 	std::vector<Mesh> m_Meshes{};
+	// Grown from the per-mesh bounds as meshes are loaded, never from vertices
+	MeshBounds m_SceneBounds{};
+	std::unique_ptr<IndirectDrawBuffer> m_DrawBuffer{};
 
 	std::unique_ptr<ResourceTracker> m_AllocationTracker{};
 
@@ -192,6 +256,14 @@ private:
 	std::unique_ptr<Camera> m_Camera{};
 
 	std::unique_ptr<ColorPass> m_ColorPass{};
+	std::unique_ptr<ComputeLightingPass> m_ComputeLightingPass{};
+	// Full screen pass that tonemaps the compute lighting output into the swapchain
+	std::unique_ptr<ColorPass> m_TonemapPass{};
+	std::unique_ptr<CullPass> m_CullPass{};
+	std::unique_ptr<ClusterPass> m_ClusterPass{};
+	std::unique_ptr<HiZPass> m_HiZPass{};
+	std::unique_ptr<ShadowMaskPass> m_ShadowMaskPass{};
+	std::unique_ptr<GpuTimer> m_GpuTimer{};
 	std::unique_ptr<GBufferPass> m_GBufferPass{};
 	std::unique_ptr<DepthPass> m_DepthPass{};
 	std::unique_ptr<ShadowPass> m_ShadowPass{};
@@ -207,11 +279,26 @@ private:
 
 
 	float cameraSpeed = 10.0f;
+	float lightRotationSpeed = 0.5f;
+	float meshMoveSpeed = 2.0f;
+	// Accumulated by the up and down keys, applied to the demo mesh by the next frame
+	glm::vec3 m_PendingMeshMove{ 0.f };
+	bool m_bShadowFilterKeyHeld{ false };
+	bool m_bComputeLighting{ false };
+	bool m_bTextureMips{ true };
+	bool m_bLightingPathKeyHeld{ false };
+	bool m_bSpawnLightKeyHeld{ false };
+	bool m_bRemoveLightKeyHeld{ false };
+	// Lights spawned at runtime, newest last
+	std::vector<LightManager::Handle> m_SpawnedLights{};
 	double lastFrameTime = 0.f;
 
+	double lastStatsTime = 0.f;
+
 	double lastX = 0, lastY = 0;
 	bool firstMouse = true;
 
+	// Initial point lights, the LightManager owns them at runtime
 	const std::vector<PointLight> m_PointLights{
 				{
 					{0,1,0,0},
@@ -227,7 +314,7 @@ private:
 				}
 	};
 
-	const std::vector<DirectionalLight> m_DirectionalLights =
+	std::vector<DirectionalLight> m_DirectionalLights =
 	{
 		{
 			glm::vec4(-.5f, -.2f, -0.f, 0.0f),
@@ -244,9 +331,33 @@ private:
 
 	size_t m_FramesInFlight{ 2 };
 	uint32_t m_CurrentFrame{ 0 };
+	uint32_t m_StressLightCount{ 0 };
+	uint32_t m_BenchmarkFrames{ 0 };
+	uint32_t m_BenchmarkFrameIndex{ 0 };
+	std::vector<double> m_PipelinedFrameTimes{};
+	std::vector<double> m_SerializedFrameTimes{};
 
 	glm::vec2 m_CurrentScreenSize{};
 
+	// proj * view * model of the last UpdateUBO, the cull pass tests against it
+	glm::mat4 m_CameraClip{ 1.f };
+
+	// What every cascade was last rendered with, a cascade is only redrawn once this went stale
+	struct ShadowCascadeState {
+		ShadowMVP matrices{};
+		std::array<glm::vec4, 6> planes{};
+		// Grown slice sphere the caster list was culled for, it stays valid while the slice remains inside
+		glm::vec4 receivers{};
+		bool bDirty{ true };
+	};
+	struct ShadowMapState {
+		glm::vec3 direction{};
+		std::array<ShadowCascadeState, ShadowCascadeCount> cascades{};
+	};
+	std::vector<ShadowMapState> m_ShadowMaps{};
+	uint32_t m_ShadowMapsRedrawn{};
+	uint32_t m_ShadowCastersDrawn{};
+
 
 
 };
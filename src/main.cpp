@@ -1,14 +1,317 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <random>
+#include "JobSystem.h"
+#include "TextureCache.h"
 #include "Window.h"
+#include "Math/math.h"
 
-int main()
+// Compares a cold (Assimp import) against a warm (mesh cache) load of the scene on the CPU, the cache write in
+// between is reported on its own.
+// Both paths end with the vertex/index copy that the upload would do, so lazily mapped pages are counted as well.
+static int RunLoadBenchmark(const std::string& path, int iterations)
 {
+	using Clock = std::chrono::steady_clock;
+
+	std::vector<std::byte> staging;
+	auto touch = [&staging](const ModelData& model) {
+		staging.clear();
+		for (const auto& stream : model.vertexStreams)
+		{
+			staging.insert(staging.end(), stream.begin(), stream.end());
+		}
+		const auto* indices = reinterpret_cast<const std::byte*>(model.indices.data());
+		staging.insert(staging.end(), indices, indices + model.indices.size_bytes());
+	};
+
+	try
+	{
+		auto start = Clock::now();
+		ModelData cold = MeshFactory::ImportModel(path);
+		touch(cold);
+		const std::chrono::duration<double, std::milli> coldTime = Clock::now() - start;
+
+		// Timed on its own so the speedup compares the import against the warm load only
+		start = Clock::now();
+		if (!MeshFactory::WriteModelCache(path, cold))
+		{
+			std::cerr << "Failed to write mesh cache for " << path << std::endl;
+			return EXIT_FAILURE;
+		}
+		const std::chrono::duration<double, std::milli> writeTime = Clock::now() - start;
+
+		double warmTotal = 0.0;
+		double warmBest = std::numeric_limits<double>::max();
+		for (int i = 0; i < iterations; ++i)
+		{
+			start = Clock::now();
+			ModelData warm = MeshFactory::LoadModelData(path);
+			touch(warm);
+			const std::chrono::duration<double, std::milli> warmTime = Clock::now() - start;
+
+			warmTotal += warmTime.count();
+			warmBest = std::min(warmBest, warmTime.count());
+		}
+
+		std::cout << "\n--- Load benchmark: " << path << " ---\n"
+				  << "meshes: " << cold.meshes.size() << ", vertices: " << cold.vertexCount
+				  << ", indices: " << cold.indices.size() << ", textures: " << cold.textures.size() << "\n"
+				  << "cold (Assimp import): " << coldTime.count() << " ms\n"
+				  << "cache write: " << writeTime.count() << " ms\n"
+				  << "warm (mesh cache, " << iterations << " runs): avg " << warmTotal / iterations
+				  << " ms, best " << warmBest << " ms\n"
+				  << "speedup: " << coldTime.count() / warmBest << "x" << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+// Packs random vertices the way the importer does and unpacks them the way the vertex shaders do.
+// Fails when any attribute drifts further than its quantization step allows.
+static int RunVertexSelfTest(uint32_t count)
+{
+	std::mt19937 rng{7};
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	auto randomDirection = [&]() {
+		glm::vec3 direction{};
+		do
+		{
+			direction = glm::vec3(unit(rng), unit(rng), unit(rng));
+		}
+		while (glm::dot(direction, direction) < 1e-4f || glm::dot(direction, direction) > 1.0f);
+		return glm::normalize(direction);
+	};
+
+	// acos loses everything below a hundredth of a degree in float, atan2 keeps it
+	auto angleBetween = [](const glm::vec3& a, const glm::vec3& b) {
+		return glm::degrees(std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)));
+	};
+
+	float maxPositionError = 0.0f;
+	float maxNormalError = 0.0f;
+	float maxTangentError = 0.0f;
+	float maxTexCoordError = 0.0f;
+	uint32_t flippedFrames = 0;
+
+	bool bPassed = true;
+	for (uint32_t mesh = 0; mesh < count / 1024 + 1; ++mesh)
+	{
+		// Every few meshes one flat axis, like a floor quad
+		const glm::vec3 center = glm::vec3(unit(rng), unit(rng), unit(rng)) * 100.0f;
+		glm::vec3 extent = glm::abs(glm::vec3(unit(rng), unit(rng), unit(rng))) * 50.0f + 0.01f;
+		if (mesh % 4 == 3)
+		{
+			extent.y = 0.0f;
+		}
+
+		std::vector<Vertex> vertices(1024);
+		for (Vertex& vertex : vertices)
+		{
+			vertex.pos = center + glm::vec3(unit(rng), unit(rng), unit(rng)) * extent;
+			vertex.texCoord = glm::vec2(unit(rng), unit(rng)) * 8.0f;
+			vertex.normal = randomDirection();
+			vertex.tangent = glm::normalize(glm::cross(vertex.normal, randomDirection()));
+			vertex.bitangent = glm::cross(vertex.normal, vertex.tangent) * (unit(rng) < 0.0f ? -1.0f : 1.0f);
+		}
+		const MeshBounds bounds = VulkanMath::ComputeMeshBounds(vertices);
+		const glm::vec3 step = (bounds.max - bounds.min) / 65535.0f;
+
+		for (const Vertex& vertex : vertices)
+		{
+			const Vertex unpacked = VulkanMath::UnpackVertex(VulkanMath::PackVertex(vertex, bounds), bounds);
+
+			const glm::vec3 positionError = glm::abs(unpacked.pos - vertex.pos);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				// Half a step of rounding plus the float error of the position itself
+				bPassed &= positionError[axis] <= 0.5f * step[axis] + 1e-5f * std::abs(vertex.pos[axis]) + 1e-6f;
+				if (step[axis] > 0.0f)
+				{
+					maxPositionError = std::max(maxPositionError, positionError[axis] / step[axis]);
+				}
+			}
+
+			const float normalError = angleBetween(unpacked.normal, vertex.normal);
+			const float tangentError = angleBetween(unpacked.tangent, vertex.tangent);
+			maxNormalError = std::max(maxNormalError, normalError);
+			maxTangentError = std::max(maxTangentError, tangentError);
+			bPassed &= normalError < 0.01f && tangentError < 0.01f;
+
+			if (glm::dot(unpacked.bitangent, vertex.bitangent) < 0.99f)
+			{
+				++flippedFrames;
+				bPassed = false;
+			}
+
+			// Half floats keep 11 significant bits
+			const glm::vec2 texCoordError = glm::abs(unpacked.texCoord - vertex.texCoord);
+			const glm::vec2 texCoordTolerance = glm::max(glm::abs(vertex.texCoord), glm::vec2(1.0f / 16384.0f)) / 2048.0f;
+			bPassed &= texCoordError.x <= texCoordTolerance.x && texCoordError.y <= texCoordTolerance.y;
+			maxTexCoordError = std::max({maxTexCoordError, texCoordError.x, texCoordError.y});
+		}
+	}
+
+	std::cout << "\n--- Vertex format self test ---\n"
+			  << "vertex: " << sizeof(Vertex) << " bytes on import, " << sizeof(PackedVertex) << " bytes on the GPU\n"
+			  << "position: max error " << maxPositionError << " quantization steps\n"
+			  << "normal: max error " << maxNormalError << " deg, tangent: " << maxTangentError << " deg\n"
+			  << "bitangent sign: " << flippedFrames << " flipped\n"
+			  << "texcoord: max error " << maxTexCoordError << "\n"
+			  << (bPassed ? "passed" : "FAILED") << std::endl;
+
+	return bPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Cooks every texture the model references into its block compressed KTX2 copy, up to date ones are skipped.
+// This is the offline step, the renderer itself never cooks
+static int RunTextureCooker(const std::string& path)
+{
+	using Clock = std::chrono::steady_clock;
+
+	uint32_t cooked = 0;
+	uint32_t upToDate = 0;
+	uint32_t failed = 0;
+	uint64_t cookedBytes = 0;
+	const auto start = Clock::now();
+
+	try
+	{
+		const ModelData model = MeshFactory::LoadModelData(path);
+		const std::filesystem::path baseDir = std::filesystem::path(path).parent_path();
+		JobSystem jobs{};
+
+		for (const TextureRef& texture : model.textures)
+		{
+			const std::filesystem::path source = baseDir / texture.path;
+			if (std::optional<CookedTexture> cached = TextureCache::Load(source, texture.usage))
+			{
+				// A touched but unchanged source only gets its stamp rewritten, the mapping has to go first
+				const bool bStampCurrent = cached->bStampCurrent;
+				cached.reset();
+				if (!bStampCurrent && !TextureCache::RefreshSourceStamp(source, texture.usage))
+				{
+					std::cerr << "Failed to refresh the source stamp of " << texture.path << std::endl;
+				}
+
+				++upToDate;
+				continue;
+			}
+
+			const auto textureStart = Clock::now();
+			const uint64_t bytes = TextureCache::Cook(source, texture.usage, jobs);
+			if (bytes == 0)
+			{
+				++failed;
+				continue;
+			}
+
+			++cooked;
+			cookedBytes += bytes;
+			const std::chrono::duration<double, std::milli> textureTime = Clock::now() - textureStart;
+			std::cout << "Cooked " << texture.path << ": " << bytes / 1024 << " KiB in " << textureTime.count()
+					  << " ms" << std::endl;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::chrono::duration<double> elapsed = Clock::now() - start;
+	std::cout << "\n--- Texture cooker: " << path << " ---\n"
+			  << "cooked: " << cooked << " (" << cookedBytes / (1024 * 1024) << " MiB), up to date: " << upToDate
+			  << ", failed: " << failed << "\n"
+			  << "took " << elapsed.count() << " s" << std::endl;
+
+	return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Reads the count after a flag. It is only consumed when it is a number, so a flag followed by another flag or by
+// nothing keeps the default.
+static uint32_t ParseCount(int& i, int argc, char* argv[], uint32_t fallback)
+{
+	if (i + 1 >= argc)
+	{
+		return fallback;
+	}
+
+	const char* arg = argv[i + 1];
+	const char* end = arg + std::strlen(arg);
+	if (arg == end || !std::all_of(arg, end, [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }))
+	{
+		return fallback;
+	}
+
+	++i;
+	const unsigned long long value = std::strtoull(arg, nullptr, 10);
+	return static_cast<uint32_t>(std::min<unsigned long long>(value, std::numeric_limits<uint32_t>::max()));
+}
+
+int main(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--bench-load") == 0)
+		{
+			const std::string path = (i + 1 < argc) ? argv[i + 1] : "models/sponza/Sponza.gltf";
+			return RunLoadBenchmark(path, 5);
+		}
+		if (std::strcmp(argv[i], "--selftest-vertex") == 0)
+		{
+			return RunVertexSelfTest(1u << 16);
+		}
+		if (std::strcmp(argv[i], "--cook-textures") == 0)
+		{
+			const std::string path = (i + 1 < argc) ? argv[i + 1] : "models/sponza/Sponza.gltf";
+			return RunTextureCooker(path);
+		}
+	}
+
+	uint32_t benchmarkFrames = 0;
+	uint32_t stressLights = 0;
+	bool bComputeLighting = false;
+	bool bTextureMips = true;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--bench-frames") == 0)
+		{
+			benchmarkFrames = ParseCount(i, argc, argv, 500);
+		}
+		if (std::strcmp(argv[i], "--stress-lights") == 0)
+		{
+			stressLights = ParseCount(i, argc, argv, 1024);
+		}
+		if (std::strcmp(argv[i], "--compute-lighting") == 0)
+		{
+			bComputeLighting = true;
+		}
+		if (std::strcmp(argv[i], "--no-mips") == 0)
+		{
+			bTextureMips = false;
+		}
+	}
 
 	glfwInit();
 
 	vk::raii::Context Context{};
 
 	VulkanWindow Window{Context};
+	Window.EnableFrameBenchmark(benchmarkFrames);
+	Window.EnableLightStress(stressLights);
+	Window.EnableComputeLighting(bComputeLighting);
+	Window.EnableTextureMips(bTextureMips);
 
 
 	try
@@ -25,4 +328,4 @@ int main()
 	}
 		glfwTerminate();
 
-}
\ No newline at end of file
+}